@@ -50,6 +50,7 @@
 #include <imgui.h>
 
 #include <VtkViewer.h>
+#include <VtkOrientationMarker.h>
 
 #include "Common.h"
 #if 0
@@ -391,12 +392,11 @@ void orientationMarker()
 			colors->GetColor3d("Yellow").GetData());
 		//axesActor->GetTextEdgesProperty()->SetLineWidth(2);
 		axesActor->GetCubeProperty()->SetColor(colors->GetColor3d("Blue").GetData());
-		static vtkNew<vtkOrientationMarkerWidget> axes;
-		axes->SetOrientationMarker(axesActor);
-		axes->SetInteractor(iren);
-		axes->EnabledOn();
-		axes->SetViewport(0.9, 0.8, 1., 1.);
-		//axes->InteractiveOn();
+		// Cached texture re-rendered only when the camera turns, instead of vtkOrientationMarkerWidget's extra renderer
+		static VtkOrientationMarker axes;
+		axes.setMarker(axesActor);
+		axes.setViewport(0.9, 0.8, 1., 1.);
+		vtkViewer.setOrientationMarker(&axes);
 		vtkSmartPointer<MouseInteractorStyle> style = vtkSmartPointer<MouseInteractorStyle>::New();
 		vtkViewer.getInteractor()->SetInteractorStyle(style);
 		ren->ResetCamera();
@@ -831,9 +831,10 @@ void cameratest()
 		cube->GetCubeProperty()->SetColor(colors->GetColor3d("Blue").GetData());
 		renderer->AddActor(cube);
 
-		static vtkNew<vtkCameraOrientationWidget> camOrientManipulator;
-		camOrientManipulator->SetParentRenderer(renderer);
-		camOrientManipulator->On();
+		// Cached texture re-rendered only when the camera turns, instead of vtkCameraOrientationWidget's extra renderer
+		static VtkOrientationMarker camOrientMarker;
+		camOrientMarker.setViewport(0.8, 0.8, 1., 1.);
+		vtkViewer.setOrientationMarker(&camOrientMarker);
 
 		vtkNew<vtkCallbackCommand> modifiedCallback;
 		modifiedCallback->SetCallback([](vtkObject * caller,long unsigned int eventId,void* vtkNotUsed(clientData),void* vtkNotUsed(callData))
@@ -1264,16 +1265,17 @@ void towActorWithLine()
 		lineActor->GetProperty()->SetOpacity(static_cast<double>(lineColor[3]));
 	}
 
-	static bool bUseFXAA = vtkViewer.getRenderer()->GetUseFXAA();
+	static bool bUseFXAA = vtkViewer.getFXAA();
 	if (ImGui::Checkbox("UseFXAA", &bUseFXAA))
 	{
-		vtkViewer.getRenderer()->SetUseFXAA(bUseFXAA);
+		vtkViewer.setFXAA(bUseFXAA);
 	}
 
-	auto MultiSamples = vtkViewer.getRenderWindow()->GetMultiSamples();
-	if (ImGui::DragInt("MultiSamples", &MultiSamples, 1, 0,100))
+	// 采样数变化时VtkViewer会重建帧缓冲
+	auto MultiSamples = vtkViewer.getMultiSamples();
+	if (ImGui::DragInt("MultiSamples", &MultiSamples, 1, 0, 16))
 	{
-		vtkViewer.getRenderWindow()->SetMultiSamples(MultiSamples);
+		vtkViewer.setMultiSamples(MultiSamples);
 	}
 	
 	//vtkViewer.getRenderer()->SetBackground(1, 1, 1);
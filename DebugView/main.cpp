@@ -15,6 +15,8 @@
 #include "imgui_impl_opengl3.h"
 
 #include "CodeExample.h"
+#include "VtkFramePacer.h"
+#include "VtkViewer.h"
 
 static void glfw_error_callback(int error, const char* description)
 {
@@ -82,6 +84,11 @@ int main(int argc, char* argv[])
 	bool show_another_window = false;
 	bool vtk_2_open = true;
 	ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
+	// Blocks while no VtkViewer needs a new frame (viewers that don't render on demand always do)
+	VtkFramePacer framePacer;
+	// Every example keeps a static VtkViewer; the ones whose tab isn't shown give their GPU memory back
+	VtkViewer::SetGpuMemoryBudget(512 * 1024 * 1024);
+	VtkViewer::SetGpuEvictionDelay(120.0);
 
 	// Main loop
 	while (!glfwWindowShouldClose(window))
@@ -91,7 +98,7 @@ int main(int argc, char* argv[])
 		// - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application.
 		// - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application.
 		// Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
-		glfwPollEvents();
+		framePacer.waitForNextFrame();
 
 		// Start the Dear ImGui frame
 		ImGui_ImplOpenGL3_NewFrame();
@@ -103,6 +110,9 @@ int main(int argc, char* argv[])
 		ImGui::Begin("My window", nullptr, ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoTitleBar | ImGuiWindowFlags_NoScrollbar);
 		renderExample();
 		ImGui::End();
+
+		ImGui::SetNextWindowCollapsed(true, ImGuiCond_FirstUseEver);
+		VtkViewer::ShowGpuMemoryWindow();
 	
 
 		ImGui::Render();
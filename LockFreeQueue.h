@@ -0,0 +1,128 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// Bounded single-producer / single-consumer ring buffer: push() from one thread, pop() from another.
+// Neither call blocks nor allocates; push() fails when the queue is full.
+template <typename T>
+class SpscQueue {
+public:
+	explicit SpscQueue(size_t capacity)
+		: buffer(capacity + 1), head(0), tail(0){
+	}
+
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+public:
+	bool push(const T& value){
+		const size_t t = tail.load(std::memory_order_relaxed);
+		const size_t next = (t + 1) % buffer.size();
+		if (next == head.load(std::memory_order_acquire)){
+			return false;
+		}
+		buffer[t] = value;
+		tail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	bool pop(T& value){
+		const size_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire)){
+			return false;
+		}
+		value = buffer[h];
+		head.store((h + 1) % buffer.size(), std::memory_order_release);
+		return true;
+	}
+
+	bool empty() const {
+		return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+	}
+private:
+	std::vector<T> buffer; // one slot stays free to tell full from empty
+	// Padded rather than alignas(64): queues are allocated with new, which ignores over-alignment before C++17
+	std::atomic<size_t> head; // consumer
+	char padding[64 - sizeof(std::atomic<size_t>)]; // keeps tail on another cache line
+	std::atomic<size_t> tail; // producer
+};
+
+// Bounded multi-producer / single-consumer queue: push() from any thread, pop() from one.
+// Each cell carries a sequence number telling producers and the consumer whose turn it is (D. Vyukov's bounded
+// queue), so producers only contend on one compare-exchange. push() fails when the queue is full.
+template <typename T>
+class MpscQueue {
+public:
+	explicit MpscQueue(size_t capacity)
+		: cells(new Cell[RoundUp(capacity)]), mask(RoundUp(capacity) - 1), head(0), tail(0){
+		for (size_t i = 0; i <= mask; i++){
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+public:
+	bool push(T value){
+		size_t position = tail.load(std::memory_order_relaxed);
+		Cell* cell;
+		for (;;){
+			cell = &cells[position & mask];
+			const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			const std::ptrdiff_t difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+			if (difference == 0){
+				if (tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)){
+					break;
+				}
+			}
+			else if (difference < 0){
+				return false; // the consumer hasn't freed this cell yet
+			}
+			else{
+				position = tail.load(std::memory_order_relaxed);
+			}
+		}
+		cell->value = std::move(value);
+		cell->sequence.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool pop(T& value){
+		const size_t position = head.load(std::memory_order_relaxed);
+		Cell& cell = cells[position & mask];
+		if (cell.sequence.load(std::memory_order_acquire) != position + 1){
+			return false;
+		}
+		value = std::move(cell.value);
+		cell.value = T(); // don't keep what the value references alive
+		cell.sequence.store(position + mask + 1, std::memory_order_release);
+		head.store(position + 1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Approximate while producers are pushing
+	size_t size() const {
+		return tail.load(std::memory_order_relaxed) - head.load(std::memory_order_relaxed);
+	}
+private:
+	static size_t RoundUp(size_t capacity){
+		size_t size = 2;
+		while (size < capacity){
+			size *= 2;
+		}
+		return size;
+	}
+
+	struct Cell {
+		std::atomic<size_t> sequence;
+		T value;
+	};
+private:
+	std::unique_ptr<Cell[]> cells;
+	const size_t mask;
+	std::atomic<size_t> head; // consumer
+	char padding[64 - sizeof(std::atomic<size_t>)]; // keeps tail on another cache line, as in SpscQueue
+	std::atomic<size_t> tail; // producers
+};
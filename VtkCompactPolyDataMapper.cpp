@@ -0,0 +1,468 @@
+#include "VtkCompactPolyDataMapper.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+
+// VTK's own OpenGL loader; the context is the one VTK renders with
+#include "vtk_glew.h"
+
+#include <vtkActor.h>
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkIdList.h>
+#include <vtkInformation.h>
+#include <vtkMath.h>
+#include <vtkMatrix3x3.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkOpenGLActor.h>
+#include <vtkOpenGLCamera.h>
+#include <vtkOpenGLRenderWindow.h>
+#include <vtkOpenGLShaderCache.h>
+#include <vtkPointData.h>
+#include <vtkProperty.h>
+#include <vtkRenderer.h>
+#include <vtkShaderProgram.h>
+
+namespace {
+	const char* compactVertexShader =
+		"//VTK::System::Dec\n"
+		"in vec4 positionQ;\n" // unsigned normalized, relative to the bounds
+		"in vec2 normalOct;\n" // signed normalized octahedral normal
+		"uniform mat4 MCDCMatrix;\n"
+		"uniform mat3 normalMatrix;\n"
+		"uniform vec3 quantizationOrigin;\n"
+		"uniform vec3 quantizationExtent;\n"
+		"out vec3 normalVC;\n"
+		"vec2 signNotZero(vec2 v) { return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0); }\n"
+		"void main() {\n"
+		"  vec3 n = vec3(normalOct, 1.0 - abs(normalOct.x) - abs(normalOct.y));\n"
+		"  if (n.z < 0.0) { n.xy = (1.0 - abs(n.yx)) * signNotZero(n.xy); }\n"
+		"  normalVC = normalMatrix * normalize(n);\n"
+		"  vec3 positionMC = quantizationOrigin + positionQ.xyz * quantizationExtent;\n"
+		"  gl_Position = MCDCMatrix * vec4(positionMC, 1.0);\n"
+		"}\n";
+
+	const char* compactFragmentShader =
+		"//VTK::System::Dec\n"
+		"//VTK::Output::Dec\n"
+		"in vec3 normalVC;\n"
+		"uniform vec3 diffuseColor;\n"
+		"uniform vec3 ambientColor;\n"
+		"uniform float opacity;\n"
+		"void main() {\n"
+		"  vec3 n = normalize(normalVC);\n"
+		"  if (!gl_FrontFacing) { n = -n; }\n"
+		"  float df = max(0.0, n.z);\n" // headlight
+		"  gl_FragData[0] = vec4(ambientColor + diffuseColor * df, opacity);\n"
+		"}\n";
+
+	// Average cache miss ratio of an index list for a FIFO post-transform cache
+	double computeACMR(const std::vector<unsigned int>& indices, size_t vertexCount, size_t cacheSize){
+		if (indices.empty()){
+			return 0.0;
+		}
+		std::vector<long long> insertedAt(vertexCount, LLONG_MIN / 2);
+		long long insertions = 0;
+		long long misses = 0;
+		for (unsigned int index : indices){
+			if (insertions - insertedAt[index] > static_cast<long long>(cacheSize)){
+				insertedAt[index] = insertions++;
+				misses++;
+			}
+		}
+		return static_cast<double>(misses) / static_cast<double>(indices.size() / 3);
+	}
+
+	short quantizeSnorm(double value){
+		value = std::max(-1.0, std::min(1.0, value));
+		return static_cast<short>(std::lround(value * 32767.0));
+	}
+
+	void encodeOctahedral(const double normal[3], short out[2]){
+		double n[3] = {normal[0], normal[1], normal[2]};
+		double l1 = std::fabs(n[0]) + std::fabs(n[1]) + std::fabs(n[2]);
+		if (l1 <= 0.0){
+			out[0] = 0;
+			out[1] = 0;
+			return;
+		}
+		n[0] /= l1;
+		n[1] /= l1;
+		if (n[2] < 0.0){
+			double x = n[0], y = n[1];
+			n[0] = (1.0 - std::fabs(y)) * (x >= 0.0 ? 1.0 : -1.0);
+			n[1] = (1.0 - std::fabs(x)) * (y >= 0.0 ? 1.0 : -1.0);
+		}
+		out[0] = quantizeSnorm(n[0]);
+		out[1] = quantizeSnorm(n[1]);
+	}
+}
+
+vtkStandardNewMacro(VtkCompactPolyDataMapper);
+
+VtkCompactPolyDataMapper::VtkCompactPolyDataMapper()
+	: MaxMeshletVertices(64), MaxMeshletTriangles(126), IndexCount(0), VertexBuffer(0), NormalBuffer(0),
+	IndexBuffer(0), VertexArray(0), VertexArrayProgram(0), Stats(){
+	QuantizationOrigin[0] = QuantizationOrigin[1] = QuantizationOrigin[2] = 0.0;
+	QuantizationExtent[0] = QuantizationExtent[1] = QuantizationExtent[2] = 1.0;
+}
+
+VtkCompactPolyDataMapper::~VtkCompactPolyDataMapper() = default;
+
+int VtkCompactPolyDataMapper::FillInputPortInformation(int port, vtkInformation* info){
+	info->Set(vtkAlgorithm::INPUT_REQUIRED_DATA_TYPE(), "vtkPolyData");
+	return 1;
+}
+
+vtkPolyData* VtkCompactPolyDataMapper::GetInput(){
+	return vtkPolyData::SafeDownCast(this->GetInputDataObject(0, 0));
+}
+
+void VtkCompactPolyDataMapper::ShallowCopy(vtkAbstractMapper* mapper){
+	VtkCompactPolyDataMapper* compact = VtkCompactPolyDataMapper::SafeDownCast(mapper);
+	if (compact){
+		this->SetMaxMeshletVertices(compact->GetMaxMeshletVertices());
+		this->SetMaxMeshletTriangles(compact->GetMaxMeshletTriangles());
+	}
+	this->vtkMapper::ShallowCopy(mapper);
+}
+
+double* VtkCompactPolyDataMapper::GetBounds(){
+	if (this->GetNumberOfInputConnections(0) > 0){
+		this->GetInputAlgorithm()->Update();
+	}
+	vtkPolyData* input = this->GetInput();
+	if (!input){
+		vtkMath::UninitializeBounds(this->Bounds);
+	}
+	else{
+		input->GetBounds(this->Bounds);
+	}
+	return this->Bounds;
+}
+
+void VtkCompactPolyDataMapper::BuildCompactMesh(vtkPolyData* input){
+	auto buildStart = std::chrono::steady_clock::now();
+
+	Positions.clear();
+	Normals.clear();
+	Indices.clear();
+	Stats = VtkCompactMeshStats();
+
+	vtkPoints* points = input->GetPoints();
+	const vtkIdType pointCount = points ? points->GetNumberOfPoints() : 0;
+
+	// Fan-triangulate the polygons
+	std::vector<unsigned int> triangles;
+	triangles.reserve(static_cast<size_t>(input->GetNumberOfPolys()) * 3);
+	vtkCellArray* polys = input->GetPolys();
+	vtkSmartPointer<vtkIdList> cell = vtkSmartPointer<vtkIdList>::New();
+	size_t connectivityIds = 0;
+	for (polys->InitTraversal(); polys->GetNextCell(cell);){
+		connectivityIds += static_cast<size_t>(cell->GetNumberOfIds());
+		for (vtkIdType i = 2; i < cell->GetNumberOfIds(); i++){
+			triangles.push_back(static_cast<unsigned int>(cell->GetId(0)));
+			triangles.push_back(static_cast<unsigned int>(cell->GetId(i - 1)));
+			triangles.push_back(static_cast<unsigned int>(cell->GetId(i)));
+		}
+	}
+	const size_t triangleCount = triangles.size() / 3;
+
+	// Point normals, area-weighted face normals when the input has none
+	std::vector<double> normals(static_cast<size_t>(pointCount) * 3, 0.0);
+	vtkDataArray* inputNormals = input->GetPointData()->GetNormals();
+	if (inputNormals){
+		for (vtkIdType i = 0; i < pointCount; i++){
+			inputNormals->GetTuple(i, &normals[i * 3]);
+		}
+	}
+	else{
+		for (size_t t = 0; t < triangleCount; t++){
+			double p0[3], p1[3], p2[3], e0[3], e1[3], n[3];
+			points->GetPoint(triangles[t * 3], p0);
+			points->GetPoint(triangles[t * 3 + 1], p1);
+			points->GetPoint(triangles[t * 3 + 2], p2);
+			vtkMath::Subtract(p1, p0, e0);
+			vtkMath::Subtract(p2, p0, e1);
+			vtkMath::Cross(e0, e1, n);
+			for (int k = 0; k < 3; k++){
+				double* target = &normals[triangles[t * 3 + k] * 3];
+				target[0] += n[0];
+				target[1] += n[1];
+				target[2] += n[2];
+			}
+		}
+		for (vtkIdType i = 0; i < pointCount; i++){
+			vtkMath::Normalize(&normals[i * 3]);
+		}
+	}
+
+	// Meshlet ordering: grow each meshlet through triangles sharing vertices with it until it
+	// reaches the vertex or triangle limit, then continue from the same frontier
+	std::vector<unsigned int> adjacencyOffsets(static_cast<size_t>(pointCount) + 1, 0);
+	for (unsigned int v : triangles){
+		adjacencyOffsets[v + 1]++;
+	}
+	for (size_t i = 1; i < adjacencyOffsets.size(); i++){
+		adjacencyOffsets[i] += adjacencyOffsets[i - 1];
+	}
+	std::vector<unsigned int> adjacency(triangles.size());
+	{
+		std::vector<unsigned int> cursor(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t t = 0; t < triangleCount; t++){
+			for (int k = 0; k < 3; k++){
+				adjacency[cursor[triangles[t * 3 + k]]++] = static_cast<unsigned int>(t);
+			}
+		}
+	}
+
+	std::vector<unsigned int> order;
+	order.reserve(triangleCount);
+	// Each triangle enters the frontier at most once, so it never holds more than triangleCount entries
+	enum : char { Unvisited, Queued, Emitted };
+	std::vector<char> state(triangleCount, Unvisited);
+	std::vector<int> meshletOfVertex(static_cast<size_t>(pointCount), -1);
+	std::vector<unsigned int> frontier;
+	size_t frontierHead = 0;
+	size_t seed = 0;
+	int meshlet = 0;
+	int meshletVertices = 0;
+	int meshletTriangles = 0;
+	while (order.size() < triangleCount){
+		size_t next = triangleCount;
+		while (frontierHead < frontier.size()){
+			unsigned int candidate = frontier[frontierHead++];
+			if (state[candidate] != Emitted){
+				next = candidate;
+				break;
+			}
+		}
+		if (frontierHead == frontier.size()){
+			frontier.clear();
+			frontierHead = 0;
+		}
+		if (next == triangleCount){
+			while (state[seed] == Emitted){
+				seed++;
+			}
+			next = seed;
+		}
+
+		int newVertices = 0;
+		for (int k = 0; k < 3; k++){
+			if (meshletOfVertex[triangles[next * 3 + k]] != meshlet){
+				newVertices++;
+			}
+		}
+		if (meshletVertices + newVertices > MaxMeshletVertices || meshletTriangles + 1 > MaxMeshletTriangles){
+			meshlet++;
+			meshletVertices = 0;
+			meshletTriangles = 0;
+		}
+
+		state[next] = Emitted;
+		order.push_back(static_cast<unsigned int>(next));
+		meshletTriangles++;
+		for (int k = 0; k < 3; k++){
+			unsigned int v = triangles[next * 3 + k];
+			if (meshletOfVertex[v] != meshlet){
+				meshletOfVertex[v] = meshlet;
+				meshletVertices++;
+			}
+			for (unsigned int a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; a++){
+				if (state[adjacency[a]] == Unvisited){
+					state[adjacency[a]] = Queued;
+					frontier.push_back(adjacency[a]);
+				}
+			}
+		}
+	}
+
+	// Renumber vertices by first use in the meshlet order (drops unreferenced points)
+	std::vector<unsigned int> remap(static_cast<size_t>(pointCount), UINT_MAX);
+	std::vector<unsigned int> sourceVertex;
+	sourceVertex.reserve(static_cast<size_t>(pointCount));
+	Indices.reserve(triangles.size());
+	for (unsigned int t : order){
+		for (int k = 0; k < 3; k++){
+			unsigned int v = triangles[t * 3 + k];
+			if (remap[v] == UINT_MAX){
+				remap[v] = static_cast<unsigned int>(sourceVertex.size());
+				sourceVertex.push_back(v);
+			}
+			Indices.push_back(remap[v]);
+		}
+	}
+
+	// Quantize positions relative to the bounds, encode normals
+	double bounds[6];
+	input->GetBounds(bounds);
+	for (int i = 0; i < 3; i++){
+		QuantizationOrigin[i] = bounds[i * 2];
+		QuantizationExtent[i] = bounds[i * 2 + 1] > bounds[i * 2] ? bounds[i * 2 + 1] - bounds[i * 2] : 1.0;
+	}
+	Positions.resize(sourceVertex.size() * 4);
+	Normals.resize(sourceVertex.size() * 2);
+	for (size_t i = 0; i < sourceVertex.size(); i++){
+		double p[3];
+		points->GetPoint(sourceVertex[i], p);
+		for (int k = 0; k < 3; k++){
+			double q = (p[k] - QuantizationOrigin[k]) / QuantizationExtent[k];
+			Positions[i * 4 + k] = static_cast<unsigned short>(std::lround(std::max(0.0, std::min(1.0, q)) * 65535.0));
+		}
+		Positions[i * 4 + 3] = 0; // keeps every vertex 8-byte aligned
+		encodeOctahedral(&normals[sourceVertex[i] * 3], &Normals[i * 2]);
+	}
+	IndexCount = static_cast<vtkIdType>(Indices.size());
+
+	Stats.vertices = static_cast<vtkIdType>(sourceVertex.size());
+	Stats.triangles = static_cast<vtkIdType>(triangleCount);
+	Stats.meshlets = triangleCount > 0 ? meshlet + 1 : 0;
+	Stats.originalBytes = static_cast<size_t>(pointCount) * (3 * sizeof(float) + 3 * sizeof(float)) +
+		static_cast<size_t>(polys->GetNumberOfCells() + 1) * sizeof(long long) +
+		connectivityIds * sizeof(long long);
+	Stats.compactBytes = Positions.size() * sizeof(unsigned short) + Normals.size() * sizeof(short) +
+		Indices.size() * sizeof(unsigned int);
+	Stats.inputACMR = computeACMR(triangles, static_cast<size_t>(pointCount), 32);
+	Stats.compactACMR = computeACMR(Indices, sourceVertex.size(), 32);
+	Stats.buildTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count();
+
+	BuildTime.Modified();
+}
+
+void VtkCompactPolyDataMapper::UploadCompactMesh(){
+	if (!VertexBuffer){
+		glGenBuffers(1, &VertexBuffer);
+		glGenBuffers(1, &NormalBuffer);
+		glGenBuffers(1, &IndexBuffer);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, Positions.size() * sizeof(unsigned short), Positions.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, NormalBuffer);
+	glBufferData(GL_ARRAY_BUFFER, Normals.size() * sizeof(short), Normals.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IndexBuffer);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, Indices.size() * sizeof(unsigned int), Indices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+	// The GPU copy is the only one needed from now on
+	std::vector<unsigned short>().swap(Positions);
+	std::vector<short>().swap(Normals);
+	std::vector<unsigned int>().swap(Indices);
+
+	UploadTime.Modified();
+}
+
+void VtkCompactPolyDataMapper::Render(vtkRenderer* ren, vtkActor* actor){
+	if (this->GetNumberOfInputConnections(0) > 0){
+		this->GetInputAlgorithm()->Update();
+	}
+	vtkPolyData* input = this->GetInput();
+	if (!input || !input->GetPoints()){
+		return;
+	}
+
+	if (input->GetMTime() > BuildTime || this->GetMTime() > BuildTime){
+		BuildCompactMesh(input);
+	}
+	if (UploadTime < BuildTime){
+		UploadCompactMesh();
+	}
+	if (IndexCount == 0){
+		return;
+	}
+
+	vtkOpenGLRenderWindow* renWin = vtkOpenGLRenderWindow::SafeDownCast(ren->GetRenderWindow());
+	vtkShaderProgram* program = renWin->GetShaderCache()->ReadyShaderProgram(compactVertexShader, compactFragmentShader, "");
+	if (!program){
+		vtkErrorMacro("Could not build the compact mesh shader program");
+		return;
+	}
+
+	if (!VertexArray || VertexArrayProgram != program->GetHandle()){
+		if (!VertexArray){
+			glGenVertexArrays(1, &VertexArray);
+		}
+		glBindVertexArray(VertexArray);
+		GLint positionLocation = glGetAttribLocation(program->GetHandle(), "positionQ");
+		GLint normalLocation = glGetAttribLocation(program->GetHandle(), "normalOct");
+		glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
+		glEnableVertexAttribArray(positionLocation);
+		glVertexAttribPointer(positionLocation, 4, GL_UNSIGNED_SHORT, GL_TRUE, 4 * sizeof(unsigned short), nullptr);
+		glBindBuffer(GL_ARRAY_BUFFER, NormalBuffer);
+		glEnableVertexAttribArray(normalLocation);
+		glVertexAttribPointer(normalLocation, 2, GL_SHORT, GL_TRUE, 2 * sizeof(short), nullptr);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IndexBuffer);
+		glBindVertexArray(0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+		VertexArrayProgram = program->GetHandle();
+	}
+
+	// Same matrix conventions as vtkOpenGLPolyDataMapper (matrices are already transposed for GL)
+	vtkOpenGLCamera* camera = static_cast<vtkOpenGLCamera*>(ren->GetActiveCamera());
+	vtkMatrix4x4* wcvc;
+	vtkMatrix3x3* cameraNormals;
+	vtkMatrix4x4* vcdc;
+	vtkMatrix4x4* wcdc;
+	camera->GetKeyMatrices(ren, wcvc, cameraNormals, vcdc, wcdc);
+	if (actor->GetIsIdentity()){
+		program->SetUniformMatrix("MCDCMatrix", wcdc);
+		program->SetUniformMatrix("normalMatrix", cameraNormals);
+	}
+	else{
+		vtkMatrix4x4* mcwc;
+		vtkMatrix3x3* actorNormals;
+		static_cast<vtkOpenGLActor*>(actor)->GetKeyMatrices(mcwc, actorNormals);
+		vtkSmartPointer<vtkMatrix4x4> mcdc = vtkSmartPointer<vtkMatrix4x4>::New();
+		vtkSmartPointer<vtkMatrix3x3> normalMatrix = vtkSmartPointer<vtkMatrix3x3>::New();
+		vtkMatrix4x4::Multiply4x4(mcwc, wcdc, mcdc);
+		vtkMatrix3x3::Multiply3x3(actorNormals, cameraNormals, normalMatrix);
+		program->SetUniformMatrix("MCDCMatrix", mcdc);
+		program->SetUniformMatrix("normalMatrix", normalMatrix);
+	}
+
+	float origin[3], extent[3];
+	for (int i = 0; i < 3; i++){
+		origin[i] = static_cast<float>(QuantizationOrigin[i]);
+		extent[i] = static_cast<float>(QuantizationExtent[i]);
+	}
+	program->SetUniform3f("quantizationOrigin", origin);
+	program->SetUniform3f("quantizationExtent", extent);
+
+	vtkProperty* property = actor->GetProperty();
+	double* diffuse = property->GetDiffuseColor();
+	double* ambient = property->GetAmbientColor();
+	float diffuseColor[3], ambientColor[3];
+	for (int i = 0; i < 3; i++){
+		diffuseColor[i] = static_cast<float>(diffuse[i] * property->GetDiffuse());
+		ambientColor[i] = static_cast<float>(ambient[i] * property->GetAmbient());
+	}
+	program->SetUniform3f("diffuseColor", diffuseColor);
+	program->SetUniform3f("ambientColor", ambientColor);
+	program->SetUniformf("opacity", static_cast<float>(property->GetOpacity()));
+
+	glBindVertexArray(VertexArray);
+	glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(IndexCount), GL_UNSIGNED_INT, nullptr);
+	glBindVertexArray(0);
+}
+
+void VtkCompactPolyDataMapper::ReleaseGraphicsResources(vtkWindow* window){
+	if (VertexArray){
+		glDeleteVertexArrays(1, &VertexArray);
+		VertexArray = 0;
+		VertexArrayProgram = 0;
+	}
+	if (VertexBuffer){
+		glDeleteBuffers(1, &VertexBuffer);
+		glDeleteBuffers(1, &NormalBuffer);
+		glDeleteBuffers(1, &IndexBuffer);
+		VertexBuffer = NormalBuffer = IndexBuffer = 0;
+	}
+	// The staging copy was dropped after upload, rebuild it on the next render
+	BuildTime = vtkTimeStamp();
+	UploadTime = vtkTimeStamp();
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+
+#include <vtkMapper.h>
+#include <vtkPolyData.h>
+#include <vtkTimeStamp.h>
+
+// Memory/locality report of the last mesh built by VtkCompactPolyDataMapper
+struct VtkCompactMeshStats {
+	vtkIdType vertices;
+	vtkIdType triangles;
+	vtkIdType meshlets;
+	size_t originalBytes; // float32 positions + float32 normals + 64-bit vtkCellArray connectivity
+	size_t compactBytes; // 16-bit positions + octahedral normals + 32-bit indices
+	double inputACMR; // average cache miss ratio (FIFO, 32 entries) of the input triangle order
+	double compactACMR; // same, after meshlet ordering
+	double buildTime; // ms
+};
+
+// Polydata mapper with a compressed vertex format, for very large triangle meshes
+// - positions are quantized to 16 bits per component relative to the input bounds
+// - normals are octahedral-encoded into two 16-bit components
+// - connectivity is uploaded as 32-bit indices
+// - triangles are grouped into meshlets and vertices renumbered by first use for vertex-cache locality
+// Only opaque, lit, solid-colored surfaces are supported (no scalars, textures or depth peeling);
+// polygons are fan-triangulated, other cell types are ignored.
+class VtkCompactPolyDataMapper : public vtkMapper {
+public:
+	static VtkCompactPolyDataMapper* New();
+	vtkTypeMacro(VtkCompactPolyDataMapper, vtkMapper);
+public:
+	void Render(vtkRenderer* ren, vtkActor* actor) override;
+	void ReleaseGraphicsResources(vtkWindow* window) override;
+	using vtkMapper::GetBounds;
+	double* GetBounds() override;
+
+	vtkPolyData* GetInput();
+	// Mapper settings and the meshlet limits, not the input (as vtkMapper::ShallowCopy)
+	void ShallowCopy(vtkAbstractMapper* mapper) override;
+
+	// Meshlet limits (defaults: 64 vertices, 126 triangles)
+	vtkSetMacro(MaxMeshletVertices, int);
+	vtkGetMacro(MaxMeshletVertices, int);
+	vtkSetMacro(MaxMeshletTriangles, int);
+	vtkGetMacro(MaxMeshletTriangles, int);
+
+	inline const VtkCompactMeshStats& GetStats() const {
+		return Stats;
+	}
+protected:
+	VtkCompactPolyDataMapper();
+	~VtkCompactPolyDataMapper() override;
+
+	int FillInputPortInformation(int port, vtkInformation* info) override;
+	void BuildCompactMesh(vtkPolyData* input);
+	void UploadCompactMesh();
+protected:
+	int MaxMeshletVertices;
+	int MaxMeshletTriangles;
+
+	// CPU staging, released once uploaded
+	std::vector<unsigned short> Positions; // xyz + padding, normalized to the bounds
+	std::vector<short> Normals; // octahedral xy
+	std::vector<unsigned int> Indices;
+	double QuantizationOrigin[3];
+	double QuantizationExtent[3];
+	vtkIdType IndexCount;
+
+	unsigned int VertexBuffer;
+	unsigned int NormalBuffer;
+	unsigned int IndexBuffer;
+	unsigned int VertexArray;
+	unsigned int VertexArrayProgram; // program handle the vertex array was set up for
+
+	vtkTimeStamp BuildTime;
+	vtkTimeStamp UploadTime;
+	VtkCompactMeshStats Stats;
+private:
+	VtkCompactPolyDataMapper(const VtkCompactPolyDataMapper&) = delete;
+	void operator=(const VtkCompactPolyDataMapper&) = delete;
+};
@@ -0,0 +1,100 @@
+#include "VtkFramePacer.h"
+#include "VtkViewer.h"
+
+#include <ctime>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+// OpenGL Loader
+// This can be replaced with another loader, e.g. glad, but
+// remember to change the corresponding initialize call below!
+#include <GL/gl3w.h>            // GL3w, initialized with gl3wInit()
+
+// Include glfw3.h after our OpenGL definitions
+#include <GLFW/glfw3.h>
+
+VtkFramePacer::VtkFramePacer()
+	: mode(Mode::OnDemand), idleTimeout(0.5), pendingWorkTimeout(1.0 / 30.0), settleFrameCount(3), settleFrames(3),
+	sampleStart(std::chrono::steady_clock::now()), sampleCpuTime(processCpuTime()), sampleIdleTime(0.0), sampleFrames(0),
+	sampleRenders(VtkViewer::GetTotalRenderCount()), sampleRenderTime(VtkViewer::GetTotalRenderTime()),
+	cpuUsage(0.0), framesPerSecond(0.0), rendersPerSecond(0.0), renderLoad(0.0), idleFraction(0.0){
+}
+
+double VtkFramePacer::processCpuTime(){
+#ifdef _WIN32
+	// std::clock() is wall time with MSVC
+	FILETIME creation, exit, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)){
+		return 0.0;
+	}
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime;
+	k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;
+	u.HighPart = user.dwHighDateTime;
+	return static_cast<double>(k.QuadPart + u.QuadPart) * 1e-7; // 100 ns units
+#else
+	return static_cast<double>(std::clock()) / CLOCKS_PER_SEC; // all threads of the process
+#endif
+}
+
+void VtkFramePacer::waitForNextFrame(){
+	sampleFrames++;
+	if (mode == Mode::Continuous){
+		glfwPollEvents();
+		sample();
+		return;
+	}
+
+	// Input seen during the last frame keeps the loop going for a few frames
+	ImGuiIO& io = ImGui::GetIO();
+	if (ImGui::IsAnyMouseDown() || io.MouseWheel != 0.0f || io.MouseDelta.x != 0.0f || io.MouseDelta.y != 0.0f){
+		settleFrames = settleFrameCount;
+	}
+
+	if (settleFrames > 0 || VtkViewer::AnyNeedsRedraw()){
+		if (settleFrames > 0){
+			settleFrames--;
+		}
+		glfwPollEvents();
+	}
+	else{
+		const double timeout = VtkViewer::AnyHasPendingWork() ? pendingWorkTimeout : idleTimeout;
+		auto waitStart = std::chrono::steady_clock::now();
+		glfwWaitEventsTimeout(timeout);
+		const double waited = std::chrono::duration<double>(std::chrono::steady_clock::now() - waitStart).count();
+		sampleIdleTime += waited;
+		if (waited < timeout * 0.95){
+			settleFrames = settleFrameCount; // woken up by an event rather than the timeout
+		}
+	}
+	sample();
+}
+
+void VtkFramePacer::sample(){
+	auto now = std::chrono::steady_clock::now();
+	const double elapsed = std::chrono::duration<double>(now - sampleStart).count();
+	if (elapsed < 1.0){
+		return;
+	}
+
+	const double cpuTime = processCpuTime();
+	const unsigned long renders = VtkViewer::GetTotalRenderCount();
+	const double renderTime = VtkViewer::GetTotalRenderTime();
+
+	cpuUsage = 100.0 * (cpuTime - sampleCpuTime) / elapsed;
+	framesPerSecond = sampleFrames / elapsed;
+	rendersPerSecond = (renders - sampleRenders) / elapsed;
+	renderLoad = 100.0 * (renderTime - sampleRenderTime) / (elapsed * 1000.0);
+	idleFraction = 100.0 * sampleIdleTime / elapsed;
+
+	sampleStart = now;
+	sampleCpuTime = cpuTime;
+	sampleIdleTime = 0.0;
+	sampleFrames = 0;
+	sampleRenders = renders;
+	sampleRenderTime = renderTime;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <chrono>
+
+// Replaces glfwPollEvents() at the top of the main loop.
+// In OnDemand mode the loop blocks in glfwWaitEventsTimeout() while no VtkViewer needs a new frame,
+// so an untouched application uses (almost) no CPU or GPU.
+class VtkFramePacer {
+public:
+	enum class Mode {
+		Continuous, // poll every frame (vsync paced), the original behavior
+		OnDemand
+	};
+public:
+	VtkFramePacer();
+public:
+	// Call once per frame instead of glfwPollEvents(), before starting the ImGui frame
+	void waitForNextFrame();
+public:
+	inline void setMode(Mode mode) {
+		this->mode = mode;
+		settleFrames = settleFrameCount;
+	}
+
+	inline Mode getMode() const {
+		return mode;
+	}
+
+	// Longest time to block without any event; bounds how late time-based ImGui state (tooltips, text cursor) updates
+	inline void setIdleTimeout(double seconds) {
+		idleTimeout = seconds;
+	}
+
+	// Frames still run after an input event, ImGui needs a few to settle hover/active states and layout
+	inline void setSettleFrameCount(int frames) {
+		settleFrameCount = frames;
+	}
+public:
+	// Measured over the last completed sampling interval (about one second)
+	inline double getCpuUsage() const { // % of one core used by the whole process
+		return cpuUsage;
+	}
+
+	inline double getFramesPerSecond() const {
+		return framesPerSecond;
+	}
+
+	inline double getRendersPerSecond() const { // VtkViewer renders, all viewers
+		return rendersPerSecond;
+	}
+
+	inline double getRenderLoad() const { // % of wall time spent in VtkViewer renders, a proxy for GPU load
+		return renderLoad;
+	}
+
+	inline double getIdleFraction() const { // % of wall time spent blocked waiting for events
+		return idleFraction;
+	}
+private:
+	static double processCpuTime(); // seconds
+	void sample();
+private:
+	Mode mode;
+	double idleTimeout; // s
+	double pendingWorkTimeout; // s, used while viewers wait for background results
+	int settleFrameCount;
+	int settleFrames;
+
+	std::chrono::steady_clock::time_point sampleStart;
+	double sampleCpuTime;
+	double sampleIdleTime;
+	unsigned long sampleFrames;
+	unsigned long sampleRenders;
+	double sampleRenderTime;
+
+	double cpuUsage;
+	double framesPerSecond;
+	double rendersPerSecond;
+	double renderLoad;
+	double idleFraction;
+};
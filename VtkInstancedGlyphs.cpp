@@ -0,0 +1,97 @@
+#include "VtkInstancedGlyphs.h"
+
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+
+namespace {
+	const float identityOrientation[4] = {1.0f, 0.0f, 0.0f, 0.0f};
+	const float unitScale[3] = {1.0f, 1.0f, 1.0f};
+	const unsigned char white[4] = {255, 255, 255, 255};
+}
+
+VtkInstancedGlyphs::VtkInstancedGlyphs(vtkAlgorithmOutput* source) : count(0){
+	points = vtkSmartPointer<vtkPoints>::New();
+	points->SetDataTypeToFloat();
+
+	orientation = vtkSmartPointer<vtkFloatArray>::New();
+	orientation->SetName("orientation");
+	orientation->SetNumberOfComponents(4);
+	scale = vtkSmartPointer<vtkFloatArray>::New();
+	scale->SetName("scale");
+	scale->SetNumberOfComponents(3);
+	color = vtkSmartPointer<vtkUnsignedCharArray>::New();
+	color->SetName("color");
+	color->SetNumberOfComponents(4);
+
+	instances = vtkSmartPointer<vtkPolyData>::New();
+	instances->SetPoints(points);
+	instances->GetPointData()->AddArray(orientation);
+	instances->GetPointData()->AddArray(scale);
+	instances->GetPointData()->AddArray(color);
+
+	mapper = vtkSmartPointer<vtkGlyph3DMapper>::New();
+	mapper->SetSourceConnection(source);
+	mapper->SetInputData(instances);
+	mapper->SetOrientationArray("orientation");
+	mapper->SetOrientationModeToQuaternion();
+	mapper->SetScaleArray("scale");
+	mapper->SetScaleModeToScaleByVectorComponents();
+	mapper->SetScalarModeToUsePointFieldData();
+	mapper->SelectColorArray("color");
+	mapper->SetColorModeToDirectScalars();
+	mapper->ScalarVisibilityOn();
+
+	actor = vtkSmartPointer<vtkActor>::New();
+	actor->SetMapper(mapper);
+}
+
+void VtkInstancedGlyphs::resize(vtkIdType newCount){
+	// Existing values are kept, the arrays reallocate like std::vector
+	points->SetNumberOfPoints(newCount);
+	orientation->SetNumberOfTuples(newCount);
+	scale->SetNumberOfTuples(newCount);
+	color->SetNumberOfTuples(newCount);
+
+	for (vtkIdType i = count; i < newCount; i++){
+		points->SetPoint(i, 0.0, 0.0, 0.0);
+		orientation->SetTypedTuple(i, identityOrientation);
+		scale->SetTypedTuple(i, unitScale);
+		color->SetTypedTuple(i, white);
+	}
+	count = newCount;
+	modified();
+}
+
+void VtkInstancedGlyphs::setInstance(vtkIdType index, const VtkInstanceTransform& transform, const unsigned char rgba[4]){
+	float* position = positions() + index * 3;
+	position[0] = transform.position[0];
+	position[1] = transform.position[1];
+	position[2] = transform.position[2];
+	orientation->SetTypedTuple(index, transform.orientation);
+	scale->SetTypedTuple(index, transform.scale);
+	color->SetTypedTuple(index, rgba);
+}
+
+void VtkInstancedGlyphs::modified(){
+	points->Modified();
+	orientation->Modified();
+	scale->Modified();
+	color->Modified();
+	instances->Modified();
+}
+
+void VtkInstancedGlyphs::positionsModified(){
+	points->Modified(); // part of the instances' MTime, like the arrays below
+}
+
+void VtkInstancedGlyphs::orientationsModified(){
+	orientation->Modified();
+}
+
+void VtkInstancedGlyphs::scalesModified(){
+	scale->Modified();
+}
+
+void VtkInstancedGlyphs::colorsModified(){
+	color->Modified();
+}
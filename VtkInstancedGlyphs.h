@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vtkSmartPointer.h>
+#include <vtkActor.h>
+#include <vtkAlgorithmOutput.h>
+#include <vtkFloatArray.h>
+#include <vtkGlyph3DMapper.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkUnsignedCharArray.h>
+
+// Placement of one instance: translate(position) * rotate(orientation) * scale(scale)
+struct VtkInstanceTransform {
+	float position[3];
+	float orientation[4]; // unit quaternion w, x, y, z
+	float scale[3];
+};
+
+// Many copies of one source drawn by a single vtkGlyph3DMapper, which the OpenGL backend renders with
+// instanced draw calls (one per source block instead of one actor, mapper and draw per object).
+// Per-instance data is kept structure-of-arrays in the mapper's input, so it can be written in place:
+// change the values behind positions()/orientations()/scales()/colors(), then call the matching *Modified()
+// (or modified() after changing several).
+class VtkInstancedGlyphs {
+public:
+	explicit VtkInstancedGlyphs(vtkAlgorithmOutput* source);
+public:
+	// New instances sit at the origin, unrotated, unscaled and white
+	void resize(vtkIdType count);
+	void setInstance(vtkIdType index, const VtkInstanceTransform& transform, const unsigned char rgba[4]);
+	// Uploads the instance arrays again on the next render
+	void modified();
+	// Marks only that array as changed, e.g. positionsModified() for an animation that only moves the instances
+	void positionsModified();
+	void orientationsModified();
+	void scalesModified();
+	void colorsModified();
+public:
+	inline vtkIdType size() const {
+		return count;
+	}
+
+	inline float* positions() { // x, y, z per instance
+		return static_cast<float*>(points->GetData()->GetVoidPointer(0));
+	}
+
+	inline float* orientations() { // w, x, y, z per instance
+		return orientation->GetPointer(0);
+	}
+
+	inline float* scales() { // x, y, z per instance
+		return scale->GetPointer(0);
+	}
+
+	inline unsigned char* colors() { // r, g, b, a per instance
+		return color->GetPointer(0);
+	}
+
+	inline const vtkSmartPointer<vtkActor>& getActor() const {
+		return actor;
+	}
+
+	inline const vtkSmartPointer<vtkGlyph3DMapper>& getMapper() const {
+		return mapper;
+	}
+private:
+	vtkIdType count;
+	vtkSmartPointer<vtkPoints> points;
+	vtkSmartPointer<vtkFloatArray> orientation;
+	vtkSmartPointer<vtkFloatArray> scale;
+	vtkSmartPointer<vtkUnsignedCharArray> color;
+	vtkSmartPointer<vtkPolyData> instances;
+	vtkSmartPointer<vtkGlyph3DMapper> mapper;
+	vtkSmartPointer<vtkActor> actor;
+};
@@ -0,0 +1,217 @@
+#include "VtkLiveDensityVolume.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <vtkAppendPolyData.h>
+
+namespace {
+	const int stepsPerBatch = 10000; // between checks of the flags and the clock
+}
+
+VtkLiveDensityVolume::VtkLiveDensityVolume(int resolution, const double bounds[6], int brickSize)
+	: grid(resolution, bounds, brickSize), brickSize(grid.getBrickSize()),
+	bricksPerSide(grid.getBricksPerSide()), steps(0), publishes(0),
+	running(false), recontourAll(false), isoValue(50.0), publishInterval(0.25), publishedStats(), stats(){
+	state[0] = state[1] = state[2] = 0.0;
+
+	const size_t bricks = grid.getBrickCount();
+	brickDirty.assign(bricks, 0);
+	brickSurfaces.resize(bricks);
+	stats.bricks = publishedStats.bricks = static_cast<int>(bricks);
+	stats.memoryBytes = publishedStats.memoryBytes = grid.getMemoryBytes();
+
+	brickImage = vtkSmartPointer<vtkImageData>::New();
+	contour = vtkSmartPointer<vtkFlyingEdges3D>::New();
+	contour->SetInputData(brickImage);
+	contour->ComputeNormalsOn();
+
+	mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+	mapper->SetInputData(vtkSmartPointer<vtkPolyData>::New());
+	mapper->ScalarVisibilityOff();
+	actor = vtkSmartPointer<vtkActor>::New();
+	actor->SetMapper(mapper);
+}
+
+VtkLiveDensityVolume::~VtkLiveDensityVolume(){
+	stop();
+}
+
+void VtkLiveDensityVolume::start(const Integrator& stepFunction, const double initialState[3]){
+	stop();
+	integrator = stepFunction;
+	state[0] = initialState[0];
+	state[1] = initialState[1];
+	state[2] = initialState[2];
+	running = true;
+	worker = std::thread(&VtkLiveDensityVolume::run, this);
+}
+
+void VtkLiveDensityVolume::stop(){
+	running = false;
+	if (worker.joinable()){
+		worker.join();
+	}
+}
+
+void VtkLiveDensityVolume::clear(){
+	const bool wasRunning = running;
+	stop();
+	grid.clear();
+	std::fill(brickDirty.begin(), brickDirty.end(), static_cast<unsigned char>(0));
+	dirtyBricks.clear();
+	std::fill(brickSurfaces.begin(), brickSurfaces.end(), nullptr);
+	steps = 0;
+	contourDirtyBricks(0.0); // publishes the empty surface
+	if (wasRunning){
+		running = true;
+		worker = std::thread(&VtkLiveDensityVolume::run, this);
+	}
+}
+
+bool VtkLiveDensityVolume::update(){
+	std::lock_guard<std::mutex> lock(publishMutex);
+	if (!published){
+		return false;
+	}
+	mapper->SetInputData(published);
+	published = nullptr;
+	stats = publishedStats;
+	return true;
+}
+
+void VtkLiveDensityVolume::setIsoValue(double value){
+	isoValue = value;
+	recontourAll = true; // picked up by the worker's next surface
+	if (!running){
+		contourDirtyBricks(stats.stepsPerSecond);
+	}
+}
+
+void VtkLiveDensityVolume::setPublishInterval(double seconds){
+	publishInterval = std::max(0.01, seconds);
+}
+
+void VtkLiveDensityVolume::setPublishCallback(const std::function<void()>& callback){
+	const bool wasRunning = running;
+	stop();
+	publishCallback = callback;
+	if (wasRunning){
+		running = true;
+		worker = std::thread(&VtkLiveDensityVolume::run, this);
+	}
+}
+
+void VtkLiveDensityVolume::markDirty(int x, int y, int z){
+	// A voxel is a corner of the cells on both sides, the first voxel of a brick also belongs to the brick before
+	int bx[2], by[2], bz[2];
+	int nx = 0, ny = 0, nz = 0;
+	bx[nx++] = x / brickSize;
+	if (x > 0 && x % brickSize == 0){
+		bx[nx++] = x / brickSize - 1;
+	}
+	by[ny++] = y / brickSize;
+	if (y > 0 && y % brickSize == 0){
+		by[ny++] = y / brickSize - 1;
+	}
+	bz[nz++] = z / brickSize;
+	if (z > 0 && z % brickSize == 0){
+		bz[nz++] = z / brickSize - 1;
+	}
+	for (int k = 0; k < nz; k++){
+		for (int j = 0; j < ny; j++){
+			for (int i = 0; i < nx; i++){
+				const int brick = bx[i] + (by[j] + bz[k] * bricksPerSide) * bricksPerSide;
+				if (!brickDirty[brick]){
+					brickDirty[brick] = 1;
+					dirtyBricks.push_back(brick);
+				}
+			}
+		}
+	}
+}
+
+void VtkLiveDensityVolume::run(){
+	std::chrono::steady_clock::time_point lastPublish = std::chrono::steady_clock::now();
+	unsigned long long publishedSteps = steps;
+
+	while (running){
+		for (int i = 0; i < stepsPerBatch; i++){
+			integrator(state);
+			int voxel[3];
+			if (grid.voxelOf(state, voxel) && grid.increment(voxel[0], voxel[1], voxel[2])){
+				markDirty(voxel[0], voxel[1], voxel[2]);
+			}
+		}
+		steps += stepsPerBatch;
+
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		const double elapsed = std::chrono::duration<double>(now - lastPublish).count();
+		if (elapsed >= publishInterval){
+			contourDirtyBricks((steps - publishedSteps) / elapsed);
+			lastPublish = now;
+			publishedSteps = steps;
+		}
+	}
+}
+
+void VtkLiveDensityVolume::contourBrick(int brick){
+	const double iso = isoValue;
+	brickSurfaces[brick] = nullptr;
+	if (!grid.extractBrick(brick, iso, brickImage)){
+		return; // the iso-surface doesn't cross this brick
+	}
+
+	contour->SetValue(0, iso);
+	contour->Update();
+	if (contour->GetOutput()->GetNumberOfPoints() > 0){
+		brickSurfaces[brick] = vtkSmartPointer<vtkPolyData>::New();
+		brickSurfaces[brick]->DeepCopy(contour->GetOutput());
+	}
+}
+
+void VtkLiveDensityVolume::contourDirtyBricks(double stepsPerSecond){
+	if (recontourAll.exchange(false)){
+		dirtyBricks.clear();
+		for (int brick = 0; brick < static_cast<int>(brickSurfaces.size()); brick++){
+			brickDirty[brick] = 1;
+			dirtyBricks.push_back(brick);
+		}
+	}
+
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int brick : dirtyBricks){
+		contourBrick(brick);
+		brickDirty[brick] = 0;
+	}
+	const int contouredBricks = static_cast<int>(dirtyBricks.size());
+	dirtyBricks.clear();
+
+	// Stitching only copies the brick surfaces, much cheaper than contouring the whole grid again
+	vtkSmartPointer<vtkAppendPolyData> append = vtkSmartPointer<vtkAppendPolyData>::New();
+	for (const auto& brickSurface : brickSurfaces){
+		if (brickSurface){
+			append->AddInputData(brickSurface);
+		}
+	}
+	vtkSmartPointer<vtkPolyData> surface = vtkSmartPointer<vtkPolyData>::New();
+	if (append->GetNumberOfInputConnections(0) > 0){
+		append->Update();
+		surface->ShallowCopy(append->GetOutput());
+	}
+	const double contourTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	{
+		std::lock_guard<std::mutex> lock(publishMutex);
+		published = surface;
+		publishedStats.steps = steps;
+		publishedStats.stepsPerSecond = stepsPerSecond;
+		publishedStats.contouredBricks = contouredBricks;
+		publishedStats.contourTime = contourTime;
+		publishedStats.memoryBytes = grid.getMemoryBytes();
+		publishedStats.publishes = ++publishes;
+	}
+	if (publishCallback){
+		publishCallback();
+	}
+}
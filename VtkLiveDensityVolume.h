@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <vtkActor.h>
+#include <vtkFlyingEdges3D.h>
+#include <vtkImageData.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkSmartPointer.h>
+
+#include "VtkSparseBrickVolume.h"
+
+// Progress of a VtkLiveDensityVolume, as of its last published surface
+struct VtkLiveDensityStats {
+	unsigned long long steps; // integration steps since start()
+	double stepsPerSecond;
+	int bricks; // in the grid
+	int contouredBricks; // dirty bricks re-contoured for the last surface
+	double contourTime; // ms spent re-contouring them and stitching the surface
+	size_t memoryBytes; // of the voxel grid
+	unsigned long publishes;
+};
+
+// Density volume that fills in while it is displayed: a worker thread keeps integrating a trajectory and
+// increments the voxel each step lands in, tracking which bricks (brickSize^3 voxels) changed. A few times per
+// second it re-contours only the dirty bricks, stitches the per-brick surfaces into one polydata and publishes
+// it; update() on the scene thread hands the newest one to the actor's mapper. The grid itself only lives on the
+// worker, as a VtkSparseBrickVolume: nothing is rebuilt or copied as a whole, and bricks the trajectory never
+// reaches take no memory.
+class VtkLiveDensityVolume {
+public:
+	// Advances the state (x, y, z) by one integration step
+	typedef std::function<void(double state[3])> Integrator;
+
+	// resolution^3 voxels spanning bounds (xmin, xmax, ymin, ymax, zmin, zmax)
+	VtkLiveDensityVolume(int resolution, const double bounds[6], int brickSize = 16);
+	~VtkLiveDensityVolume();
+
+	VtkLiveDensityVolume(const VtkLiveDensityVolume&) = delete;
+	VtkLiveDensityVolume& operator=(const VtkLiveDensityVolume&) = delete;
+public:
+	// Continues from the counts gathered so far; restarting replaces the integrator and state
+	void start(const Integrator& integrator, const double state[3]);
+	void stop();
+	// Empties the grid (stops the worker while doing so)
+	void clear();
+	// Scene thread (under VtkViewer::lockScene() when threaded): installs the newest published surface,
+	// returns true if there was one
+	bool update();
+	// Re-contours every brick at the new value with the next surface
+	void setIsoValue(double value);
+	// s between surfaces (default 0.25)
+	void setPublishInterval(double seconds);
+	// Called on the thread that publishes a new surface, e.g. to wake an event loop waiting for input
+	void setPublishCallback(const std::function<void()>& callback);
+public:
+	inline bool isRunning() const {
+		return running;
+	}
+
+	inline double getIsoValue() const {
+		return isoValue;
+	}
+
+	inline const vtkSmartPointer<vtkActor>& getActor() const {
+		return actor;
+	}
+
+	// Copied by update()
+	inline const VtkLiveDensityStats& getStats() const {
+		return stats;
+	}
+private:
+	void run();
+	void markDirty(int x, int y, int z);
+	// Re-contours the dirty bricks and publishes the stitched surface; only on the worker, or while stopped
+	void contourDirtyBricks(double stepsPerSecond);
+	void contourBrick(int brick);
+private:
+	// Worker side
+	VtkSparseBrickVolume grid;
+	const int brickSize;
+	const int bricksPerSide;
+	Integrator integrator;
+	double state[3];
+	std::vector<unsigned char> brickDirty;
+	std::vector<int> dirtyBricks;
+	std::vector<vtkSmartPointer<vtkPolyData>> brickSurfaces; // nullptr where a brick has no surface
+	vtkSmartPointer<vtkImageData> brickImage; // see VtkSparseBrickVolume::extractBrick
+	vtkSmartPointer<vtkFlyingEdges3D> contour;
+	unsigned long long steps;
+	unsigned long publishes;
+
+	std::atomic<bool> running;
+	std::atomic<bool> recontourAll;
+	std::atomic<double> isoValue;
+	std::atomic<double> publishInterval;
+	std::function<void()> publishCallback;
+	std::thread worker;
+
+	std::mutex publishMutex; // guards the two below
+	vtkSmartPointer<vtkPolyData> published;
+	VtkLiveDensityStats publishedStats;
+
+	// Scene side
+	VtkLiveDensityStats stats;
+	vtkSmartPointer<vtkPolyDataMapper> mapper;
+	vtkSmartPointer<vtkActor> actor;
+};
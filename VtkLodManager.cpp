@@ -0,0 +1,351 @@
+#include "VtkLodManager.h"
+
+#include <algorithm>
+#include <cfloat>
+
+#include <vtkMath.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtkPolyDataNormals.h>
+#include <vtkQuadricDecimation.h>
+#include <vtkRenderer.h>
+#include <vtkTriangleFilter.h>
+
+vtkStandardNewMacro(VtkLodMapper);
+
+void VtkLodMapper::Render(vtkRenderer* ren, vtkActor* actor){
+	vtkMapper* mapper = GetLevelMapper(GetSelectedLevel(ren));
+	if (!mapper){
+		mapper = FullMapper;
+	}
+	if (mapper){
+		mapper->Render(ren, actor);
+	}
+}
+
+void VtkLodMapper::ReleaseGraphicsResources(vtkWindow* window){
+	if (FullMapper){
+		FullMapper->ReleaseGraphicsResources(window);
+	}
+	for (auto& mapper : LevelMappers){
+		if (mapper){
+			mapper->ReleaseGraphicsResources(window);
+		}
+	}
+}
+
+double* VtkLodMapper::GetBounds(){
+	// Decimation keeps (almost) the same extent, the full mapper's bounds are used for every level
+	if (!FullMapper){
+		vtkMath::UninitializeBounds(this->Bounds);
+		return this->Bounds;
+	}
+	FullMapper->GetBounds(this->Bounds);
+	return this->Bounds;
+}
+
+bool VtkLodMapper::HasOpaqueGeometry(){
+	return FullMapper ? FullMapper->HasOpaqueGeometry() : false;
+}
+
+bool VtkLodMapper::HasTranslucentPolygonalGeometry(){
+	return FullMapper ? FullMapper->HasTranslucentPolygonalGeometry() : false;
+}
+
+void VtkLodMapper::SetFullMapper(vtkMapper* mapper){
+	FullMapper = mapper;
+	if (mapper && mapper->GetNumberOfInputConnections(0) > 0){
+		// Keeps the upstream pipeline discoverable (see VtkViewer::trackPipeline)
+		this->SetInputConnection(mapper->GetInputConnection(0, 0));
+	}
+	this->Modified();
+}
+
+void VtkLodMapper::SetLevelMappers(const std::vector<vtkSmartPointer<vtkMapper>>& mappers){
+	LevelMappers = mappers;
+}
+
+int VtkLodMapper::GetNumberOfLevels() const{
+	return static_cast<int>(LevelMappers.size()) + 1;
+}
+
+vtkMapper* VtkLodMapper::GetLevelMapper(int level){
+	if (level <= 0){
+		return FullMapper;
+	}
+	if (level > static_cast<int>(LevelMappers.size())){
+		return nullptr;
+	}
+	return LevelMappers[level - 1];
+}
+
+bool VtkLodMapper::SelectLevel(vtkRenderer* ren, int level){
+	auto it = SelectedLevels.find(ren);
+	if (it != SelectedLevels.end() && it->second == level){
+		return false;
+	}
+	SelectedLevels[ren] = level;
+	return true;
+}
+
+int VtkLodMapper::GetSelectedLevel(vtkRenderer* ren) const{
+	auto it = SelectedLevels.find(ren);
+	return it == SelectedLevels.end() ? 0 : it->second;
+}
+
+VtkLodManager::VtkLodManager(unsigned int workerThreads)
+	: nextEntryId(1), trianglesPerPixel(0.5), shuttingDown(false), workers(workerThreads){
+}
+
+VtkLodManager::~VtkLodManager(){
+	// The pool still runs every queued job before joining: each sees the flag and returns right away, a running
+	// one after the level it is decimating
+	shuttingDown = true;
+	for (auto& entry : entries){
+		if (entry->actor && entry->actor->GetMapper() == entry->lodMapper.GetPointer()){
+			entry->actor->SetMapper(entry->lodMapper->GetFullMapper());
+		}
+	}
+}
+
+VtkLodManager::Entry* VtkLodManager::findEntry(vtkActor* actor) const{
+	for (auto& entry : entries){
+		if (entry->actor.GetPointer() == actor){
+			return entry.get();
+		}
+	}
+	return nullptr;
+}
+
+VtkLodManager::Entry* VtkLodManager::findEntry(unsigned long id) const{
+	for (auto& entry : entries){
+		if (entry->id == id){
+			return entry.get();
+		}
+	}
+	return nullptr;
+}
+
+void VtkLodManager::addActor(vtkActor* actor, const std::vector<double>& reductions){
+	if (!actor || !actor->GetMapper() || findEntry(actor)){
+		return;
+	}
+
+	std::unique_ptr<Entry> entry(new Entry());
+	entry->id = nextEntryId++;
+	entry->actor = actor;
+	entry->reductions = reductions;
+	std::sort(entry->reductions.begin(), entry->reductions.end());
+	entry->levelTriangles.assign(1, 0);
+	entry->sourceTime = 0;
+	entry->generation = std::make_shared<std::atomic<unsigned long>>(0);
+	entry->lodMapper = vtkSmartPointer<VtkLodMapper>::New();
+	entry->lodMapper->SetFullMapper(actor->GetMapper());
+	actor->SetMapper(entry->lodMapper);
+
+	schedule(entry.get());
+	entries.push_back(std::move(entry));
+}
+
+void VtkLodManager::removeActor(vtkActor* actor){
+	for (auto it = entries.begin(); it != entries.end(); ++it){
+		if ((*it)->actor.GetPointer() == actor){
+			if (actor->GetMapper() == (*it)->lodMapper.GetPointer()){
+				actor->SetMapper((*it)->lodMapper->GetFullMapper());
+			}
+			(*(*it)->generation)++; // stops its jobs
+			entries.erase(it); // results still in flight no longer find their entry and are dropped
+			return;
+		}
+	}
+}
+
+void VtkLodManager::schedule(Entry* entry){
+	vtkMapper* fullMapper = entry->lodMapper->GetFullMapper();
+	if (fullMapper->GetNumberOfInputConnections(0) > 0){
+		fullMapper->GetInputAlgorithm()->Update();
+	}
+	vtkPolyData* source = vtkPolyData::SafeDownCast(fullMapper->GetInputDataObject(0, 0));
+	if (!source){
+		return;
+	}
+
+	const unsigned long generation = ++(*entry->generation);
+	entry->sourceTime = source->GetMTime();
+	entry->levelTriangles.assign(entry->reductions.size() + 1, 0);
+	entry->levelTriangles[0] = source->GetNumberOfPolys();
+	entry->lodMapper->SetLevelMappers(std::vector<vtkSmartPointer<vtkMapper>>(entry->reductions.size()));
+
+	// The job works on its own copy; levels are decimated one after the other, each from the previous
+	// one, and published as soon as they are ready. The deep copy costs a pass over the source on this
+	// thread (the render thread of a threaded viewer), but a shallow one would share arrays that upstream
+	// filters may rewrite in place while the job reads them.
+	vtkSmartPointer<vtkPolyData> copy = vtkSmartPointer<vtkPolyData>::New();
+	copy->DeepCopy(source);
+	const bool computeNormals = source->GetPointData()->GetNormals() != nullptr;
+	const unsigned long entryId = entry->id;
+	const std::shared_ptr<std::atomic<unsigned long>> latestGeneration = entry->generation;
+	const std::vector<double> reductions = entry->reductions;
+
+	workers.submit([this, copy, computeNormals, entryId, generation, latestGeneration, reductions](){
+		// Dragging a slider that changes the source queues a job per change, only the latest is worth running
+		auto stale = [this, generation, &latestGeneration](){
+			return shuttingDown || latestGeneration->load() != generation;
+		};
+		if (stale()){
+			return;
+		}
+		vtkSmartPointer<vtkTriangleFilter> triangles = vtkSmartPointer<vtkTriangleFilter>::New();
+		triangles->SetInputData(copy);
+		triangles->PassVertsOff();
+		triangles->PassLinesOff();
+		triangles->Update();
+		vtkSmartPointer<vtkPolyData> previous = triangles->GetOutput();
+		const double fullTriangles = static_cast<double>(std::max<vtkIdType>(1, previous->GetNumberOfPolys()));
+
+		for (size_t level = 0; level < reductions.size(); level++){
+			if (stale()){
+				return;
+			}
+			const double targetTriangles = fullTriangles * (1.0 - reductions[level]);
+			const double previousTriangles = static_cast<double>(std::max<vtkIdType>(1, previous->GetNumberOfPolys()));
+
+			vtkSmartPointer<vtkQuadricDecimation> decimation = vtkSmartPointer<vtkQuadricDecimation>::New();
+			decimation->SetInputData(previous);
+			decimation->SetTargetReduction(std::max(0.0, std::min(0.999, 1.0 - targetTriangles / previousTriangles)));
+			decimation->VolumePreservationOn();
+			decimation->Update();
+			vtkSmartPointer<vtkPolyData> decimated = decimation->GetOutput();
+
+			vtkSmartPointer<vtkPolyData> output = decimated;
+			if (computeNormals){
+				vtkSmartPointer<vtkPolyDataNormals> normals = vtkSmartPointer<vtkPolyDataNormals>::New();
+				normals->SetInputData(decimated);
+				normals->SplittingOff();
+				normals->Update();
+				output = normals->GetOutput();
+			}
+
+			Result result;
+			result.entryId = entryId;
+			result.generation = generation;
+			result.level = level;
+			result.polyData = output;
+			{
+				std::lock_guard<std::mutex> lock(resultsMutex);
+				results.push_back(result);
+			}
+			previous = decimated;
+		}
+	});
+}
+
+void VtkLodManager::collectResults(){
+	std::vector<Result> finished;
+	{
+		std::lock_guard<std::mutex> lock(resultsMutex);
+		finished.swap(results);
+	}
+
+	for (auto& result : finished){
+		Entry* entry = findEntry(result.entryId);
+		if (!entry || entry->generation->load() != result.generation){
+			continue;
+		}
+		// Same mapper class as the full level (e.g. VtkCompactPolyDataMapper), with its settings
+		vtkMapper* fullMapper = entry->lodMapper->GetFullMapper();
+		vtkSmartPointer<vtkMapper> mapper = vtkSmartPointer<vtkMapper>::Take(fullMapper->NewInstance());
+		mapper->ShallowCopy(fullMapper); // coloring, scalar visibility, clipping planes, ...
+		mapper->SetInputDataObject(0, result.polyData);
+
+		std::vector<vtkSmartPointer<vtkMapper>> levels;
+		for (int level = 1; level < entry->lodMapper->GetNumberOfLevels(); level++){
+			levels.push_back(entry->lodMapper->GetLevelMapper(level));
+		}
+		levels[result.level] = mapper;
+		entry->lodMapper->SetLevelMappers(levels);
+		entry->lodMapper->Modified(); // lets every viewer showing the actor know a new level is available
+		entry->levelTriangles[result.level + 1] = result.polyData->GetNumberOfPolys();
+	}
+}
+
+double VtkLodManager::projectedArea(vtkRenderer* renderer, const double bounds[6], int viewportWidth, int viewportHeight){
+	double minX = DBL_MAX, minY = DBL_MAX, maxX = -DBL_MAX, maxY = -DBL_MAX;
+	for (int corner = 0; corner < 8; corner++){
+		renderer->SetWorldPoint(bounds[corner & 1], bounds[2 + ((corner >> 1) & 1)], bounds[4 + ((corner >> 2) & 1)], 1.0);
+		renderer->WorldToDisplay();
+		double* display = renderer->GetDisplayPoint();
+		minX = std::min(minX, display[0]);
+		maxX = std::max(maxX, display[0]);
+		minY = std::min(minY, display[1]);
+		maxY = std::max(maxY, display[1]);
+	}
+	// Only the part of the box that is inside the viewport costs pixels
+	minX = std::max(minX, 0.0);
+	minY = std::max(minY, 0.0);
+	maxX = std::min(maxX, static_cast<double>(viewportWidth));
+	maxY = std::min(maxY, static_cast<double>(viewportHeight));
+	if (maxX <= minX || maxY <= minY){
+		return 0.0;
+	}
+	return (maxX - minX) * (maxY - minY);
+}
+
+bool VtkLodManager::selectLevels(vtkRenderer* renderer, int viewportWidth, int viewportHeight){
+	collectResults();
+
+	bool changed = false;
+	for (auto& entry : entries){
+		vtkActor* actor = entry->actor;
+		if (!actor || actor->GetMapper() != entry->lodMapper.GetPointer()){
+			continue;
+		}
+
+		// Rebuild the levels when the source polydata changed
+		vtkMapper* fullMapper = entry->lodMapper->GetFullMapper();
+		vtkPolyData* source = vtkPolyData::SafeDownCast(fullMapper->GetInputDataObject(0, 0));
+		if (source && source->GetMTime() != entry->sourceTime){
+			schedule(entry.get());
+		}
+
+		double bounds[6];
+		actor->GetBounds(bounds);
+		if (!vtkMath::AreBoundsInitialized(bounds)){
+			changed |= entry->lodMapper->SelectLevel(renderer, 0);
+			continue;
+		}
+		const double budget = projectedArea(renderer, bounds, viewportWidth, viewportHeight) * trianglesPerPixel;
+
+		// Finest ready level that fits the budget, the coarsest ready level otherwise
+		int selected = 0;
+		for (int level = 0; level < entry->lodMapper->GetNumberOfLevels(); level++){
+			if (!entry->lodMapper->GetLevelMapper(level)){
+				continue;
+			}
+			selected = level;
+			if (level >= static_cast<int>(entry->levelTriangles.size()) || static_cast<double>(entry->levelTriangles[level]) <= budget){
+				break;
+			}
+		}
+		changed |= entry->lodMapper->SelectLevel(renderer, selected);
+	}
+	return changed;
+}
+
+int VtkLodManager::getLevelCount(vtkActor* actor) const{
+	Entry* entry = findEntry(actor);
+	return entry ? entry->lodMapper->GetNumberOfLevels() : 0;
+}
+
+vtkIdType VtkLodManager::getLevelTriangles(vtkActor* actor, int level) const{
+	Entry* entry = findEntry(actor);
+	if (!entry || level < 0 || level >= static_cast<int>(entry->levelTriangles.size())){
+		return 0;
+	}
+	return entry->levelTriangles[level];
+}
+
+int VtkLodManager::getSelectedLevel(vtkActor* actor, vtkRenderer* renderer) const{
+	Entry* entry = findEntry(actor);
+	return entry ? entry->lodMapper->GetSelectedLevel(renderer) : 0;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <vtkActor.h>
+#include <vtkMapper.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+#include <vtkWeakPointer.h>
+
+#include "VtkWorkerPool.h"
+
+class vtkRenderer;
+
+// Mapper installed on LOD-managed actors: renders the level selected for the renderer being drawn,
+// so the same actor can use different levels in different viewers without touching the actor's MTime
+class VtkLodMapper : public vtkMapper {
+public:
+	static VtkLodMapper* New();
+	vtkTypeMacro(VtkLodMapper, vtkMapper);
+public:
+	void Render(vtkRenderer* ren, vtkActor* actor) override;
+	void ReleaseGraphicsResources(vtkWindow* window) override;
+	using vtkMapper::GetBounds;
+	double* GetBounds() override;
+	bool HasOpaqueGeometry() override;
+	bool HasTranslucentPolygonalGeometry() override;
+
+	void SetFullMapper(vtkMapper* mapper);
+	inline vtkMapper* GetFullMapper() {
+		return FullMapper;
+	}
+	// Levels ordered from finest to coarsest; level 0 is the full mapper
+	void SetLevelMappers(const std::vector<vtkSmartPointer<vtkMapper>>& mappers);
+	int GetNumberOfLevels() const;
+	vtkMapper* GetLevelMapper(int level);
+	// Selection is per renderer and intentionally does not call Modified(); returns true if the level changed
+	bool SelectLevel(vtkRenderer* ren, int level);
+	int GetSelectedLevel(vtkRenderer* ren) const;
+protected:
+	VtkLodMapper() = default;
+	~VtkLodMapper() override = default;
+protected:
+	vtkSmartPointer<vtkMapper> FullMapper;
+	std::vector<vtkSmartPointer<vtkMapper>> LevelMappers;
+	std::map<vtkRenderer*, int> SelectedLevels;
+private:
+	VtkLodMapper(const VtkLodMapper&) = delete;
+	void operator=(const VtkLodMapper&) = delete;
+};
+
+// Precomputes decimated versions of actors' polydata on background threads and, for every viewer,
+// picks the level whose triangle count fits the prop's projected size on screen.
+// Attach it to viewers with VtkViewer::setLodManager(); the same manager can serve several viewers.
+class VtkLodManager {
+public:
+	// workerThreads = 0 uses std::thread::hardware_concurrency()
+	explicit VtkLodManager(unsigned int workerThreads = 0);
+	~VtkLodManager();
+
+	VtkLodManager(const VtkLodManager&) = delete;
+	VtkLodManager& operator=(const VtkLodManager&) = delete;
+public:
+	// Reductions are fractions of the full triangle count to remove for each level, finest first
+	void addActor(vtkActor* actor, const std::vector<double>& reductions = std::vector<double>{0.5, 0.8, 0.95});
+	void removeActor(vtkActor* actor);
+	// Called by VtkViewer right before rendering renderer into a viewportWidth x viewportHeight target
+	// Returns true if a different level was selected for any actor
+	bool selectLevels(vtkRenderer* renderer, int viewportWidth, int viewportHeight);
+public:
+	// Triangle budget per covered pixel of a prop's screen-space bounding box
+	inline void setTrianglesPerPixel(double trianglesPerPixel) {
+		this->trianglesPerPixel = trianglesPerPixel;
+	}
+
+	inline double getTrianglesPerPixel() const {
+		return trianglesPerPixel;
+	}
+
+	inline size_t getPendingJobs() const {
+		return workers.getPendingTasks();
+	}
+
+	// Level 0 is the full-resolution polydata; returns 0 when the actor isn't managed
+	int getLevelCount(vtkActor* actor) const;
+	vtkIdType getLevelTriangles(vtkActor* actor, int level) const;
+	int getSelectedLevel(vtkActor* actor, vtkRenderer* renderer) const;
+private:
+	struct Entry {
+		unsigned long id;
+		vtkWeakPointer<vtkActor> actor;
+		vtkSmartPointer<VtkLodMapper> lodMapper;
+		std::vector<double> reductions;
+		std::vector<vtkIdType> levelTriangles;
+		vtkMTimeType sourceTime;
+		// Bumped whenever the source changes (and on removal): jobs of older generations stop early and their
+		// results are dropped. Shared with the jobs, which may outlive the entry.
+		std::shared_ptr<std::atomic<unsigned long>> generation;
+	};
+	struct Result {
+		unsigned long entryId;
+		unsigned long generation;
+		size_t level; // index into reductions
+		vtkSmartPointer<vtkPolyData> polyData;
+	};
+private:
+	Entry* findEntry(vtkActor* actor) const;
+	Entry* findEntry(unsigned long id) const;
+	void schedule(Entry* entry);
+	void collectResults();
+	static double projectedArea(vtkRenderer* renderer, const double bounds[6], int viewportWidth, int viewportHeight);
+private:
+	std::vector<std::unique_ptr<Entry>> entries;
+	unsigned long nextEntryId;
+	std::mutex resultsMutex;
+	std::vector<Result> results;
+	double trianglesPerPixel;
+	std::atomic<bool> shuttingDown;
+	VtkWorkerPool workers; // declared last: joined before the members its jobs write to are destroyed
+};
@@ -0,0 +1,289 @@
+#include "VtkMprReslicer.h"
+#include "VtkViewer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <vtkDataArray.h>
+#include <vtkImageProperty.h>
+#include <vtkMath.h>
+#include <vtkPointData.h>
+
+namespace {
+	const size_t rowsPerChunk = 8; // parallelFor grain
+}
+
+VtkMprReslicer::VtkMprReslicer(vtkImageData* volume, unsigned int workerThreads)
+	: volume(volume), volumeMTime(0), background(0.0), stats(), rateReslices(0), workers(workerThreads){
+	if (!volume || !readVolumeGeometry()){
+		throw VtkViewerError("VtkMprReslicer needs a vtkImageData with single-component scalars and at least 2 points per axis");
+	}
+	volumeMTime = volume->GetMTime();
+	double bounds[6];
+	volume->GetBounds(bounds);
+	for (int i = 0; i < 3; i++){
+		center[i] = (bounds[i * 2] + bounds[i * 2 + 1]) / 2.0;
+	}
+	pixelSpacing = std::min(spacing[0], std::min(spacing[1], spacing[2]));
+	setOrientation(0.0, 0.0, 0.0);
+	rateStart = std::chrono::steady_clock::now();
+}
+
+bool VtkMprReslicer::readVolumeGeometry(){
+	vtkDataArray* scalars = volume->GetPointData()->GetScalars();
+	volume->GetDimensions(dimensions);
+	if (!scalars || scalars->GetNumberOfComponents() != 1 || dimensions[0] < 2 || dimensions[1] < 2 || dimensions[2] < 2){
+		return false;
+	}
+	volume->GetOrigin(origin);
+	volume->GetSpacing(spacing);
+	return true;
+}
+
+int VtkMprReslicer::addPlane(const double u[3], const double v[3], int width, int height){
+	Plane plane;
+	for (int i = 0; i < 3; i++){
+		plane.u[i] = u[i];
+		plane.v[i] = v[i];
+	}
+	plane.width = std::max(1, width);
+	plane.height = std::max(1, height);
+	plane.dirty = true;
+	plane.image = vtkSmartPointer<vtkImageData>::New();
+	allocate(plane);
+	plane.actor = vtkSmartPointer<vtkImageActor>::New();
+	plane.actor->SetInputData(plane.image);
+	plane.actor->GetProperty()->SetInterpolationTypeToLinear();
+	planes.push_back(plane);
+	return static_cast<int>(planes.size()) - 1;
+}
+
+int VtkMprReslicer::addPlane(VtkMprOrientation orientation, int width, int height){
+	static const double x[3] = {1.0, 0.0, 0.0}, y[3] = {0.0, 1.0, 0.0}, z[3] = {0.0, 0.0, 1.0};
+	switch (orientation){
+	case VtkMprOrientation::Coronal:
+		return addPlane(x, z, width, height);
+	case VtkMprOrientation::Sagittal:
+		return addPlane(y, z, width, height);
+	default:
+		return addPlane(x, y, width, height);
+	}
+}
+
+void VtkMprReslicer::setPlaneSize(int plane, int width, int height){
+	Plane& p = planes[plane];
+	width = std::max(1, width);
+	height = std::max(1, height);
+	if (p.width != width || p.height != height){
+		p.width = width;
+		p.height = height;
+		p.dirty = true;
+	}
+}
+
+void VtkMprReslicer::setCenter(const double center[3]){
+	for (int i = 0; i < 3; i++){
+		this->center[i] = center[i];
+	}
+	markAllDirty();
+}
+
+void VtkMprReslicer::moveAlongNormal(int plane, double distance){
+	double normal[3];
+	getNormal(plane, normal);
+	for (int i = 0; i < 3; i++){
+		center[i] += distance * normal[i];
+	}
+	markAllDirty();
+}
+
+void VtkMprReslicer::setOrientation(double yaw, double pitch, double roll){
+	const double cz = std::cos(vtkMath::RadiansFromDegrees(yaw)), sz = std::sin(vtkMath::RadiansFromDegrees(yaw));
+	const double cy = std::cos(vtkMath::RadiansFromDegrees(pitch)), sy = std::sin(vtkMath::RadiansFromDegrees(pitch));
+	const double cx = std::cos(vtkMath::RadiansFromDegrees(roll)), sx = std::sin(vtkMath::RadiansFromDegrees(roll));
+	// Rz * Ry * Rx
+	rotation[0] = cz * cy;
+	rotation[1] = cz * sy * sx - sz * cx;
+	rotation[2] = cz * sy * cx + sz * sx;
+	rotation[3] = sz * cy;
+	rotation[4] = sz * sy * sx + cz * cx;
+	rotation[5] = sz * sy * cx - cz * sx;
+	rotation[6] = -sy;
+	rotation[7] = cy * sx;
+	rotation[8] = cy * cx;
+	markAllDirty();
+}
+
+void VtkMprReslicer::setPixelSpacing(double spacing){
+	if (spacing > 0.0 && spacing != pixelSpacing){
+		pixelSpacing = spacing;
+		markAllDirty();
+	}
+}
+
+void VtkMprReslicer::setBackground(double value){
+	if (value != background){
+		background = value;
+		markAllDirty();
+	}
+}
+
+void VtkMprReslicer::getNormal(int plane, double normal[3]) const{
+	double frameNormal[3];
+	vtkMath::Cross(planes[plane].u, planes[plane].v, frameNormal);
+	worldAxis(frameNormal, normal);
+}
+
+void VtkMprReslicer::worldAxis(const double frameAxis[3], double axis[3]) const{
+	for (int i = 0; i < 3; i++){
+		axis[i] = rotation[i * 3] * frameAxis[0] + rotation[i * 3 + 1] * frameAxis[1] + rotation[i * 3 + 2] * frameAxis[2];
+	}
+}
+
+void VtkMprReslicer::markAllDirty(){
+	for (auto& plane : planes){
+		plane.dirty = true;
+	}
+}
+
+void VtkMprReslicer::allocate(Plane& plane){
+	// Centered on the image origin, so the viewers' cameras stay put while the planes move
+	plane.image->SetSpacing(pixelSpacing, pixelSpacing, pixelSpacing);
+	plane.image->SetOrigin(-(plane.width - 1) * pixelSpacing / 2.0, -(plane.height - 1) * pixelSpacing / 2.0, 0.0);
+	int current[3];
+	plane.image->GetDimensions(current);
+	if (current[0] != plane.width || current[1] != plane.height || current[2] != 1 || !plane.image->GetPointData()->GetScalars()
+		|| plane.image->GetScalarType() != volume->GetScalarType()){
+		plane.image->SetDimensions(plane.width, plane.height, 1);
+		plane.image->AllocateScalars(volume->GetScalarType(), 1);
+	}
+}
+
+VtkMprReslicer::Sampling VtkMprReslicer::sampling(const Plane& plane) const{
+	double u[3], v[3];
+	worldAxis(plane.u, u);
+	worldAxis(plane.v, v);
+	const double halfWidth = (plane.width - 1) / 2.0, halfHeight = (plane.height - 1) / 2.0;
+	Sampling result;
+	for (int i = 0; i < 3; i++){
+		const double corner = center[i] - (halfWidth * u[i] + halfHeight * v[i]) * pixelSpacing;
+		result.origin[i] = (corner - origin[i]) / spacing[i];
+		result.stepU[i] = pixelSpacing * u[i] / spacing[i];
+		result.stepV[i] = pixelSpacing * v[i] / spacing[i];
+	}
+	return result;
+}
+
+template <typename T>
+void VtkMprReslicer::reslice(const Plane& plane, const Sampling& sampling, int firstRow, int lastRow) const{
+	const T* voxels = static_cast<const T*>(volume->GetScalarPointer());
+	T* pixels = static_cast<T*>(plane.image->GetScalarPointer());
+	const float limit[3] = {dimensions[0] - 1.0f, dimensions[1] - 1.0f, dimensions[2] - 1.0f};
+	const int lastCell[3] = {dimensions[0] - 2, dimensions[1] - 2, dimensions[2] - 2};
+	const size_t row = dimensions[0], slice = row * dimensions[1];
+	const T fill = static_cast<T>(background);
+	const bool integral = std::numeric_limits<T>::is_integer;
+
+	for (int j = firstRow; j < lastRow; j++){
+		T* out = pixels + static_cast<size_t>(j) * plane.width;
+		const double start[3] = {sampling.origin[0] + j * sampling.stepV[0], sampling.origin[1] + j * sampling.stepV[1],
+			sampling.origin[2] + j * sampling.stepV[2]};
+		for (int i0 = 0; i0 < plane.width; i0 += Lanes){
+			// Coordinates, cells and weights: independent per lane
+			float tx[Lanes], ty[Lanes], tz[Lanes];
+			size_t offset[Lanes];
+			bool inside[Lanes];
+			for (int l = 0; l < Lanes; l++){
+				const float fx = static_cast<float>(start[0] + (i0 + l) * sampling.stepU[0]);
+				const float fy = static_cast<float>(start[1] + (i0 + l) * sampling.stepU[1]);
+				const float fz = static_cast<float>(start[2] + (i0 + l) * sampling.stepU[2]);
+				inside[l] = fx >= 0.0f && fx <= limit[0] && fy >= 0.0f && fy <= limit[1] && fz >= 0.0f && fz <= limit[2];
+				// Clamped first so that lanes outside the volume still read valid voxels
+				const int ix = std::min(static_cast<int>(std::min(std::max(fx, 0.0f), limit[0])), lastCell[0]);
+				const int iy = std::min(static_cast<int>(std::min(std::max(fy, 0.0f), limit[1])), lastCell[1]);
+				const int iz = std::min(static_cast<int>(std::min(std::max(fz, 0.0f), limit[2])), lastCell[2]);
+				tx[l] = fx - ix;
+				ty[l] = fy - iy;
+				tz[l] = fz - iz;
+				offset[l] = ix + iy * row + iz * slice;
+			}
+
+			// The only scattered part: 8 voxels per lane
+			float c000[Lanes], c100[Lanes], c010[Lanes], c110[Lanes], c001[Lanes], c101[Lanes], c011[Lanes], c111[Lanes];
+			for (int l = 0; l < Lanes; l++){
+				const T* v = voxels + offset[l];
+				c000[l] = static_cast<float>(v[0]);
+				c100[l] = static_cast<float>(v[1]);
+				c010[l] = static_cast<float>(v[row]);
+				c110[l] = static_cast<float>(v[row + 1]);
+				c001[l] = static_cast<float>(v[slice]);
+				c101[l] = static_cast<float>(v[slice + 1]);
+				c011[l] = static_cast<float>(v[slice + row]);
+				c111[l] = static_cast<float>(v[slice + row + 1]);
+			}
+
+			float value[Lanes];
+			for (int l = 0; l < Lanes; l++){
+				const float x00 = c000[l] + tx[l] * (c100[l] - c000[l]);
+				const float x10 = c010[l] + tx[l] * (c110[l] - c010[l]);
+				const float x01 = c001[l] + tx[l] * (c101[l] - c001[l]);
+				const float x11 = c011[l] + tx[l] * (c111[l] - c011[l]);
+				const float y0 = x00 + ty[l] * (x10 - x00);
+				const float y1 = x01 + ty[l] * (x11 - x01);
+				value[l] = y0 + tz[l] * (y1 - y0);
+			}
+
+			const int count = plane.width - i0 < Lanes ? plane.width - i0 : Lanes;
+			for (int l = 0; l < count; l++){
+				out[i0 + l] = !inside[l] ? fill : integral ? static_cast<T>(std::floor(value[l] + 0.5f)) : static_cast<T>(value[l]);
+			}
+		}
+	}
+}
+
+int VtkMprReslicer::update(){
+	if (volume->GetMTime() != volumeMTime){
+		volumeMTime = volume->GetMTime();
+		if (!readVolumeGeometry()){
+			return 0;
+		}
+		markAllDirty();
+	}
+
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	int resliced = 0;
+	double samples = 0.0;
+	for (auto& plane : planes){
+		if (!plane.dirty){
+			continue;
+		}
+		allocate(plane);
+		const Sampling planeSampling = sampling(plane);
+		const Plane& p = plane;
+		workers.parallelFor(0, plane.height, rowsPerChunk, [this, &p, &planeSampling](size_t first, size_t last){
+			switch (volume->GetScalarType()){
+				vtkTemplateMacro(reslice<VTK_TT>(p, planeSampling, static_cast<int>(first), static_cast<int>(last)));
+			}
+		});
+		plane.image->Modified();
+		plane.dirty = false;
+		resliced++;
+		samples += static_cast<double>(plane.width) * plane.height;
+	}
+
+	const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	if (resliced > 0){
+		stats.lastUpdateTime = std::chrono::duration<double, std::milli>(now - start).count();
+		stats.samplesPerSecond = samples / std::max(stats.lastUpdateTime / 1000.0, 1e-9);
+		stats.reslices += resliced;
+		rateReslices += resliced;
+	}
+	const double elapsed = std::chrono::duration<double>(now - rateStart).count();
+	if (elapsed >= 1.0){
+		stats.reslicesPerSecond = rateReslices / elapsed;
+		rateReslices = 0;
+		rateStart = now;
+	}
+	return resliced;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+#include <vtkImageActor.h>
+#include <vtkImageData.h>
+#include <vtkSmartPointer.h>
+
+#include "VtkWorkerPool.h"
+
+// Standard slice orientations, spanned by two axes of the MPR frame (x: left-right, y: posterior-anterior,
+// z: inferior-superior before any rotation)
+enum class VtkMprOrientation {
+	Axial, // x, y
+	Coronal, // x, z
+	Sagittal // y, z
+};
+
+// Throughput of a VtkMprReslicer
+struct VtkMprStats {
+	unsigned long reslices; // planes resliced since construction
+	double reslicesPerSecond; // over the last second
+	double lastUpdateTime; // ms of the last update() that resliced anything
+	double samplesPerSecond; // output pixels per second of reslicing time in that update
+};
+
+// Multi-planar reformat: linked slice planes through one volume, all passing through a shared center and
+// rotated together by an oblique orientation. Each plane is resampled with trilinear interpolation into its own
+// 2D vtkImageData (same scalar type as the volume), reused from one update to the next, shown by a vtkImageActor.
+// Rows are split over a VtkWorkerPool and each row is processed in blocks of Lanes pixels whose coordinate,
+// weight and blend steps are independent, so the compiler vectorizes them; only the 8 voxel reads are gathers.
+// Scalar-only volumes; the volume's direction matrix is ignored.
+class VtkMprReslicer {
+public:
+	static const int Lanes = 8;
+
+	// workerThreads = 0 uses std::thread::hardware_concurrency()
+	explicit VtkMprReslicer(vtkImageData* volume, unsigned int workerThreads = 0);
+
+	VtkMprReslicer(const VtkMprReslicer&) = delete;
+	VtkMprReslicer& operator=(const VtkMprReslicer&) = delete;
+public:
+	// Plane spanned by the unit, orthogonal MPR frame axes u (image x) and v (image y); returns its index
+	int addPlane(const double u[3], const double v[3], int width = 256, int height = 256);
+	int addPlane(VtkMprOrientation orientation, int width = 256, int height = 256);
+	void setPlaneSize(int plane, int width, int height);
+	// Shared center in world coordinates, initially the volume's center
+	void setCenter(const double center[3]);
+	// Moves the center along a plane's normal, i.e. scrolls that plane and moves the other planes' crosshair
+	void moveAlongNormal(int plane, double distance);
+	// Oblique MPR: rotation of the frame about the center, in degrees about z (yaw), then y (pitch), then x (roll)
+	void setOrientation(double yaw, double pitch, double roll);
+	// World units per output pixel, the volume's smallest voxel spacing by default
+	void setPixelSpacing(double spacing);
+	// Value of pixels outside the volume
+	void setBackground(double value);
+	// Reslices the planes whose geometry changed, or all of them if the volume was modified; returns how many.
+	// Blocks until done (the calling thread works too). Call before rendering the viewers showing the planes,
+	// under their lockScene() when threaded.
+	int update();
+public:
+	inline int getPlaneCount() const {
+		return static_cast<int>(planes.size());
+	}
+
+	inline const vtkSmartPointer<vtkImageData>& getImage(int plane) const {
+		return planes[plane].image;
+	}
+
+	inline const vtkSmartPointer<vtkImageActor>& getActor(int plane) const {
+		return planes[plane].actor;
+	}
+
+	inline const double* getCenter() const {
+		return center;
+	}
+
+	inline double getPixelSpacing() const {
+		return pixelSpacing;
+	}
+
+	// Plane normal in world coordinates
+	void getNormal(int plane, double normal[3]) const;
+
+	inline const VtkMprStats& getStats() const {
+		return stats;
+	}
+
+	inline unsigned int getThreadCount() const {
+		return workers.getThreadCount() + 1; // parallelFor uses the caller too
+	}
+private:
+	struct Plane {
+		double u[3], v[3]; // MPR frame axes
+		int width, height;
+		bool dirty;
+		vtkSmartPointer<vtkImageData> image;
+		vtkSmartPointer<vtkImageActor> actor;
+	};
+	// Continuous voxel index of output pixel (i, j): origin + i * stepU + j * stepV
+	struct Sampling {
+		double origin[3], stepU[3], stepV[3];
+	};
+private:
+	// Dimensions, origin and spacing of the volume; false if it can't be resliced
+	bool readVolumeGeometry();
+	void worldAxis(const double frameAxis[3], double axis[3]) const;
+	void allocate(Plane& plane);
+	Sampling sampling(const Plane& plane) const;
+	void markAllDirty();
+	template <typename T>
+	void reslice(const Plane& plane, const Sampling& sampling, int firstRow, int lastRow) const;
+private:
+	vtkSmartPointer<vtkImageData> volume;
+	vtkMTimeType volumeMTime; // at the last update()
+	int dimensions[3];
+	double origin[3], spacing[3];
+	double center[3];
+	double rotation[9]; // row major, frame to world
+	double pixelSpacing;
+	double background;
+	std::vector<Plane> planes;
+
+	VtkMprStats stats;
+	std::chrono::steady_clock::time_point rateStart;
+	unsigned long rateReslices; // since rateStart
+
+	VtkWorkerPool workers;
+};
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <vtkImageData.h>
+#include <vtkSmartPointer.h>
+#include <vtkTypeTraits.h>
+
+// Right-hand sides of 3-variable autonomous ODEs: function objects computing dx/dt, dy/dt, dz/dt.
+// They are template arguments of the integrators and the engine, so every call is inlined.
+struct VtkLorenzSystem {
+	double sigma = 10.0, rho = 28.0, beta = 2.667;
+
+	template <typename Real>
+	inline void operator()(Real x, Real y, Real z, Real& dx, Real& dy, Real& dz) const {
+		dx = Real(sigma) * (y - x);
+		dy = x * (Real(rho) - z) - y;
+		dz = x * y - Real(beta) * z;
+	}
+};
+
+struct VtkRosslerSystem {
+	double a = 0.2, b = 0.2, c = 5.7;
+
+	template <typename Real>
+	inline void operator()(Real x, Real y, Real z, Real& dx, Real& dy, Real& dz) const {
+		dx = -y - z;
+		dy = x + Real(a) * y;
+		dz = Real(b) + z * (x - Real(c));
+	}
+};
+
+struct VtkThomasSystem {
+	double b = 0.208186;
+
+	template <typename Real>
+	inline void operator()(Real x, Real y, Real z, Real& dx, Real& dy, Real& dz) const {
+		dx = std::sin(y) - Real(b) * x;
+		dy = std::sin(z) - Real(b) * y;
+		dz = std::sin(x) - Real(b) * z;
+	}
+};
+
+// One step of size h of the system from (x, y, z), in place
+struct VtkEulerIntegrator {
+	template <typename System, typename Real>
+	static inline void step(const System& system, Real& x, Real& y, Real& z, Real h){
+		Real dx, dy, dz;
+		system(x, y, z, dx, dy, dz);
+		x += h * dx;
+		y += h * dy;
+		z += h * dz;
+	}
+};
+
+struct VtkRk4Integrator {
+	template <typename System, typename Real>
+	static inline void step(const System& system, Real& x, Real& y, Real& z, Real h){
+		const Real half = h / Real(2);
+		Real k1x, k1y, k1z, k2x, k2y, k2z, k3x, k3y, k3z, k4x, k4y, k4z;
+		system(x, y, z, k1x, k1y, k1z);
+		system(x + half * k1x, y + half * k1y, z + half * k1z, k2x, k2y, k2z);
+		system(x + half * k2x, y + half * k2y, z + half * k2z, k3x, k3y, k3z);
+		system(x + h * k3x, y + h * k3y, z + h * k3z, k4x, k4y, k4z);
+		const Real sixth = h / Real(6);
+		x += sixth * (k1x + Real(2) * (k2x + k3x) + k4x);
+		y += sixth * (k1y + Real(2) * (k2y + k3y) + k4y);
+		z += sixth * (k1z + Real(2) * (k2z + k3z) + k4z);
+	}
+};
+
+// Density volume of ODE trajectories: Lanes independent trajectories are integrated in lockstep and every
+// sample is counted in the voxel it falls in, directly in the scalars of a vtkImageData.
+// The right-hand side, integrator, state precision (Real) and counter type (Count, saturating for integer
+// types) are template parameters, so each combination compiles to its own loop without indirect calls; the
+// lanes are independent, which lets the compiler vectorize the integration step across them.
+template <typename System, typename Integrator = VtkEulerIntegrator, typename Real = double, typename Count = short, int Lanes = 8>
+class VtkOdeVolumeEngine {
+public:
+	// resolution^3 voxels spanning bounds (xmin, xmax, ymin, ymax, zmin, zmax), written into output (e.g. a
+	// vtkStructuredPoints) or a new vtkImageData; the scalars are allocated and zeroed here
+	VtkOdeVolumeEngine(const System& system, int resolution, const double bounds[6], vtkImageData* output = nullptr)
+		: system(system), resolution(std::max(1, resolution)){
+		if (output){
+			image = output;
+		}
+		else{
+			image = vtkSmartPointer<vtkImageData>::New();
+		}
+		double spacing[3];
+		for (int i = 0; i < 3; i++){
+			spacing[i] = (bounds[i * 2 + 1] - bounds[i * 2]) / this->resolution;
+			origin[i] = Real(bounds[i * 2]);
+			inverseSpacing[i] = Real(1.0 / spacing[i]);
+		}
+		image->SetDimensions(this->resolution, this->resolution, this->resolution);
+		image->SetOrigin(bounds[0], bounds[2], bounds[4]);
+		image->SetSpacing(spacing);
+		image->AllocateScalars(vtkTypeTraits<Count>::VTK_TYPE_ID, 1);
+		voxels = static_cast<Count*>(image->GetScalarPointer());
+		clear();
+
+		const double start[3] = {1.0, 1.0, 1.0};
+		seed(start);
+	}
+
+	VtkOdeVolumeEngine(const VtkOdeVolumeEngine&) = delete;
+	VtkOdeVolumeEngine& operator=(const VtkOdeVolumeEngine&) = delete;
+public:
+	// Lane i starts at state + i * spread along x (trajectories of chaotic systems separate quickly)
+	void seed(const double state[3], double spread = 1e-3){
+		for (int lane = 0; lane < Lanes; lane++){
+			x[lane] = Real(state[0] + lane * spread);
+			y[lane] = Real(state[1]);
+			z[lane] = Real(state[2]);
+		}
+	}
+
+	void clear(){
+		std::fill(voxels, voxels + static_cast<size_t>(resolution) * resolution * resolution, Count(0));
+		image->Modified();
+	}
+
+	// Advances every lane by steps / Lanes steps of size h; returns the samples counted (inside the bounds and
+	// below saturation)
+	long long run(long long steps, double h){
+		// Local copies: the compiler can't assume the voxels don't alias member arrays
+		Real lx[Lanes], ly[Lanes], lz[Lanes];
+		std::copy(x, x + Lanes, lx);
+		std::copy(y, y + Lanes, ly);
+		std::copy(z, z + Lanes, lz);
+		const Real step = Real(h);
+		const Real size = Real(resolution);
+		const size_t slice = static_cast<size_t>(resolution) * resolution;
+		const Count saturated = std::numeric_limits<Count>::max();
+
+		long long counted = 0;
+		for (long long round = 0; round < steps / Lanes; round++){
+			for (int lane = 0; lane < Lanes; lane++){
+				Integrator::step(system, lx[lane], ly[lane], lz[lane], step);
+			}
+			for (int lane = 0; lane < Lanes; lane++){
+				const Real fx = (lx[lane] - origin[0]) * inverseSpacing[0];
+				const Real fy = (ly[lane] - origin[1]) * inverseSpacing[1];
+				const Real fz = (lz[lane] - origin[2]) * inverseSpacing[2];
+				if (!(fx >= Real(0) && fx < size && fy >= Real(0) && fy < size && fz >= Real(0) && fz < size)){
+					continue;
+				}
+				Count& voxel = voxels[static_cast<size_t>(fx) + static_cast<size_t>(fy) * resolution + static_cast<size_t>(fz) * slice];
+				if (voxel < saturated){
+					voxel += Count(1);
+					counted++;
+				}
+			}
+		}
+
+		std::copy(lx, lx + Lanes, x);
+		std::copy(ly, ly + Lanes, y);
+		std::copy(lz, lz + Lanes, z);
+		image->Modified();
+		return counted;
+	}
+public:
+	inline const vtkSmartPointer<vtkImageData>& getImage() const {
+		return image;
+	}
+
+	inline void getState(int lane, double state[3]) const {
+		state[0] = x[lane];
+		state[1] = y[lane];
+		state[2] = z[lane];
+	}
+private:
+	System system;
+	const int resolution;
+	Real origin[3], inverseSpacing[3];
+	vtkSmartPointer<vtkImageData> image;
+	Count* voxels; // image scalars
+	Real x[Lanes], y[Lanes], z[Lanes];
+};
@@ -0,0 +1,95 @@
+#include "VtkOrientationMarker.h"
+
+#include <cmath>
+
+#include <vtkAxesActor.h>
+#include <vtkRenderer.h>
+
+namespace {
+	// Zooming and panning change the camera position slightly without turning it
+	const double orientationTolerance = 1e-6;
+
+	bool sameDirection(const double a[3], const double b[3]){
+		return std::fabs(a[0] - b[0]) < orientationTolerance && std::fabs(a[1] - b[1]) < orientationTolerance
+			&& std::fabs(a[2] - b[2]) < orientationTolerance;
+	}
+}
+
+VtkOrientationMarker::VtkOrientationMarker()
+	: distance(1.0){
+	viewport[0] = 0.8; viewport[1] = 0.0; viewport[2] = 1.0; viewport[3] = 0.2;
+	direction[0] = direction[1] = direction[2] = 0.0;
+	viewUp[0] = viewUp[1] = viewUp[2] = 0.0;
+
+	viewer.setName(viewer.getName() + " (orientation marker)");
+	viewer.setRenderOnDemand(true);
+	viewer.getRenderer()->SetBackgroundAlpha(0.0);
+	setMarker(vtkSmartPointer<vtkAxesActor>::New());
+}
+
+void VtkOrientationMarker::setMarker(const vtkSmartPointer<vtkProp>& marker){
+	vtkRenderer* renderer = viewer.getRenderer();
+	if (this->marker){
+		renderer->RemoveViewProp(this->marker);
+	}
+	this->marker = marker;
+	if (!marker){
+		return;
+	}
+	renderer->AddViewProp(marker);
+	renderer->ResetCamera();
+	distance = renderer->GetActiveCamera()->GetDistance();
+	direction[0] = direction[1] = direction[2] = 0.0; // forces the camera update on the next draw
+}
+
+void VtkOrientationMarker::setViewport(double xmin, double ymin, double xmax, double ymax){
+	viewport[0] = xmin;
+	viewport[1] = ymin;
+	viewport[2] = xmax;
+	viewport[3] = ymax;
+}
+
+void VtkOrientationMarker::draw(vtkCamera* camera, ImDrawList* drawList, const ImVec2& imageMin, const ImVec2& imageMax){
+	if (!marker){
+		return;
+	}
+	const float width = imageMax.x - imageMin.x;
+	const float height = imageMax.y - imageMin.y;
+	const ImVec2 p0(imageMin.x + static_cast<float>(viewport[0]) * width, imageMax.y - static_cast<float>(viewport[3]) * height);
+	const ImVec2 p1(imageMin.x + static_cast<float>(viewport[2]) * width, imageMax.y - static_cast<float>(viewport[1]) * height);
+	if (p1.x - p0.x < 1.0f || p1.y - p0.y < 1.0f){
+		return;
+	}
+
+	if (camera){
+		double cameraDirection[3], cameraViewUp[3];
+		camera->GetDirectionOfProjection(cameraDirection);
+		camera->GetViewUp(cameraViewUp);
+		if (!sameDirection(cameraDirection, direction) || !sameDirection(cameraViewUp, viewUp)){
+			for (int i = 0; i < 3; i++){
+				direction[i] = cameraDirection[i];
+				viewUp[i] = cameraViewUp[i];
+			}
+			// Same orientation as the scene camera, looking at the marker from a fixed distance
+			vtkCamera* markerCamera = viewer.getRenderer()->GetActiveCamera();
+			double focalPoint[3];
+			markerCamera->GetFocalPoint(focalPoint);
+			markerCamera->SetPosition(focalPoint[0] - direction[0] * distance, focalPoint[1] - direction[1] * distance,
+				focalPoint[2] - direction[2] * distance);
+			markerCamera->SetViewUp(viewUp);
+			viewer.getRenderer()->ResetCameraClippingRange();
+		}
+
+		// Renders only if the camera or the size changed; sizes are rounded to avoid re-rendering on every pixel of a resize
+		// In framebuffer pixels so the marker stays sharp on HiDPI displays
+		const ImVec2 framebufferScale = ImGui::GetIO().DisplayFramebufferScale;
+		const unsigned int textureWidth = (static_cast<unsigned int>((p1.x - p0.x) * framebufferScale.x) + 7) & ~7u;
+		const unsigned int textureHeight = (static_cast<unsigned int>((p1.y - p0.y) * framebufferScale.y) + 7) & ~7u;
+		viewer.renderToTexture(textureWidth, textureHeight);
+	}
+	viewer.keepResident();
+
+	if (viewer.getTexture()){
+		drawList->AddImage(reinterpret_cast<void*>(viewer.getTexture()), p0, p1, ImVec2(0, 1), ImVec2(1, 0));
+	}
+}
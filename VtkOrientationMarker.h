@@ -0,0 +1,44 @@
+#pragma once
+
+#include "imgui.h"
+
+#include <vtkCamera.h>
+#include <vtkProp.h>
+#include <vtkSmartPointer.h>
+
+#include "VtkViewer.h"
+
+// Replacement for vtkOrientationMarkerWidget / vtkCameraOrientationWidget: the marker is rendered into a small
+// cached texture only when the camera orientation (or the marker size) changes, and drawn over the viewer's
+// image with the ImGui draw list, so the viewer's render window only has the scene's renderer.
+// Attach with VtkViewer::setOrientationMarker(). The marker isn't interactive.
+class VtkOrientationMarker {
+public:
+	VtkOrientationMarker(); // vtkAxesActor by default
+public:
+	void setMarker(const vtkSmartPointer<vtkProp>& marker);
+	// Fractions of the viewer's image, origin at the bottom left like vtkOrientationMarkerWidget::SetViewport()
+	void setViewport(double xmin, double ymin, double xmax, double ymax);
+	// Called by VtkViewer::render() after drawing its image; camera is null when it can't be read safely
+	// (threaded viewers), the cached texture is drawn as is then
+	void draw(vtkCamera* camera, ImDrawList* drawList, const ImVec2& imageMin, const ImVec2& imageMax);
+public:
+	inline vtkProp* getMarker() const {
+		return marker;
+	}
+
+	// Marker renders so far, to compare against the viewer's own render count
+	inline unsigned long getRenderCount() const {
+		return viewer.getRenderCount();
+	}
+
+	inline VtkViewer& getViewer() {
+		return viewer;
+	}
+private:
+	VtkViewer viewer;
+	vtkSmartPointer<vtkProp> marker;
+	double viewport[4];
+	double distance; // marker camera distance from the marker's center
+	double direction[3], viewUp[3]; // orientation the texture was rendered for
+};
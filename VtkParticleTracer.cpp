@@ -0,0 +1,312 @@
+#include "VtkParticleTracer.h"
+#include "VtkViewer.h"
+
+#include <chrono>
+#include <cmath>
+#include <iterator>
+
+#include <vtkCellArray.h>
+#include <vtkDataArray.h>
+#include <vtkFloatArray.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+
+namespace {
+	const int stepsPerBatch = 32; // per particle, between checks of the flags and the clock
+	const int stepsPerPoint = 4; // steps between recorded trail points
+	const size_t particlesPerChunk = 64; // parallelFor grain
+}
+
+VtkParticleTracer::VtkParticleTracer(vtkImageData* field, unsigned int workerThreads)
+	: activeParticles(0), steps(0), publishes(0), running(false), stepSize(0.0), maximumSteps(4000),
+	publishInterval(0.1), publishedStats(), stats(), workers(workerThreads){
+	vtkDataArray* fieldVectors = field ? field->GetPointData()->GetVectors() : nullptr;
+	if (!fieldVectors && field){
+		fieldVectors = field->GetPointData()->GetScalars();
+	}
+	int fieldDimensions[3] = {0, 0, 0};
+	if (field){
+		field->GetDimensions(fieldDimensions);
+	}
+	if (!fieldVectors || fieldVectors->GetNumberOfComponents() != 3
+		|| fieldDimensions[0] < 2 || fieldDimensions[1] < 2 || fieldDimensions[2] < 2){
+		throw VtkViewerError("VtkParticleTracer needs a vtkImageData with 3-component point vectors and at least 2 points per axis");
+	}
+
+	const double* fieldOrigin = field->GetOrigin();
+	const double* fieldSpacing = field->GetSpacing();
+	for (int i = 0; i < 3; i++){
+		dimensions[i] = fieldDimensions[i];
+		origin[i] = static_cast<float>(fieldOrigin[i]);
+		inverseSpacing[i] = static_cast<float>(1.0 / fieldSpacing[i]);
+	}
+
+	const vtkIdType points = fieldVectors->GetNumberOfTuples();
+	vectors.resize(static_cast<size_t>(points) * 3);
+	double maximumSpeed = 0.0;
+	for (vtkIdType id = 0; id < points; id++){
+		double v[3];
+		fieldVectors->GetTuple(id, v);
+		vectors[id * 3] = static_cast<float>(v[0]);
+		vectors[id * 3 + 1] = static_cast<float>(v[1]);
+		vectors[id * 3 + 2] = static_cast<float>(v[2]);
+		maximumSpeed = std::max(maximumSpeed, std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]));
+	}
+	const double minimumSpacing = std::min(fieldSpacing[0], std::min(fieldSpacing[1], fieldSpacing[2]));
+	stepSize = maximumSpeed > 0.0 ? 0.5 * minimumSpacing / maximumSpeed : minimumSpacing;
+	stats.threads = publishedStats.threads = workers.getThreadCount() + 1; // parallelFor uses the caller too
+
+	mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+	mapper->SetInputData(vtkSmartPointer<vtkPolyData>::New());
+	mapper->ScalarVisibilityOff();
+	actor = vtkSmartPointer<vtkActor>::New();
+	actor->SetMapper(mapper);
+}
+
+VtkParticleTracer::~VtkParticleTracer(){
+	stop();
+}
+
+void VtkParticleTracer::start(){
+	if (running){
+		return;
+	}
+	running = true;
+	worker = std::thread(&VtkParticleTracer::run, this);
+}
+
+void VtkParticleTracer::stop(){
+	{
+		std::lock_guard<std::mutex> lock(seedMutex);
+		running = false;
+	}
+	seedsAvailable.notify_all();
+	if (worker.joinable()){
+		worker.join();
+	}
+}
+
+void VtkParticleTracer::seed(const double center[3], double radius, int count){
+	std::uniform_real_distribution<double> unit(-1.0, 1.0);
+	std::vector<Particle> seeds(std::max(0, count));
+	for (auto& particle : seeds){
+		double offset[3];
+		do {
+			offset[0] = unit(seedRandom);
+			offset[1] = unit(seedRandom);
+			offset[2] = unit(seedRandom);
+		} while (offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2] > 1.0);
+		for (int i = 0; i < 3; i++){
+			particle.position[i] = static_cast<float>(center[i] + radius * offset[i]);
+		}
+		particle.steps = 0;
+		particle.active = true;
+		particle.trail.assign(particle.position, particle.position + 3);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(seedMutex);
+		pendingSeeds.insert(pendingSeeds.end(), seeds.begin(), seeds.end());
+	}
+	if (running){
+		seedsAvailable.notify_all();
+	}
+	else{
+		mergeSeeds();
+		publish(0.0, 0.0); // shows where the new particles start
+	}
+}
+
+void VtkParticleTracer::clear(){
+	const bool wasRunning = running;
+	stop();
+	{
+		std::lock_guard<std::mutex> lock(seedMutex);
+		pendingSeeds.clear();
+	}
+	particles.clear();
+	activeParticles = 0;
+	steps = 0;
+	publish(0.0, 0.0); // the empty streamlines
+	if (wasRunning){
+		start();
+	}
+}
+
+bool VtkParticleTracer::update(){
+	std::lock_guard<std::mutex> lock(publishMutex);
+	if (!published){
+		return false;
+	}
+	mapper->SetInputData(published);
+	published = nullptr;
+	stats = publishedStats;
+	return true;
+}
+
+void VtkParticleTracer::setStepSize(double h){
+	if (h > 0.0){
+		stepSize = h;
+	}
+}
+
+void VtkParticleTracer::setMaximumSteps(int steps){
+	maximumSteps = std::max(1, steps);
+}
+
+void VtkParticleTracer::setPublishInterval(double seconds){
+	publishInterval = std::max(0.01, seconds);
+}
+
+void VtkParticleTracer::setPublishCallback(const std::function<void()>& callback){
+	const bool wasRunning = running;
+	stop();
+	publishCallback = callback;
+	if (wasRunning){
+		start();
+	}
+}
+
+void VtkParticleTracer::mergeSeeds(){
+	std::vector<Particle> seeds;
+	{
+		std::lock_guard<std::mutex> lock(seedMutex);
+		seeds.swap(pendingSeeds);
+	}
+	activeParticles += seeds.size();
+	std::move(seeds.begin(), seeds.end(), std::back_inserter(particles));
+}
+
+unsigned long long VtkParticleTracer::advect(size_t first, size_t last){
+	const float h = static_cast<float>(stepSize.load());
+	const float half = h * 0.5f;
+	const int limit = maximumSteps;
+	unsigned long long taken = 0;
+	for (size_t p = first; p < last; p++){
+		Particle& particle = particles[p];
+		if (!particle.active){
+			continue;
+		}
+		float x = particle.position[0], y = particle.position[1], z = particle.position[2];
+		for (int step = 0; step < stepsPerBatch; step++){
+			float v[3], mid[3];
+			if (particle.steps >= limit || !sample(x, y, z, v)
+				|| !sample(x + half * v[0], y + half * v[1], z + half * v[2], mid)
+				|| mid[0] * mid[0] + mid[1] * mid[1] + mid[2] * mid[2] < 1e-12f){
+				particle.active = false;
+				break;
+			}
+			x += h * mid[0];
+			y += h * mid[1];
+			z += h * mid[2];
+			particle.steps++;
+			taken++;
+			if (particle.steps % stepsPerPoint == 0){
+				particle.trail.push_back(x);
+				particle.trail.push_back(y);
+				particle.trail.push_back(z);
+			}
+		}
+		particle.position[0] = x;
+		particle.position[1] = y;
+		particle.position[2] = z;
+		if (!particle.active && particle.steps % stepsPerPoint != 0){
+			particle.trail.push_back(x); // the streamline ends where the particle stopped
+			particle.trail.push_back(y);
+			particle.trail.push_back(z);
+		}
+	}
+	return taken;
+}
+
+void VtkParticleTracer::run(){
+	std::chrono::steady_clock::time_point lastPublish = std::chrono::steady_clock::now();
+	unsigned long long publishedSteps = steps;
+	double advectTime = 0.0;
+	bool changed = false;
+
+	while (running){
+		mergeSeeds();
+		if (activeParticles == 0){
+			if (changed){
+				// The last particles just stopped
+				const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - lastPublish).count();
+				publish((steps - publishedSteps) / std::max(elapsed, 1e-6), advectTime);
+				changed = false;
+			}
+			std::unique_lock<std::mutex> lock(seedMutex);
+			seedsAvailable.wait(lock, [this](){ return !running || !pendingSeeds.empty(); });
+			lastPublish = std::chrono::steady_clock::now();
+			publishedSteps = steps;
+			continue;
+		}
+
+		// Particles are independent: each chunk only writes its own, so the batch needs no locking
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		std::atomic<unsigned long long> taken(0);
+		workers.parallelFor(0, particles.size(), particlesPerChunk, [this, &taken](size_t first, size_t last){
+			taken += advect(first, last);
+		});
+		steps += taken;
+		activeParticles = std::count_if(particles.begin(), particles.end(), [](const Particle& particle){
+			return particle.active;
+		});
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		advectTime = std::chrono::duration<double, std::milli>(now - start).count();
+		changed = true;
+
+		const double elapsed = std::chrono::duration<double>(now - lastPublish).count();
+		if (elapsed >= publishInterval){
+			publish((steps - publishedSteps) / elapsed, advectTime);
+			lastPublish = now;
+			publishedSteps = steps;
+			changed = false;
+		}
+	}
+}
+
+void VtkParticleTracer::publish(double stepsPerSecond, double advectTime){
+	size_t pointCount = 0;
+	for (const auto& particle : particles){
+		pointCount += particle.trail.size() / 3;
+	}
+
+	// One polyline per particle that has moved, points written straight into the float array
+	vtkSmartPointer<vtkFloatArray> coordinates = vtkSmartPointer<vtkFloatArray>::New();
+	coordinates->SetNumberOfComponents(3);
+	coordinates->SetNumberOfTuples(static_cast<vtkIdType>(pointCount));
+	float* out = coordinates->GetPointer(0);
+	vtkSmartPointer<vtkCellArray> lines = vtkSmartPointer<vtkCellArray>::New();
+	vtkIdType next = 0;
+	for (const auto& particle : particles){
+		const vtkIdType count = static_cast<vtkIdType>(particle.trail.size() / 3);
+		out = std::copy(particle.trail.begin(), particle.trail.end(), out);
+		if (count >= 2){
+			lines->InsertNextCell(count);
+			for (vtkIdType i = 0; i < count; i++){
+				lines->InsertCellPoint(next + i);
+			}
+		}
+		next += count;
+	}
+	vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+	points->SetData(coordinates);
+	vtkSmartPointer<vtkPolyData> streamlines = vtkSmartPointer<vtkPolyData>::New();
+	streamlines->SetPoints(points);
+	streamlines->SetLines(lines);
+
+	{
+		std::lock_guard<std::mutex> lock(publishMutex);
+		published = streamlines;
+		publishedStats.particles = particles.size();
+		publishedStats.activeParticles = activeParticles;
+		publishedStats.steps = steps;
+		publishedStats.stepsPerSecond = stepsPerSecond;
+		publishedStats.points = pointCount;
+		publishedStats.advectTime = advectTime;
+		publishedStats.publishes = ++publishes;
+	}
+	if (publishCallback){
+		publishCallback();
+	}
+}
@@ -0,0 +1,169 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <vtkActor.h>
+#include <vtkImageData.h>
+#include <vtkPolyData.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkSmartPointer.h>
+
+#include "VtkWorkerPool.h"
+
+// Progress of a VtkParticleTracer, as of its last published streamlines
+struct VtkParticleTracerStats {
+	size_t particles; // seeded since the last clear()
+	size_t activeParticles; // still inside the field and below the step limit
+	unsigned long long steps; // particle steps since the last clear()
+	double stepsPerSecond;
+	size_t points; // in the published streamlines
+	double advectTime; // ms of the last batch over all active particles
+	unsigned long publishes;
+	unsigned int threads;
+};
+
+// Streamlines of particles advected through a sampled vector field. A controller thread advances all active
+// particles in batches, split over a VtkWorkerPool, with a midpoint (RK2) step on trilinearly interpolated
+// velocities; a particle stops when it leaves the field, stalls or reaches the step limit. A few times per
+// second the trails are published as one polyline per particle, and update() on the scene thread hands the
+// newest ones to the actor's mapper. Seeds can be added at any time, e.g. around a point picked with
+// VtkViewer::pick().
+class VtkParticleTracer {
+public:
+	// field: vtkImageData with 3-component point vectors (or active scalars), copied here; the tracer never
+	// touches it afterwards. workerThreads = 0 uses std::thread::hardware_concurrency().
+	explicit VtkParticleTracer(vtkImageData* field, unsigned int workerThreads = 0);
+	~VtkParticleTracer();
+
+	VtkParticleTracer(const VtkParticleTracer&) = delete;
+	VtkParticleTracer& operator=(const VtkParticleTracer&) = delete;
+public:
+	void start();
+	void stop();
+	// count particles uniformly distributed in the sphere of the given radius around center; they start moving
+	// with the next batch
+	void seed(const double center[3], double radius, int count);
+	// Removes every particle (stops the worker while doing so)
+	void clear();
+	// Scene thread (under VtkViewer::lockScene() when threaded): installs the newest published streamlines,
+	// returns true if there were new ones
+	bool update();
+	// Integration time step; the default moves the fastest particle half a voxel per step
+	void setStepSize(double h);
+	// Steps after which a particle stops (default 4000)
+	void setMaximumSteps(int steps);
+	// s between published streamlines (default 0.1)
+	void setPublishInterval(double seconds);
+	// Called on the thread that publishes new streamlines, e.g. to wake an event loop waiting for input
+	void setPublishCallback(const std::function<void()>& callback);
+public:
+	// Velocity at a world position, trilinearly interpolated; false outside the field
+	inline bool sample(float x, float y, float z, float velocity[3]) const {
+		const float fx = (x - origin[0]) * inverseSpacing[0];
+		const float fy = (y - origin[1]) * inverseSpacing[1];
+		const float fz = (z - origin[2]) * inverseSpacing[2];
+		if (!(fx >= 0.0f && fx <= dimensions[0] - 1 && fy >= 0.0f && fy <= dimensions[1] - 1 && fz >= 0.0f && fz <= dimensions[2] - 1)){
+			return false;
+		}
+		// The last cell of each axis also takes the points on its upper face
+		const int i = std::min(static_cast<int>(fx), dimensions[0] - 2);
+		const int j = std::min(static_cast<int>(fy), dimensions[1] - 2);
+		const int k = std::min(static_cast<int>(fz), dimensions[2] - 2);
+		const float tx = fx - i, ty = fy - j, tz = fz - k;
+		const size_t row = static_cast<size_t>(dimensions[0]) * 3, slice = row * dimensions[1];
+		const float* v000 = vectors.data() + i * 3 + j * row + k * slice;
+		const float* v010 = v000 + row;
+		const float* v001 = v000 + slice;
+		const float* v011 = v001 + row;
+		for (int c = 0; c < 3; c++){
+			const float y0 = (v000[c] + tx * (v000[c + 3] - v000[c])) * (1.0f - ty) + (v010[c] + tx * (v010[c + 3] - v010[c])) * ty;
+			const float y1 = (v001[c] + tx * (v001[c + 3] - v001[c])) * (1.0f - ty) + (v011[c] + tx * (v011[c + 3] - v011[c])) * ty;
+			velocity[c] = y0 + tz * (y1 - y0);
+		}
+		return true;
+	}
+public:
+	inline bool isRunning() const {
+		return running;
+	}
+
+	inline double getStepSize() const {
+		return stepSize;
+	}
+
+	inline int getMaximumSteps() const {
+		return maximumSteps;
+	}
+
+	inline const vtkSmartPointer<vtkActor>& getActor() const {
+		return actor;
+	}
+
+	// Copied by update()
+	inline const VtkParticleTracerStats& getStats() const {
+		return stats;
+	}
+
+	// x min, x max, y min, ... of the field
+	inline void getBounds(double bounds[6]) const {
+		for (int i = 0; i < 3; i++){
+			bounds[i * 2] = origin[i];
+			bounds[i * 2 + 1] = origin[i] + (dimensions[i] - 1) / static_cast<double>(inverseSpacing[i]);
+		}
+	}
+private:
+	struct Particle {
+		float position[3];
+		int steps;
+		bool active;
+		std::vector<float> trail; // x, y, z per recorded point
+	};
+private:
+	void run();
+	void mergeSeeds();
+	// Advances particles [first, last) by one batch; returns the steps taken
+	unsigned long long advect(size_t first, size_t last);
+	// Builds the streamlines and publishes them; only on the worker, or while stopped
+	void publish(double stepsPerSecond, double advectTime);
+private:
+	// Field, read-only once constructed
+	std::vector<float> vectors; // 3 per point, x fastest
+	int dimensions[3];
+	float origin[3], inverseSpacing[3];
+
+	// Worker side
+	std::vector<Particle> particles;
+	size_t activeParticles;
+	unsigned long long steps;
+	unsigned long publishes;
+
+	std::atomic<bool> running;
+	std::atomic<double> stepSize;
+	std::atomic<int> maximumSteps;
+	std::atomic<double> publishInterval;
+	std::function<void()> publishCallback;
+	std::thread worker;
+	std::mt19937 seedRandom; // seed() is called from one thread
+
+	std::mutex seedMutex; // guards the two below
+	std::vector<Particle> pendingSeeds;
+	std::condition_variable seedsAvailable;
+
+	std::mutex publishMutex; // guards the two below
+	vtkSmartPointer<vtkPolyData> published;
+	VtkParticleTracerStats publishedStats;
+
+	// Scene side
+	VtkParticleTracerStats stats;
+	vtkSmartPointer<vtkPolyDataMapper> mapper;
+	vtkSmartPointer<vtkActor> actor;
+
+	VtkWorkerPool workers; // declared last: joined before the particles its batches write to are destroyed
+};
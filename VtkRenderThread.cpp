@@ -0,0 +1,170 @@
+#include "VtkRenderThread.h"
+#include "VtkViewer.h"
+
+// OpenGL Loader
+// This can be replaced with another loader, e.g. glad, but
+// remember to change the corresponding initialize call below!
+#include <GL/gl3w.h>            // GL3w, initialized with gl3wInit()
+
+// Include glfw3.h after our OpenGL definitions
+#include <GLFW/glfw3.h>
+
+VtkRenderThread::VtkRenderThread(VtkViewer* viewer)
+	: viewer(viewer), context(nullptr), back(0), front(1), ready(2), hasFrame(false), events(256),
+	frameRequested(false), stopping(false), requestedWidth(0), requestedHeight(0), rendering(false), publishedFrames(0){
+	for (unsigned int i = 0; i < SlotCount; i++){
+		slots[i].texture = 0;
+		slots[i].width = slots[i].height = 0;
+		slots[i].renderedFence = nullptr;
+		slots[i].releasedFence = nullptr;
+	}
+
+	GLFWwindow* shared = glfwGetCurrentContext();
+	if (!shared){
+		throw VtkViewerError("Threaded rendering needs a current GLFW context to share with");
+	}
+
+	// Same kind of context as the ImGui one, but never shown
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, glfwGetWindowAttrib(shared, GLFW_CONTEXT_VERSION_MAJOR));
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, glfwGetWindowAttrib(shared, GLFW_CONTEXT_VERSION_MINOR));
+	glfwWindowHint(GLFW_OPENGL_PROFILE, glfwGetWindowAttrib(shared, GLFW_OPENGL_PROFILE));
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, glfwGetWindowAttrib(shared, GLFW_OPENGL_FORWARD_COMPAT));
+	context = glfwCreateWindow(1, 1, "VtkViewer render thread", nullptr, shared);
+	glfwDefaultWindowHints();
+	if (!context){
+		throw VtkViewerError("Couldn't create a shared OpenGL context for the render thread");
+	}
+
+	thread = std::thread(&VtkRenderThread::run, this);
+}
+
+VtkRenderThread::~VtkRenderThread(){
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		stopping = true;
+	}
+	wake.notify_one();
+	thread.join();
+	glfwDestroyWindow(context);
+}
+
+unsigned int VtkRenderThread::acquireFrame(){
+	if (ready.load() & DirtyBit){
+		// Everything that sampled the current front texture was submitted in earlier frames
+		slots[front].releasedFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		glFlush(); // the render thread waits on it from another context
+		front = ready.exchange(front) & IndexMask;
+
+		GLsync rendered = static_cast<GLsync>(slots[front].renderedFence);
+		slots[front].renderedFence = nullptr;
+		if (rendered){
+			glWaitSync(rendered, 0, GL_TIMEOUT_IGNORED);
+			glDeleteSync(rendered);
+		}
+		hasFrame = true;
+	}
+	return hasFrame ? slots[front].texture : 0;
+}
+
+void VtkRenderThread::requestFrame(unsigned int width, unsigned int height){
+	{
+		std::lock_guard<std::mutex> lock(wakeMutex);
+		frameRequested = true;
+		requestedWidth = width;
+		requestedHeight = height;
+	}
+	wake.notify_one();
+}
+
+bool VtkRenderThread::pushEvent(const VtkViewerEvent& event){
+	return events.push(event);
+}
+
+void VtkRenderThread::publish(){
+	slots[back].renderedFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();
+	back = ready.exchange(back | DirtyBit) & IndexMask;
+
+	// The slot handed back is either one the ImGui thread released, or a frame it never picked up
+	Slot& slot = slots[back];
+	if (slot.releasedFence){
+		glWaitSync(static_cast<GLsync>(slot.releasedFence), 0, GL_TIMEOUT_IGNORED);
+		glDeleteSync(static_cast<GLsync>(slot.releasedFence));
+		slot.releasedFence = nullptr;
+	}
+	if (slot.renderedFence){
+		glDeleteSync(static_cast<GLsync>(slot.renderedFence));
+		slot.renderedFence = nullptr;
+	}
+	publishedFrames++;
+	glfwPostEmptyEvent(); // wakes the main loop if it is blocked in VtkFramePacer
+}
+
+void VtkRenderThread::run(){
+	glfwMakeContextCurrent(context);
+	for (unsigned int i = 0; i < SlotCount; i++){
+		glGenTextures(1, &slots[i].texture);
+		glBindTexture(GL_TEXTURE_2D, slots[i].texture);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	for (;;){
+		unsigned int width, height;
+		{
+			std::unique_lock<std::mutex> lock(wakeMutex);
+			wake.wait(lock, [this](){ return stopping || frameRequested; });
+			if (stopping){
+				break;
+			}
+			frameRequested = false;
+			width = requestedWidth;
+			height = requestedHeight;
+		}
+		if (width == 0 || height == 0){
+			continue;
+		}
+
+		std::lock_guard<std::mutex> scene(viewer->sceneMutex);
+		Slot& slot = slots[back];
+		if (slot.width != width || slot.height != height){
+			glBindTexture(GL_TEXTURE_2D, slot.texture);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+			glBindTexture(GL_TEXTURE_2D, 0);
+			slot.width = width;
+			slot.height = height;
+		}
+		const bool resized = viewer->prepareThreadedFrame(width, height, slot.texture);
+
+		VtkViewerEvent event;
+		while (events.pop(event)){
+			viewer->replayEvent(event);
+		}
+
+		rendering = true;
+		if (viewer->renderScene(resized)){
+			publish();
+		}
+		rendering = false;
+	}
+
+	{
+		std::lock_guard<std::mutex> scene(viewer->sceneMutex);
+		viewer->releaseGraphicsResources();
+	}
+	for (unsigned int i = 0; i < SlotCount; i++){
+		if (slots[i].renderedFence){
+			glDeleteSync(static_cast<GLsync>(slots[i].renderedFence));
+		}
+		if (slots[i].releasedFence){
+			glDeleteSync(static_cast<GLsync>(slots[i].releasedFence));
+		}
+		glDeleteTextures(1, &slots[i].texture);
+	}
+	glFinish();
+	glfwMakeContextCurrent(nullptr);
+}
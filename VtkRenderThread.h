@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "LockFreeQueue.h"
+
+struct GLFWwindow;
+class VtkViewer;
+
+// Interaction event recorded by VtkViewer::processEvents() on the ImGui thread, replayed on the render thread
+struct VtkViewerEvent {
+	unsigned long eventId;
+	double x, y;
+	int ctrl, shift;
+	bool dclick;
+};
+
+// Worker thread rendering one VtkViewer (see VtkViewer::setThreaded) on a hidden GLFW context shared
+// with the ImGui one. Frames go through a ring of three textures: the render thread draws into its back
+// slot, publishes it with a fence, and the ImGui thread always shows the newest published slot.
+class VtkRenderThread {
+public:
+	// Main thread only (GLFW creates windows there), with the context to share current
+	explicit VtkRenderThread(VtkViewer* viewer);
+	~VtkRenderThread();
+
+	VtkRenderThread(const VtkRenderThread&) = delete;
+	VtkRenderThread& operator=(const VtkRenderThread&) = delete;
+public:
+	// ImGui thread: newest finished frame, 0 until the first one is published
+	unsigned int acquireFrame();
+	// ImGui thread: ask for a frame of the given size, the render thread renders it if the scene changed
+	void requestFrame(unsigned int width, unsigned int height);
+	// ImGui thread: dropped when the render thread falls too far behind
+	bool pushEvent(const VtkViewerEvent& event);
+public:
+	// A published frame hasn't been acquired yet, or one is being rendered
+	inline bool hasNewFrame() const {
+		return (ready.load() & DirtyBit) != 0 || rendering.load();
+	}
+
+	inline unsigned long getPublishedFrames() const {
+		return publishedFrames.load();
+	}
+private:
+	void run();
+	void publish();
+private:
+	static const unsigned int SlotCount = 3;
+	static const unsigned int IndexMask = 0x3;
+	static const unsigned int DirtyBit = 0x4;
+
+	struct Slot {
+		unsigned int texture;
+		unsigned int width, height;
+		void* renderedFence; // GLsync, set by the render thread when the frame is finished
+		void* releasedFence; // GLsync, set by the ImGui thread when it stops sampling the texture
+	};
+private:
+	VtkViewer* viewer;
+	GLFWwindow* context;
+
+	Slot slots[SlotCount];
+	unsigned int back; // render thread
+	unsigned int front; // ImGui thread
+	std::atomic<unsigned int> ready; // slot index | DirtyBit when it holds a frame the ImGui thread hasn't taken
+	bool hasFrame; // ImGui thread
+
+	SpscQueue<VtkViewerEvent> events;
+
+	std::mutex wakeMutex;
+	std::condition_variable wake;
+	bool frameRequested;
+	bool stopping;
+	unsigned int requestedWidth, requestedHeight;
+
+	std::atomic<bool> rendering;
+	std::atomic<unsigned long> publishedFrames;
+
+	std::thread thread; // declared last: started once everything above is initialized
+};
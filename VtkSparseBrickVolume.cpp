@@ -0,0 +1,185 @@
+#include "VtkSparseBrickVolume.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include <vtkAppendPolyData.h>
+#include <vtkFlyingEdges3D.h>
+
+VtkSparseBrickVolume::VtkSparseBrickVolume(int resolution, const double bounds[6], int brickSize)
+	: resolution(std::max(2, resolution)), brickSize(std::max(2, brickSize)),
+	bricksPerSide((this->resolution + this->brickSize - 1) / this->brickSize),
+	brickVoxels(static_cast<size_t>(this->brickSize) * this->brickSize * this->brickSize), contourStats(){
+	for (int i = 0; i < 3; i++){
+		origin[i] = bounds[i * 2];
+		spacing[i] = (bounds[i * 2 + 1] - bounds[i * 2]) / this->resolution;
+		inverseSpacing[i] = 1.0 / spacing[i];
+	}
+	brickSlots.assign(static_cast<size_t>(bricksPerSide) * bricksPerSide * bricksPerSide, -1);
+}
+
+int VtkSparseBrickVolume::allocateBrick(int brick){
+	std::unique_ptr<short[]> voxels(new short[brickVoxels]);
+	std::fill(voxels.get(), voxels.get() + brickVoxels, static_cast<short>(0));
+	bricks.push_back(std::move(voxels));
+	brickSlots[brick] = static_cast<int>(bricks.size()) - 1;
+	return brickSlots[brick];
+}
+
+short VtkSparseBrickVolume::value(int x, int y, int z) const{
+	const int slot = brickSlots[x / brickSize + (y / brickSize + z / brickSize * bricksPerSide) * bricksPerSide];
+	if (slot < 0){
+		return 0;
+	}
+	return bricks[slot][x % brickSize + (y % brickSize + z % brickSize * brickSize) * brickSize];
+}
+
+void VtkSparseBrickVolume::clear(){
+	bricks.clear();
+	std::fill(brickSlots.begin(), brickSlots.end(), -1);
+}
+
+bool VtkSparseBrickVolume::extractBrick(int brick, double isoValue, vtkImageData* image) const{
+	const int bx = brick % bricksPerSide;
+	const int by = (brick / bricksPerSide) % bricksPerSide;
+	const int bz = brick / (bricksPerSide * bricksPerSide);
+	const int x0 = bx * brickSize, y0 = by * brickSize, z0 = bz * brickSize;
+	const int nx = std::min(brickSize + 1, resolution - x0);
+	const int ny = std::min(brickSize + 1, resolution - y0);
+	const int nz = std::min(brickSize + 1, resolution - z0);
+	if (nx < 2 || ny < 2 || nz < 2){
+		return false;
+	}
+
+	// The brick (0) and its upper neighbors along x (1), y (2), z (4) and their combinations
+	const short* neighbors[8];
+	bool anyAllocated = false;
+	for (int n = 0; n < 8; n++){
+		const int cx = bx + (n & 1), cy = by + ((n >> 1) & 1), cz = bz + ((n >> 2) & 1);
+		neighbors[n] = nullptr;
+		if (cx < bricksPerSide && cy < bricksPerSide && cz < bricksPerSide){
+			const int slot = brickSlots[cx + (cy + cz * bricksPerSide) * bricksPerSide];
+			if (slot >= 0){
+				neighbors[n] = bricks[slot].get();
+				anyAllocated = true;
+			}
+		}
+	}
+	if (!anyAllocated){
+		return false; // all zeros
+	}
+
+	std::vector<short> values(static_cast<size_t>(nx) * ny * nz);
+	bool above = false, below = false;
+	short* out = values.data();
+	for (int z = 0; z < nz; z++){
+		const int nzBit = z < brickSize ? 0 : 4, lz = z < brickSize ? z : 0;
+		for (int y = 0; y < ny; y++){
+			const int nyBit = y < brickSize ? 0 : 2, ly = y < brickSize ? y : 0;
+			for (int x = 0; x < nx; x++){
+				const int nxBit = x < brickSize ? 0 : 1, lx = x < brickSize ? x : 0;
+				const short* source = neighbors[nxBit | nyBit | nzBit];
+				const short v = source ? source[lx + (ly + lz * brickSize) * brickSize] : 0;
+				*out++ = v;
+				above = above || v >= isoValue;
+				below = below || v < isoValue;
+			}
+		}
+	}
+	if (!above || !below){
+		return false;
+	}
+
+	image->SetDimensions(nx, ny, nz);
+	image->SetOrigin(origin[0] + x0 * spacing[0], origin[1] + y0 * spacing[1], origin[2] + z0 * spacing[2]);
+	image->SetSpacing(spacing[0], spacing[1], spacing[2]);
+	image->AllocateScalars(VTK_SHORT, 1);
+	std::memcpy(image->GetScalarPointer(), values.data(), values.size() * sizeof(short));
+	image->Modified();
+	return true;
+}
+
+vtkSmartPointer<vtkPolyData> VtkSparseBrickVolume::contour(double isoValue){
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	contourStats = VtkSparseContourStats();
+
+	// Cells of a brick end in its upper neighbors, so a lower neighbor of an allocated brick can hold surface too
+	std::vector<unsigned char> candidates(brickSlots.size(), 0);
+	for (int brick = 0; brick < static_cast<int>(brickSlots.size()); brick++){
+		if (brickSlots[brick] < 0){
+			continue;
+		}
+		const int bx = brick % bricksPerSide;
+		const int by = (brick / bricksPerSide) % bricksPerSide;
+		const int bz = brick / (bricksPerSide * bricksPerSide);
+		for (int n = 0; n < 8; n++){
+			const int cx = bx - (n & 1), cy = by - ((n >> 1) & 1), cz = bz - ((n >> 2) & 1);
+			if (cx >= 0 && cy >= 0 && cz >= 0){
+				candidates[cx + (cy + cz * bricksPerSide) * bricksPerSide] = 1;
+			}
+		}
+	}
+
+	vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+	vtkSmartPointer<vtkFlyingEdges3D> flyingEdges = vtkSmartPointer<vtkFlyingEdges3D>::New();
+	flyingEdges->SetInputData(image);
+	flyingEdges->SetValue(0, isoValue);
+	flyingEdges->ComputeNormalsOn();
+	vtkSmartPointer<vtkAppendPolyData> append = vtkSmartPointer<vtkAppendPolyData>::New();
+	for (int brick = 0; brick < static_cast<int>(candidates.size()); brick++){
+		if (!candidates[brick]){
+			continue;
+		}
+		contourStats.candidateBricks++;
+		if (!extractBrick(brick, isoValue, image)){
+			continue;
+		}
+		contourStats.contouredBricks++;
+		flyingEdges->Update();
+		if (flyingEdges->GetOutput()->GetNumberOfPoints() > 0){
+			vtkSmartPointer<vtkPolyData> piece = vtkSmartPointer<vtkPolyData>::New();
+			piece->DeepCopy(flyingEdges->GetOutput());
+			append->AddInputData(piece);
+		}
+	}
+
+	vtkSmartPointer<vtkPolyData> surface = vtkSmartPointer<vtkPolyData>::New();
+	if (append->GetNumberOfInputConnections(0) > 0){
+		append->Update();
+		surface->ShallowCopy(append->GetOutput());
+	}
+	contourStats.time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return surface;
+}
+
+vtkSmartPointer<vtkImageData> VtkSparseBrickVolume::toImageData() const{
+	vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+	image->SetDimensions(resolution, resolution, resolution);
+	image->SetOrigin(origin[0], origin[1], origin[2]);
+	image->SetSpacing(spacing[0], spacing[1], spacing[2]);
+	image->AllocateScalars(VTK_SHORT, 1);
+	short* voxels = static_cast<short*>(image->GetScalarPointer());
+	std::fill(voxels, voxels + getDenseBytes() / sizeof(short), static_cast<short>(0));
+
+	const size_t slice = static_cast<size_t>(resolution) * resolution;
+	for (int brick = 0; brick < static_cast<int>(brickSlots.size()); brick++){
+		const int slot = brickSlots[brick];
+		if (slot < 0){
+			continue;
+		}
+		const int x0 = brick % bricksPerSide * brickSize;
+		const int y0 = (brick / bricksPerSide) % bricksPerSide * brickSize;
+		const int z0 = brick / (bricksPerSide * bricksPerSide) * brickSize;
+		const int nx = std::min(brickSize, resolution - x0);
+		const int ny = std::min(brickSize, resolution - y0);
+		const int nz = std::min(brickSize, resolution - z0);
+		for (int z = 0; z < nz; z++){
+			for (int y = 0; y < ny; y++){
+				const short* row = bricks[slot].get() + (y + z * brickSize) * brickSize;
+				std::copy(row, row + nx, voxels + x0 + (y0 + y) * resolution + (z0 + z) * slice);
+			}
+		}
+	}
+	return image;
+}
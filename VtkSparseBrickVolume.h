@@ -0,0 +1,116 @@
+#pragma once
+
+#include <climits>
+#include <memory>
+#include <vector>
+
+#include <vtkImageData.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+
+// Result of the last VtkSparseBrickVolume::contour()
+struct VtkSparseContourStats {
+	int candidateBricks; // allocated bricks and their lower neighbors, the only ones the surface can cross
+	int contouredBricks; // candidates the iso value actually crosses
+	double time; // ms
+};
+
+// Density volume of short counts stored as a two-level brick map: a table with one entry per brick of
+// brickSize^3 voxels, pointing to storage allocated on the first write into the brick. Unallocated bricks read
+// as zero. Memory follows the occupied region instead of resolution^3, e.g. a thin attractor at 1024^3 needs a
+// few percent of the 2 GB a dense short grid takes.
+// Not thread-safe; one thread writes and contours at a time.
+class VtkSparseBrickVolume {
+public:
+	// resolution^3 voxels spanning bounds (xmin, xmax, ymin, ymax, zmin, zmax)
+	VtkSparseBrickVolume(int resolution, const double bounds[6], int brickSize = 16);
+
+	VtkSparseBrickVolume(const VtkSparseBrickVolume&) = delete;
+	VtkSparseBrickVolume& operator=(const VtkSparseBrickVolume&) = delete;
+public:
+	// Voxel containing a world position; false outside the bounds
+	inline bool voxelOf(const double position[3], int voxel[3]) const {
+		for (int i = 0; i < 3; i++){
+			const double v = (position[i] - origin[i]) * inverseSpacing[i];
+			if (!(v >= 0.0 && v < resolution)){
+				return false;
+			}
+			voxel[i] = static_cast<int>(v);
+		}
+		return true;
+	}
+
+	// Adds 1, saturating; the voxelizer's inner loop, so defined here to be inlined
+	inline bool increment(int x, int y, int z) {
+		const int brick = x / brickSize + (y / brickSize + z / brickSize * bricksPerSide) * bricksPerSide;
+		int slot = brickSlots[brick];
+		if (slot < 0){
+			slot = allocateBrick(brick);
+		}
+		short& voxel = bricks[slot][x % brickSize + (y % brickSize + z % brickSize * brickSize) * brickSize];
+		if (voxel == SHRT_MAX){
+			return false;
+		}
+		voxel++;
+		return true;
+	}
+
+	short value(int x, int y, int z) const;
+	// Releases every brick
+	void clear();
+
+	// Copies a brick's voxels and the first voxel layer of its upper neighbors (the cells of a brick end there)
+	// into image, reallocating it as needed, with zeros for unallocated bricks. Returns false, leaving image
+	// as it was, when the iso value doesn't cross those voxels.
+	bool extractBrick(int brick, double isoValue, vtkImageData* image) const;
+	// Iso-surface of the whole volume; bricks the surface can't cross are skipped without being read
+	vtkSmartPointer<vtkPolyData> contour(double isoValue);
+	// Dense copy, e.g. for volume rendering
+	vtkSmartPointer<vtkImageData> toImageData() const;
+public:
+	inline int getResolution() const {
+		return resolution;
+	}
+
+	inline int getBrickSize() const {
+		return brickSize;
+	}
+
+	inline int getBricksPerSide() const {
+		return bricksPerSide;
+	}
+
+	inline int getBrickCount() const {
+		return static_cast<int>(brickSlots.size());
+	}
+
+	inline int getAllocatedBricks() const {
+		return static_cast<int>(bricks.size());
+	}
+
+	// Brick storage plus the brick table
+	inline size_t getMemoryBytes() const {
+		return bricks.size() * brickVoxels * sizeof(short) + brickSlots.size() * sizeof(int);
+	}
+
+	// What a dense short grid of the same resolution takes
+	inline size_t getDenseBytes() const {
+		return static_cast<size_t>(resolution) * resolution * resolution * sizeof(short);
+	}
+
+	inline const VtkSparseContourStats& getContourStats() const {
+		return contourStats;
+	}
+private:
+	int allocateBrick(int brick);
+private:
+	const int resolution;
+	const int brickSize;
+	const int bricksPerSide;
+	const size_t brickVoxels;
+	double origin[3], spacing[3], inverseSpacing[3];
+
+	std::vector<int> brickSlots; // per brick: index into bricks, -1 while unallocated
+	std::vector<std::unique_ptr<short[]>> bricks; // brickSize^3 voxels each, x fastest
+	VtkSparseContourStats contourStats;
+};
@@ -0,0 +1,242 @@
+#include "VtkStreamingPolylineMapper.h"
+
+#include <algorithm>
+
+// VTK's own OpenGL loader; the context is the one VTK renders with
+#include "vtk_glew.h"
+
+#include <vtkActor.h>
+#include <vtkInformation.h>
+#include <vtkMath.h>
+#include <vtkMatrix3x3.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkOpenGLActor.h>
+#include <vtkOpenGLCamera.h>
+#include <vtkOpenGLRenderWindow.h>
+#include <vtkOpenGLShaderCache.h>
+#include <vtkProperty.h>
+#include <vtkRenderer.h>
+#include <vtkShaderProgram.h>
+
+namespace {
+	const char* polylineVertexShader =
+		"//VTK::System::Dec\n"
+		"in vec3 vertexMC;\n"
+		"uniform mat4 MCDCMatrix;\n"
+		"uniform float lastIndex;\n"
+		"uniform float fade;\n"
+		"out float brightness;\n"
+		"void main() {\n"
+		"  brightness = lastIndex > 0.0 ? mix(fade, 1.0, float(gl_VertexID) / lastIndex) : 1.0;\n"
+		"  gl_Position = MCDCMatrix * vec4(vertexMC, 1.0);\n"
+		"}\n";
+
+	const char* polylineFragmentShader =
+		"//VTK::System::Dec\n"
+		"//VTK::Output::Dec\n"
+		"in float brightness;\n"
+		"uniform vec3 color;\n"
+		"uniform float opacity;\n"
+		"void main() {\n"
+		"  gl_FragData[0] = vec4(color * brightness, opacity);\n"
+		"}\n";
+
+	const size_t initialCapacity = 4096; // points
+	const double rateInterval = 0.5; // s
+}
+
+vtkStandardNewMacro(VtkStreamingPolylineMapper);
+
+VtkStreamingPolylineMapper::VtkStreamingPolylineMapper()
+	: MaximumPoints(0), Fade(0.25f), UploadedPoints(0), Capacity(0), VertexBuffer(0), VertexArray(0),
+	VertexArrayProgram(0), VertexArrayBuffer(0), Stats(), RateAppendedPoints(0), RateStart(std::chrono::steady_clock::now()){
+	vtkMath::UninitializeBounds(this->Bounds);
+	this->ScalarVisibilityOff();
+}
+
+VtkStreamingPolylineMapper::~VtkStreamingPolylineMapper() = default;
+
+int VtkStreamingPolylineMapper::FillInputPortInformation(int port, vtkInformation* info){
+	info->Set(vtkAlgorithm::INPUT_REQUIRED_DATA_TYPE(), "vtkPolyData");
+	info->Set(vtkAlgorithm::INPUT_IS_OPTIONAL(), 1); // points come from Append()
+	return 1;
+}
+
+double* VtkStreamingPolylineMapper::GetBounds(){
+	return this->Bounds;
+}
+
+void VtkStreamingPolylineMapper::Append(const float* points, size_t count){
+	if (count == 0){
+		return;
+	}
+	if (Points.empty()){
+		this->Bounds[0] = this->Bounds[2] = this->Bounds[4] = VTK_DOUBLE_MAX;
+		this->Bounds[1] = this->Bounds[3] = this->Bounds[5] = VTK_DOUBLE_MIN;
+	}
+	Points.insert(Points.end(), points, points + count * 3);
+	for (size_t i = 0; i < count; i++){
+		for (int c = 0; c < 3; c++){
+			this->Bounds[c * 2] = std::min(this->Bounds[c * 2], static_cast<double>(points[i * 3 + c]));
+			this->Bounds[c * 2 + 1] = std::max(this->Bounds[c * 2 + 1], static_cast<double>(points[i * 3 + c]));
+		}
+	}
+	Stats.appendedPoints += count;
+
+	if (MaximumPoints > 0 && Points.size() / 3 > MaximumPoints){
+		Decimate();
+	}
+	Stats.points = Points.size() / 3;
+	this->Modified();
+}
+
+void VtkStreamingPolylineMapper::Clear(){
+	Points.clear();
+	UploadedPoints = 0;
+	vtkMath::UninitializeBounds(this->Bounds);
+	Stats.points = 0;
+	Stats.appendedPoints = 0;
+	Stats.pointsPerSecond = 0.0;
+	RateAppendedPoints = 0;
+	RateStart = std::chrono::steady_clock::now();
+	this->Modified();
+}
+
+void VtkStreamingPolylineMapper::Decimate(){
+	// Every other point of the older half; the bounds stay those of everything appended
+	while (Points.size() / 3 > MaximumPoints && Points.size() / 3 >= 4){
+		const size_t count = Points.size() / 3;
+		const size_t older = count / 2;
+		size_t kept = 0;
+		for (size_t i = 0; i < older; i += 2, kept++){
+			std::copy(Points.begin() + i * 3, Points.begin() + i * 3 + 3, Points.begin() + kept * 3);
+		}
+		Points.erase(Points.begin() + kept * 3, Points.begin() + older * 3);
+	}
+	UploadedPoints = 0;
+	Stats.decimations++;
+}
+
+void VtkStreamingPolylineMapper::Upload(){
+	const size_t count = Points.size() / 3;
+	Stats.uploadedBytes = 0;
+	if (count > Capacity){
+		size_t capacity = std::max(Capacity * 2, initialCapacity);
+		while (capacity < count){
+			capacity *= 2;
+		}
+		GLuint buffer;
+		glGenBuffers(1, &buffer);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+		glBufferData(GL_COPY_WRITE_BUFFER, capacity * 3 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+		if (VertexBuffer && UploadedPoints > 0){
+			// What is already on the GPU stays there
+			glBindBuffer(GL_COPY_READ_BUFFER, VertexBuffer);
+			glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, UploadedPoints * 3 * sizeof(float));
+			glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		}
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		if (VertexBuffer){
+			glDeleteBuffers(1, &VertexBuffer);
+			Stats.reallocations++;
+		}
+		VertexBuffer = buffer;
+		Capacity = capacity;
+		Stats.capacity = capacity;
+	}
+	if (UploadedPoints < count){
+		const size_t bytes = (count - UploadedPoints) * 3 * sizeof(float);
+		glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
+		glBufferSubData(GL_ARRAY_BUFFER, UploadedPoints * 3 * sizeof(float), bytes, Points.data() + UploadedPoints * 3);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		Stats.uploadedBytes = bytes;
+		UploadedPoints = count;
+	}
+}
+
+void VtkStreamingPolylineMapper::Render(vtkRenderer* ren, vtkActor* actor){
+	const auto now = std::chrono::steady_clock::now();
+	const double elapsed = std::chrono::duration<double>(now - RateStart).count();
+	if (elapsed >= rateInterval){
+		Stats.pointsPerSecond = (Stats.appendedPoints - RateAppendedPoints) / elapsed;
+		RateAppendedPoints = Stats.appendedPoints;
+		RateStart = now;
+	}
+
+	const size_t count = Points.size() / 3;
+	if (count < 2){
+		return;
+	}
+	Upload();
+
+	vtkOpenGLRenderWindow* renWin = vtkOpenGLRenderWindow::SafeDownCast(ren->GetRenderWindow());
+	vtkShaderProgram* program = renWin->GetShaderCache()->ReadyShaderProgram(polylineVertexShader, polylineFragmentShader, "");
+	if (!program){
+		vtkErrorMacro("Could not build the streaming polyline shader program");
+		return;
+	}
+
+	if (!VertexArray || VertexArrayProgram != program->GetHandle() || VertexArrayBuffer != VertexBuffer){
+		if (!VertexArray){
+			glGenVertexArrays(1, &VertexArray);
+		}
+		glBindVertexArray(VertexArray);
+		GLint vertexLocation = glGetAttribLocation(program->GetHandle(), "vertexMC");
+		glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
+		glEnableVertexAttribArray(vertexLocation);
+		glVertexAttribPointer(vertexLocation, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindVertexArray(0);
+		VertexArrayProgram = program->GetHandle();
+		VertexArrayBuffer = VertexBuffer;
+	}
+
+	// Same matrix conventions as vtkOpenGLPolyDataMapper (matrices are already transposed for GL)
+	vtkOpenGLCamera* camera = static_cast<vtkOpenGLCamera*>(ren->GetActiveCamera());
+	vtkMatrix4x4* wcvc;
+	vtkMatrix3x3* cameraNormals;
+	vtkMatrix4x4* vcdc;
+	vtkMatrix4x4* wcdc;
+	camera->GetKeyMatrices(ren, wcvc, cameraNormals, vcdc, wcdc);
+	if (actor->GetIsIdentity()){
+		program->SetUniformMatrix("MCDCMatrix", wcdc);
+	}
+	else{
+		vtkMatrix4x4* mcwc;
+		vtkMatrix3x3* actorNormals;
+		static_cast<vtkOpenGLActor*>(actor)->GetKeyMatrices(mcwc, actorNormals);
+		vtkSmartPointer<vtkMatrix4x4> mcdc = vtkSmartPointer<vtkMatrix4x4>::New();
+		vtkMatrix4x4::Multiply4x4(mcwc, wcdc, mcdc);
+		program->SetUniformMatrix("MCDCMatrix", mcdc);
+	}
+
+	vtkProperty* property = actor->GetProperty();
+	double* color = property->GetColor();
+	float lineColor[3] = {static_cast<float>(color[0]), static_cast<float>(color[1]), static_cast<float>(color[2])};
+	program->SetUniform3f("color", lineColor);
+	program->SetUniformf("opacity", static_cast<float>(property->GetOpacity()));
+	program->SetUniformf("lastIndex", static_cast<float>(count - 1));
+	program->SetUniformf("fade", Fade);
+
+	glBindVertexArray(VertexArray);
+	glDrawArrays(GL_LINE_STRIP, 0, static_cast<GLsizei>(count));
+	glBindVertexArray(0);
+}
+
+void VtkStreamingPolylineMapper::ReleaseGraphicsResources(vtkWindow* window){
+	if (VertexArray){
+		glDeleteVertexArrays(1, &VertexArray);
+		VertexArray = 0;
+		VertexArrayProgram = 0;
+		VertexArrayBuffer = 0;
+	}
+	if (VertexBuffer){
+		glDeleteBuffers(1, &VertexBuffer);
+		VertexBuffer = 0;
+	}
+	// Everything is uploaded again from the CPU copy on the next render
+	Capacity = 0;
+	UploadedPoints = 0;
+	Stats.capacity = 0;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+#include <vtkMapper.h>
+
+// Throughput of a VtkStreamingPolylineMapper
+struct VtkStreamingPolylineStats {
+	size_t points; // currently drawn, after decimation
+	unsigned long long appendedPoints; // since the last Clear()
+	double pointsPerSecond; // appended, averaged over about half a second
+	size_t uploadedBytes; // by the last render
+	size_t capacity; // points the GPU buffer holds before it grows
+	int reallocations; // buffer growths
+	int decimations; // full re-uploads after old segments were thinned
+};
+
+// Append-only polyline (e.g. a live trajectory) drawn as one line strip from a growable GPU buffer.
+// Append() only extends a CPU copy; each render uploads just the points added since the previous one with
+// glBufferSubData. When the buffer is full it doubles, and the old contents are copied on the GPU
+// (glCopyBufferSubData) rather than uploaded again.
+// With SetMaximumPoints(), the oldest half of the line is thinned to every other point whenever the limit is
+// reached, so long runs stay bounded while the recent part keeps full resolution; this re-uploads everything,
+// about once per quarter of the limit appended.
+// Lines are unlit, in the actor's color, fading towards the start of the line. There is no input connection.
+class VtkStreamingPolylineMapper : public vtkMapper {
+public:
+	static VtkStreamingPolylineMapper* New();
+	vtkTypeMacro(VtkStreamingPolylineMapper, vtkMapper);
+public:
+	// count x, y, z triplets; call on the thread that renders the scene (or via VtkViewer::post)
+	void Append(const float* points, size_t count);
+	void Clear();
+
+	void Render(vtkRenderer* ren, vtkActor* actor) override;
+	void ReleaseGraphicsResources(vtkWindow* window) override;
+	using vtkMapper::GetBounds;
+	double* GetBounds() override;
+
+	// 0 = keep every point (default)
+	vtkSetMacro(MaximumPoints, size_t);
+	vtkGetMacro(MaximumPoints, size_t);
+	// Brightness of the oldest point relative to the newest, in [0, 1] (default 0.25)
+	vtkSetClampMacro(Fade, float, 0.0f, 1.0f);
+	vtkGetMacro(Fade, float);
+
+	inline const VtkStreamingPolylineStats& GetStats() const {
+		return Stats;
+	}
+protected:
+	VtkStreamingPolylineMapper();
+	~VtkStreamingPolylineMapper() override;
+
+	int FillInputPortInformation(int port, vtkInformation* info) override;
+	void Decimate();
+	void Upload();
+protected:
+	size_t MaximumPoints;
+	float Fade;
+
+	std::vector<float> Points; // xyz, everything drawn
+	size_t UploadedPoints; // prefix of Points already in VertexBuffer
+	size_t Capacity; // of VertexBuffer, in points
+
+	unsigned int VertexBuffer;
+	unsigned int VertexArray;
+	unsigned int VertexArrayProgram; // program handle the vertex array was set up for
+	unsigned int VertexArrayBuffer; // buffer the vertex array was set up for
+
+	VtkStreamingPolylineStats Stats;
+	unsigned long long RateAppendedPoints; // Stats.appendedPoints at RateStart
+	std::chrono::steady_clock::time_point RateStart;
+private:
+	VtkStreamingPolylineMapper(const VtkStreamingPolylineMapper&) = delete;
+	void operator=(const VtkStreamingPolylineMapper&) = delete;
+};
@@ -0,0 +1,129 @@
+#include "VtkTemporalAccumulator.h"
+
+// OpenGL Loader
+// This can be replaced with another loader, e.g. glad, but
+// remember to change the corresponding initialize call below!
+#include <GL/gl3w.h>            // GL3w, initialized with gl3wInit()
+
+#include <string>
+
+#include <vtkOpenGLFramebufferObject.h>
+#include <vtkOpenGLQuadHelper.h>
+#include <vtkOpenGLRenderUtilities.h>
+#include <vtkOpenGLRenderWindow.h>
+#include <vtkOpenGLShaderCache.h>
+#include <vtkOpenGLState.h>
+#include <vtkShaderProgram.h>
+#include <vtkTextureObject.h>
+#include <vtkTextureUnitManager.h>
+
+namespace {
+	double radicalInverse(int index, int base){
+		double result = 0.0;
+		double fraction = 1.0 / base;
+		for (; index > 0; index /= base){
+			result += (index % base) * fraction;
+			fraction /= base;
+		}
+		return result;
+	}
+}
+
+VtkTemporalAccumulator::VtkTemporalAccumulator() : quad(nullptr){
+}
+
+VtkTemporalAccumulator::~VtkTemporalAccumulator(){
+	delete quad;
+}
+
+void VtkTemporalAccumulator::JitterOffset(int frame, double offset[2]){
+	if (frame <= 0){
+		offset[0] = offset[1] = 0.0;
+		return;
+	}
+	offset[0] = radicalInverse(frame, 2) - 0.5;
+	offset[1] = radicalInverse(frame, 3) - 0.5;
+}
+
+void VtkTemporalAccumulator::accumulate(vtkOpenGLRenderWindow* renderWindow, unsigned int frameTexture, unsigned int width, unsigned int height, int frame){
+	if (!accumulation){
+		accumulation = vtkSmartPointer<vtkTextureObject>::New();
+		accumulation->SetContext(renderWindow);
+		accumulation->SetInternalFormat(GL_RGBA16F); // 8-bit sums would band after a few frames
+		accumulation->SetMinificationFilter(vtkTextureObject::Nearest);
+		accumulation->SetMagnificationFilter(vtkTextureObject::Nearest);
+		framebuffer = vtkSmartPointer<vtkOpenGLFramebufferObject>::New();
+		framebuffer->SetContext(renderWindow);
+	}
+	if (accumulation->GetWidth() != width || accumulation->GetHeight() != height || !accumulation->GetHandle()){
+		accumulation->Allocate2D(width, height, 4, VTK_FLOAT);
+		framebuffer->Bind();
+		framebuffer->AddColorAttachment(0, accumulation);
+		framebuffer->UnBind();
+	}
+
+	if (!quad){
+		std::string fragmentShader = vtkOpenGLRenderUtilities::GetFullScreenQuadFragmentShaderTemplate();
+		vtkShaderProgram::Substitute(fragmentShader, "//VTK::FSQ::Decl", "uniform sampler2D frame;");
+		vtkShaderProgram::Substitute(fragmentShader, "//VTK::FSQ::Impl", "gl_FragData[0] = texture(frame, texCoord);");
+		quad = new vtkOpenGLQuadHelper(renderWindow, vtkOpenGLRenderUtilities::GetFullScreenQuadVertexShader().c_str(),
+			fragmentShader.c_str(), "");
+	}
+	else{
+		renderWindow->GetShaderCache()->ReadyShaderProgram(quad->Program);
+	}
+	if (!quad->Program || !quad->Program->GetCompiled()){
+		return;
+	}
+
+	vtkOpenGLState* state = renderWindow->GetState();
+	state->PushFramebufferBindings();
+	framebuffer->Bind(GL_DRAW_FRAMEBUFFER);
+	framebuffer->ActivateDrawBuffer(0);
+	{
+		vtkOpenGLState::ScopedglViewport viewportSaver(state);
+		vtkOpenGLState::ScopedglEnableDisable depthSaver(state, GL_DEPTH_TEST);
+		vtkOpenGLState::ScopedglEnableDisable blendSaver(state, GL_BLEND);
+		vtkOpenGLState::ScopedglBlendFuncSeparate blendFuncSaver(state);
+		state->vtkglViewport(0, 0, width, height);
+		state->vtkglDisable(GL_DEPTH_TEST);
+		state->vtkglEnable(GL_BLEND);
+		// average += (frame - average) / n, alpha (background opacity) included
+		state->vtkglBlendFuncSeparate(GL_CONSTANT_ALPHA, GL_ONE_MINUS_CONSTANT_ALPHA, GL_CONSTANT_ALPHA, GL_ONE_MINUS_CONSTANT_ALPHA);
+		glBlendColor(0.0f, 0.0f, 0.0f, 1.0f / (frame + 1)); // not tracked by vtkOpenGLState
+
+		vtkTextureUnitManager* units = renderWindow->GetTextureUnitManager();
+		const int unit = units->Allocate();
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(GL_TEXTURE_2D, frameTexture);
+		quad->Program->SetUniformi("frame", unit);
+		quad->Render();
+		glBindTexture(GL_TEXTURE_2D, 0);
+		glActiveTexture(GL_TEXTURE0);
+		units->Free(unit);
+	}
+
+	// The average replaces the jittered frame in the texture ImGui shows
+	framebuffer->Bind(GL_READ_FRAMEBUFFER);
+	framebuffer->ActivateReadBuffer(0);
+	renderWindow->GetDisplayFramebuffer()->Bind(GL_DRAW_FRAMEBUFFER);
+	renderWindow->GetDisplayFramebuffer()->ActivateDrawBuffer(0);
+	state->vtkglBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	state->PopFramebufferBindings();
+}
+
+void VtkTemporalAccumulator::releaseGraphicsResources(vtkWindow* window){
+	if (quad){
+		quad->ReleaseGraphicsResources(window);
+		delete quad;
+		quad = nullptr;
+	}
+	if (framebuffer){
+		framebuffer->ReleaseGraphicsResources(window);
+	}
+	if (accumulation){
+		accumulation->ReleaseGraphicsResources(window);
+	}
+	framebuffer = nullptr;
+	accumulation = nullptr;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vtkSmartPointer.h>
+
+class vtkOpenGLRenderWindow;
+class vtkOpenGLFramebufferObject;
+class vtkOpenGLQuadHelper;
+class vtkTextureObject;
+class vtkWindow;
+
+// Running average of the frames a VtkViewer renders while its scene is still (see VtkViewer::setAccumulation).
+// Every frame is rendered with a different sub-pixel camera offset, blended into a half-float accumulation
+// texture, and the average is written back into the render window's display framebuffer, i.e. the texture
+// ImGui shows. All calls need the context the viewer renders on.
+class VtkTemporalAccumulator {
+public:
+	VtkTemporalAccumulator();
+	~VtkTemporalAccumulator();
+
+	VtkTemporalAccumulator(const VtkTemporalAccumulator&) = delete;
+	VtkTemporalAccumulator& operator=(const VtkTemporalAccumulator&) = delete;
+public:
+	// Sub-pixel offset in pixels, within [-0.5, 0.5) (Halton 2, 3 sequence); frame 0 isn't jittered
+	static void JitterOffset(int frame, double offset[2]);
+public:
+	// Adds the frame just rendered into frameTexture (attached to the display framebuffer) with weight
+	// 1 / (frame + 1); frame 0 replaces the average
+	void accumulate(vtkOpenGLRenderWindow* renderWindow, unsigned int frameTexture, unsigned int width, unsigned int height, int frame);
+	void releaseGraphicsResources(vtkWindow* window);
+private:
+	vtkSmartPointer<vtkTextureObject> accumulation;
+	vtkSmartPointer<vtkOpenGLFramebufferObject> framebuffer;
+	vtkOpenGLQuadHelper* quad;
+};
@@ -0,0 +1,306 @@
+#include "VtkTilePyramid.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <vtkImageData.h>
+#include <vtkJPEGReader.h>
+#include <vtkJPEGWriter.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
+#include <vtkUnsignedCharArray.h>
+
+#include "VtkViewer.h"
+#include "VtkWorkerPool.h"
+
+namespace {
+	const char pyramidMagic[8] = {'V', 'T', 'K', 'T', 'I', 'L', 'E', '1'};
+	const int jpegQuality = 90;
+
+	// Levels down to the first one that fits in a single tile
+	int pyramidLevels(int width, int height, int tileSize){
+		int levels = 1;
+		while (VtkTilePyramid::levelSize(width, levels - 1) > tileSize || VtkTilePyramid::levelSize(height, levels - 1) > tileSize){
+			levels++;
+		}
+		return levels;
+	}
+
+	void encodeTile(const unsigned char* pixels, int width, int height, int components, VtkTileCodec codec, std::vector<unsigned char>& bytes){
+		const size_t size = static_cast<size_t>(width) * height * components;
+		if (codec == VtkTileCodec::Raw){
+			bytes.assign(pixels, pixels + size);
+			return;
+		}
+		vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+		image->SetDimensions(width, height, 1);
+		image->AllocateScalars(VTK_UNSIGNED_CHAR, components);
+		std::memcpy(image->GetScalarPointer(), pixels, size);
+		vtkSmartPointer<vtkJPEGWriter> writer = vtkSmartPointer<vtkJPEGWriter>::New();
+		writer->SetInputData(image);
+		writer->SetQuality(jpegQuality);
+		writer->WriteToMemoryOn();
+		writer->Write();
+		vtkUnsignedCharArray* result = writer->GetResult();
+		bytes.assign(result->GetPointer(0), result->GetPointer(0) + result->GetNumberOfTuples());
+	}
+
+	bool decodeTile(std::vector<unsigned char>& bytes, int width, int height, int components, VtkTileCodec codec, std::vector<unsigned char>& pixels){
+		const size_t size = static_cast<size_t>(width) * height * components;
+		if (codec == VtkTileCodec::Raw){
+			if (bytes.size() != size){
+				return false;
+			}
+			pixels.swap(bytes);
+			return true;
+		}
+		vtkSmartPointer<vtkJPEGReader> reader = vtkSmartPointer<vtkJPEGReader>::New();
+		reader->SetMemoryBuffer(bytes.data());
+		reader->SetMemoryBufferLength(static_cast<vtkIdType>(bytes.size()));
+		reader->Update();
+		vtkImageData* image = reader->GetOutput();
+		vtkDataArray* scalars = image->GetPointData()->GetScalars();
+		int dimensions[3];
+		image->GetDimensions(dimensions);
+		if (!scalars || scalars->GetDataType() != VTK_UNSIGNED_CHAR || scalars->GetNumberOfComponents() != components ||
+			dimensions[0] != width || dimensions[1] != height){
+			return false;
+		}
+		const unsigned char* decoded = static_cast<const unsigned char*>(scalars->GetVoidPointer(0));
+		pixels.assign(decoded, decoded + size);
+		return true;
+	}
+
+	// Cuts strips of every level into tiles and writes them, averaging each strip 2x2 into the next level's
+	// strip, which is written in turn once it has tileSize rows (or its level's last rows)
+	class PyramidWriter {
+	public:
+		PyramidWriter(std::ofstream& file, int width, int height, int tileSize, int components, VtkTileCodec codec, unsigned int workerThreads)
+			: file(file), tileSize(tileSize), components(components), codec(codec), workers(workerThreads){
+			const int levelCount = pyramidLevels(width, height, tileSize);
+			size_t tileCount = 0;
+			for (int level = 0; level < levelCount; level++){
+				Level entry;
+				entry.width = VtkTilePyramid::levelSize(width, level);
+				entry.height = VtkTilePyramid::levelSize(height, level);
+				entry.firstTile = tileCount;
+				entry.stripRow = 0;
+				entry.rows = 0;
+				if (level > 0){
+					entry.strip.resize(static_cast<size_t>(entry.width) * tileSize * components);
+				}
+				tileCount += static_cast<size_t>((entry.width + tileSize - 1) / tileSize) * ((entry.height + tileSize - 1) / tileSize);
+				levels.push_back(std::move(entry));
+			}
+			tiles.assign(tileCount * 2, 0);
+		}
+
+		// rows rows of the level starting at firstRow, a multiple of tileSize
+		void writeStrip(int level, const unsigned char* strip, int firstRow, int rows){
+			const Level& current = levels[level];
+			const size_t stride = static_cast<size_t>(current.width) * components;
+			const int tilesX = (current.width + tileSize - 1) / tileSize;
+			std::vector<std::vector<unsigned char>> encoded(tilesX);
+			workers.parallelFor(0, tilesX, 1, [&](size_t first, size_t last){
+				std::vector<unsigned char> tile;
+				for (size_t x = first; x < last; x++){
+					const int tileWidth = std::min(tileSize, current.width - static_cast<int>(x) * tileSize);
+					const size_t tileStride = static_cast<size_t>(tileWidth) * components;
+					tile.resize(tileStride * rows);
+					for (int row = 0; row < rows; row++){
+						std::memcpy(tile.data() + row * tileStride, strip + row * stride + x * tileSize * components, tileStride);
+					}
+					encodeTile(tile.data(), tileWidth, rows, components, codec, encoded[x]);
+				}
+			});
+
+			const size_t firstTile = current.firstTile + static_cast<size_t>(firstRow / tileSize) * tilesX;
+			for (int x = 0; x < tilesX; x++){
+				tiles[(firstTile + x) * 2] = static_cast<uint64_t>(file.tellp());
+				tiles[(firstTile + x) * 2 + 1] = encoded[x].size();
+				file.write(reinterpret_cast<const char*>(encoded[x].data()), encoded[x].size());
+			}
+			if (level + 1 < static_cast<int>(levels.size())){
+				downsample(level, strip, firstRow, rows);
+			}
+		}
+
+		inline const std::vector<uint64_t>& getTiles() const {
+			return tiles;
+		}
+
+		inline int getLevelCount() const {
+			return static_cast<int>(levels.size());
+		}
+	private:
+		struct Level {
+			int width, height;
+			size_t firstTile;
+			std::vector<unsigned char> strip; // tileSize rows being filled from the level below
+			int stripRow; // level row of the strip's first row
+			int rows; // filled so far
+		};
+	private:
+		void downsample(int level, const unsigned char* strip, int firstRow, int rows){
+			const Level& current = levels[level];
+			Level& next = levels[level + 1];
+			const size_t stride = static_cast<size_t>(current.width) * components;
+			const size_t nextStride = static_cast<size_t>(next.width) * components;
+			const int nextRows = (rows + 1) / 2; // an odd count only ends the level
+			for (int row = 0; row < nextRows; row++){
+				const unsigned char* row0 = strip + 2 * row * stride;
+				const unsigned char* row1 = strip + std::min(2 * row + 1, rows - 1) * stride;
+				unsigned char* output = next.strip.data() + (firstRow / 2 + row - next.stripRow) * nextStride;
+				for (int x = 0; x < next.width; x++){
+					const size_t x0 = 2 * x * components;
+					const size_t x1 = std::min(2 * x + 1, current.width - 1) * components;
+					for (int c = 0; c < components; c++){
+						output[x * components + c] = static_cast<unsigned char>((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) / 4);
+					}
+				}
+			}
+			next.rows += nextRows;
+			if (next.rows == tileSize || next.stripRow + next.rows == next.height){
+				const int stripRow = next.stripRow, stripRows = next.rows;
+				next.stripRow += next.rows;
+				next.rows = 0;
+				writeStrip(level + 1, next.strip.data(), stripRow, stripRows);
+			}
+		}
+	private:
+		std::ofstream& file;
+		int tileSize, components;
+		VtkTileCodec codec;
+		std::vector<Level> levels;
+		std::vector<uint64_t> tiles; // offset, size per tile
+		VtkWorkerPool workers;
+	};
+}
+
+VtkTilePyramid::VtkTilePyramid(const std::string& path)
+	: width(0), height(0), tileSize(0), components(0), levels(0), codec(VtkTileCodec::Raw){
+	file.open(path, std::ios::binary);
+	if (!file){
+		throw VtkViewerError("Could not open tile pyramid " + path);
+	}
+	char magic[sizeof(pyramidMagic)];
+	int32_t header[6];
+	file.read(magic, sizeof(magic));
+	file.read(reinterpret_cast<char*>(header), sizeof(header));
+	if (!file || std::memcmp(magic, pyramidMagic, sizeof(magic)) != 0){
+		throw VtkViewerError(path + " is not a tile pyramid");
+	}
+	width = header[0];
+	height = header[1];
+	tileSize = header[2];
+	components = header[3];
+	levels = header[4];
+	codec = static_cast<VtkTileCodec>(header[5]);
+	if (width < 1 || height < 1 || tileSize < 16 || (tileSize & (tileSize - 1)) != 0 || components < 1 || components > 4 ||
+		header[5] < 0 || header[5] > static_cast<int>(VtkTileCodec::Jpeg) || levels != pyramidLevels(width, height, tileSize)){
+		throw VtkViewerError("Invalid header in tile pyramid " + path);
+	}
+
+	const std::streamoff tableOffset = file.tellg();
+	file.seekg(0, std::ios::end);
+	const uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+	file.seekg(tableOffset);
+
+	uint64_t tileCount = 0;
+	for (int level = 0; level < levels; level++){
+		firstTile.push_back(static_cast<size_t>(tileCount));
+		tileCount += static_cast<uint64_t>(getTilesX(level)) * getTilesY(level);
+	}
+	if (tileCount * 2 * sizeof(uint64_t) > fileSize - static_cast<uint64_t>(tableOffset)){
+		throw VtkViewerError("Truncated tile table in tile pyramid " + path);
+	}
+	tiles.resize(static_cast<size_t>(tileCount * 2));
+	file.read(reinterpret_cast<char*>(tiles.data()), tiles.size() * sizeof(uint64_t));
+	if (!file){
+		throw VtkViewerError("Truncated tile table in tile pyramid " + path);
+	}
+
+	// readTile() allocates what the table says, so every entry must lie within the file and be no larger than a tile
+	// could encode to (a JPEG tile may exceed the raw size by its headers)
+	const uint64_t rawSize = static_cast<uint64_t>(tileSize) * tileSize * components;
+	const uint64_t maximumSize = codec == VtkTileCodec::Raw ? rawSize : 2 * rawSize + 65536;
+	for (size_t i = 0; i < tiles.size(); i += 2){
+		const uint64_t offset = tiles[i], size = tiles[i + 1];
+		if (size > maximumSize || offset > fileSize || size > fileSize - offset){
+			throw VtkViewerError("Corrupt tile table in tile pyramid " + path);
+		}
+	}
+}
+
+size_t VtkTilePyramid::tileIndex(int level, int x, int y) const {
+	return firstTile[level] + static_cast<size_t>(y) * getTilesX(level) + x;
+}
+
+bool VtkTilePyramid::readTile(int level, int x, int y, std::vector<unsigned char>& pixels, int& width, int& height) const {
+	if (level < 0 || level >= levels || x < 0 || y < 0 || x >= getTilesX(level) || y >= getTilesY(level)){
+		return false;
+	}
+	width = std::min(tileSize, getLevelWidth(level) - x * tileSize);
+	height = std::min(tileSize, getLevelHeight(level) - y * tileSize);
+	const size_t index = tileIndex(level, x, y);
+	std::vector<unsigned char> bytes(static_cast<size_t>(tiles[index * 2 + 1]));
+	{
+		std::lock_guard<std::mutex> lock(fileMutex);
+		file.clear();
+		file.seekg(static_cast<std::streamoff>(tiles[index * 2]));
+		file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+		if (!file){
+			return false;
+		}
+	}
+	return decodeTile(bytes, width, height, components, codec, pixels);
+}
+
+void VtkTilePyramid::build(const std::string& path, int width, int height, int components, const RowSource& source,
+	int tileSize, VtkTileCodec codec, unsigned int workerThreads){
+	if (width < 1 || height < 1 || tileSize < 16 || (tileSize & (tileSize - 1)) != 0 || components < 1 || components > 4){
+		throw VtkViewerError("Invalid tile pyramid size, tile size or components");
+	}
+	if (codec == VtkTileCodec::Jpeg && components != 1 && components != 3){
+		throw VtkViewerError("JPEG tile pyramids need 1 or 3 components");
+	}
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file){
+		throw VtkViewerError("Could not create tile pyramid " + path);
+	}
+
+	PyramidWriter writer(file, width, height, tileSize, components, codec, workerThreads);
+	const int32_t header[6] = {width, height, tileSize, components, writer.getLevelCount(), static_cast<int32_t>(codec)};
+	file.write(pyramidMagic, sizeof(pyramidMagic));
+	file.write(reinterpret_cast<const char*>(header), sizeof(header));
+	const std::streamoff tableOffset = file.tellp();
+	file.write(reinterpret_cast<const char*>(writer.getTiles().data()), writer.getTiles().size() * sizeof(uint64_t)); // filled in at the end
+
+	std::vector<unsigned char> strip(static_cast<size_t>(width) * tileSize * components);
+	for (int row = 0; row < height; row += tileSize){
+		const int rows = std::min(tileSize, height - row);
+		source(row, rows, strip.data());
+		writer.writeStrip(0, strip.data(), row, rows);
+	}
+
+	file.seekp(tableOffset);
+	file.write(reinterpret_cast<const char*>(writer.getTiles().data()), writer.getTiles().size() * sizeof(uint64_t));
+	if (!file){
+		throw VtkViewerError("Could not write tile pyramid " + path);
+	}
+}
+
+void VtkTilePyramid::build(const std::string& path, vtkImageData* image, int tileSize, VtkTileCodec codec, unsigned int workerThreads){
+	vtkDataArray* scalars = image ? image->GetPointData()->GetScalars() : nullptr;
+	if (!scalars || scalars->GetDataType() != VTK_UNSIGNED_CHAR){
+		throw VtkViewerError("Tile pyramids need an image with unsigned char scalars");
+	}
+	int dimensions[3];
+	image->GetDimensions(dimensions);
+	const int components = scalars->GetNumberOfComponents();
+	const unsigned char* pixels = static_cast<const unsigned char*>(scalars->GetVoidPointer(0)); // the first slice comes first
+	const size_t stride = static_cast<size_t>(dimensions[0]) * components;
+	build(path, dimensions[0], dimensions[1], components, [pixels, stride](int firstRow, int rows, unsigned char* strip){
+		std::memcpy(strip, pixels + firstRow * stride, rows * stride);
+	}, tileSize, codec, workerThreads);
+}
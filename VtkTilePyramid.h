@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class vtkImageData;
+
+// How tiles are stored in a pyramid file
+enum class VtkTileCodec {
+	Raw, // pixels as they are
+	Jpeg // decoded with vtkJPEGReader; 1 or 3 components only
+};
+
+// Tiled image pyramid file for images far bigger than a texture (or memory): level 0 is the full image, every
+// next level halves both dimensions (rounding up) down to a single tile. Each level is cut into tileSize x tileSize
+// tiles (smaller at the right and top edges), stored independently so any tile can be read and decoded alone.
+// Rows go bottom to top as in vtkImageData; a level-0 pixel is one world unit.
+//
+// Layout: "VTKTILE1", then int32 width, height, tileSize, components, levels and codec, then an (offset, size)
+// uint64 pair per tile (level by level, rows bottom to top, x fastest), then the tile data in any order.
+// Integers are in the writing machine's byte order.
+//
+// Reading is thread-safe: file reads are serialized, decoding runs on the calling thread.
+class VtkTilePyramid {
+public:
+	// Fills rows [firstRow, firstRow + rows) of the full image, width * components bytes each, bottom row first
+	typedef std::function<void(int firstRow, int rows, unsigned char* pixels)> RowSource;
+
+	// Opens a pyramid file, throws VtkViewerError if it can't be read
+	explicit VtkTilePyramid(const std::string& path);
+
+	VtkTilePyramid(const VtkTilePyramid&) = delete;
+	VtkTilePyramid& operator=(const VtkTilePyramid&) = delete;
+public:
+	// Writes the pyramid of a width x height image read one strip of tileSize rows at a time, so memory stays at a
+	// few strips per level whatever the image size. Tiles of a strip are encoded on workerThreads threads
+	// (0 = std::thread::hardware_concurrency()). tileSize must be a power of two >= 16. Throws VtkViewerError.
+	static void build(const std::string& path, int width, int height, int components, const RowSource& source,
+		int tileSize = 256, VtkTileCodec codec = VtkTileCodec::Jpeg, unsigned int workerThreads = 0);
+	// Same for an image already in memory (8-bit scalars of the first z slice), e.g. from vtkJPEGReader
+	static void build(const std::string& path, vtkImageData* image, int tileSize = 256, VtkTileCodec codec = VtkTileCodec::Jpeg,
+		unsigned int workerThreads = 0);
+
+	// Reads and decodes one tile into pixels (width * height * components bytes, bottom row first);
+	// false if the tile doesn't exist or can't be decoded
+	bool readTile(int level, int x, int y, std::vector<unsigned char>& pixels, int& width, int& height) const;
+public:
+	inline int getWidth() const {
+		return width;
+	}
+
+	inline int getHeight() const {
+		return height;
+	}
+
+	inline int getTileSize() const {
+		return tileSize;
+	}
+
+	inline int getComponents() const {
+		return components;
+	}
+
+	inline int getLevelCount() const {
+		return levels;
+	}
+
+	inline VtkTileCodec getCodec() const {
+		return codec;
+	}
+
+	inline int getLevelWidth(int level) const {
+		return levelSize(width, level);
+	}
+
+	inline int getLevelHeight(int level) const {
+		return levelSize(height, level);
+	}
+
+	inline int getTilesX(int level) const {
+		return (getLevelWidth(level) + tileSize - 1) / tileSize;
+	}
+
+	inline int getTilesY(int level) const {
+		return (getLevelHeight(level) + tileSize - 1) / tileSize;
+	}
+
+	// Pixels (rounded up) along an axis of size at the given level
+	static inline int levelSize(int size, int level) {
+		return static_cast<int>((static_cast<long long>(size) + (1LL << level) - 1) >> level);
+	}
+private:
+	size_t tileIndex(int level, int x, int y) const;
+private:
+	int width, height, tileSize, components, levels;
+	VtkTileCodec codec;
+	std::vector<uint64_t> tiles; // offset, size per tile
+	std::vector<size_t> firstTile; // index of each level's first tile
+
+	mutable std::ifstream file;
+	mutable std::mutex fileMutex;
+};
@@ -0,0 +1,535 @@
+#include "VtkTiledImageMapper.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+// VTK's own OpenGL loader; the context is the one VTK renders with
+#include "vtk_glew.h"
+
+#include <vtkActor.h>
+#include <vtkMath.h>
+#include <vtkMatrix3x3.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkOpenGLActor.h>
+#include <vtkOpenGLCamera.h>
+#include <vtkOpenGLRenderWindow.h>
+#include <vtkOpenGLShaderCache.h>
+#include <vtkOpenGLState.h>
+#include <vtkProperty.h>
+#include <vtkRenderer.h>
+#include <vtkShaderProgram.h>
+#include <vtkSmartPointer.h>
+#include <vtkTextureUnitManager.h>
+
+namespace {
+	const char* tileVertexShader =
+		"//VTK::System::Dec\n"
+		"in vec2 cornerMC;\n"
+		"uniform vec4 rect;\n" // x0, y0, x1, y1 of the tile
+		"uniform mat4 MCDCMatrix;\n"
+		"out vec2 tcoord;\n"
+		"void main() {\n"
+		"  tcoord = cornerMC;\n"
+		"  gl_Position = MCDCMatrix * vec4(mix(rect.xy, rect.zw, cornerMC), 0.0, 1.0);\n"
+		"}\n";
+
+	const char* tileFragmentShader =
+		"//VTK::System::Dec\n"
+		"//VTK::Output::Dec\n"
+		"in vec2 tcoord;\n"
+		"uniform sampler2D tile;\n"
+		"uniform int components;\n"
+		"uniform float opacity;\n"
+		"void main() {\n"
+		"  vec4 texel = texture(tile, tcoord);\n"
+		"  vec3 color = components < 3 ? texel.rrr : texel.rgb;\n"
+		"  float alpha = components == 2 ? texel.g : (components == 4 ? texel.a : 1.0);\n"
+		"  gl_FragData[0] = vec4(color, alpha * opacity);\n"
+		"}\n";
+
+	const size_t timingSamples = 256;
+
+	inline int keyLevel(uint64_t key){
+		return static_cast<int>(key >> 48);
+	}
+
+	inline int keyY(uint64_t key){
+		return static_cast<int>((key >> 24) & 0xffffff);
+	}
+
+	inline int keyX(uint64_t key){
+		return static_cast<int>(key & 0xffffff);
+	}
+}
+
+vtkStandardNewMacro(VtkTiledImageMapper);
+
+VtkTiledImageMapper::VtkTiledImageMapper()
+	: Generation(0), MemoryLimit(256 * 1024 * 1024), UploadsPerRender(8), RenderCount(0), ResidentBytes(0), TimingIndex(0),
+	VertexBuffer(0), VertexArray(0), VertexArrayProgram(0), Stats(), ShuttingDown(false){
+	Stats.memoryLimit = MemoryLimit;
+}
+
+VtkTiledImageMapper::~VtkTiledImageMapper(){
+	ShuttingDown = true; // queued decodes return right away
+}
+
+double* VtkTiledImageMapper::GetBounds(){
+	if (!Pyramid){
+		vtkMath::UninitializeBounds(this->Bounds);
+	}
+	else{
+		this->Bounds[0] = this->Bounds[2] = this->Bounds[4] = this->Bounds[5] = 0.0;
+		this->Bounds[1] = Pyramid->getWidth();
+		this->Bounds[3] = Pyramid->getHeight();
+	}
+	return this->Bounds;
+}
+
+void VtkTiledImageMapper::SetPyramid(const std::shared_ptr<VtkTilePyramid>& pyramid){
+	if (pyramid == Pyramid){
+		return;
+	}
+	// No context here: the textures go at the next render
+	for (const auto& resident : Resident){
+		StaleTextures.push_back(resident.second.texture);
+	}
+	Resident.clear();
+	Lru.clear();
+	ResidentBytes = 0;
+	Requested.clear();
+	Failed.clear();
+	Latencies.clear();
+	DecodeTimes.clear();
+	TimingIndex = 0;
+	{
+		std::lock_guard<std::mutex> lock(DecodedMutex);
+		Decoded.clear();
+		Wanted.clear();
+	}
+	Generation++;
+	Pyramid = pyramid;
+	Stats = VtkTileCacheStats();
+	Stats.memoryLimit = MemoryLimit;
+	this->Modified();
+}
+
+void VtkTiledImageMapper::SetMemoryLimit(size_t bytes){
+	if (bytes != MemoryLimit){
+		MemoryLimit = bytes;
+		Stats.memoryLimit = bytes;
+		this->Modified(); // evicts at the next render
+	}
+}
+
+bool VtkTiledImageMapper::HasDecodedTiles(){
+	std::lock_guard<std::mutex> lock(DecodedMutex);
+	return !Decoded.empty();
+}
+
+void VtkTiledImageMapper::SetDecodedCallback(const std::function<void()>& callback){
+	std::lock_guard<std::mutex> lock(DecodedMutex);
+	DecodedCallback = callback;
+}
+
+bool VtkTiledImageMapper::VisibleRegion(vtkRenderer* ren, vtkActor* actor, double region[4], double& unitsPerPixel){
+	// World to model coordinates, for actors that aren't at the origin
+	vtkSmartPointer<vtkMatrix4x4> worldToModel = vtkSmartPointer<vtkMatrix4x4>::New();
+	if (!actor->GetIsIdentity()){
+		vtkMatrix4x4::Invert(actor->GetMatrix(), worldToModel);
+	}
+	const int* sizePointer = ren->GetSize();
+	const int size[2] = {sizePointer[0], sizePointer[1]};
+	const int* originPointer = ren->GetOrigin();
+	const int origin[2] = {originPointer[0], originPointer[1]};
+	if (size[0] < 1 || size[1] < 1){
+		return false;
+	}
+
+	// Where the ray through a display position meets z = 0
+	auto planePoint = [&](double x, double y, double point[2]) -> bool {
+		double ends[2][4];
+		for (int end = 0; end < 2; end++){
+			double world[4];
+			ren->SetDisplayPoint(origin[0] + x, origin[1] + y, end);
+			ren->DisplayToWorld();
+			ren->GetWorldPoint(world);
+			if (world[3] == 0.0){
+				return false;
+			}
+			for (int i = 0; i < 3; i++){
+				world[i] /= world[3];
+			}
+			world[3] = 1.0;
+			worldToModel->MultiplyPoint(world, ends[end]);
+		}
+		const double dz = ends[1][2] - ends[0][2];
+		if (std::abs(dz) < 1e-12){
+			return false;
+		}
+		const double t = -ends[0][2] / dz;
+		point[0] = ends[0][0] + t * (ends[1][0] - ends[0][0]);
+		point[1] = ends[0][1] + t * (ends[1][1] - ends[0][1]);
+		return true;
+	};
+
+	region[0] = region[2] = VTK_DOUBLE_MAX;
+	region[1] = region[3] = -VTK_DOUBLE_MAX;
+	const double corners[4][2] = {{0.0, 0.0}, {1.0 * size[0], 0.0}, {0.0, 1.0 * size[1]}, {1.0 * size[0], 1.0 * size[1]}};
+	for (const auto& corner : corners){
+		double point[2];
+		if (!planePoint(corner[0], corner[1], point)){
+			return false;
+		}
+		region[0] = std::min(region[0], point[0]);
+		region[1] = std::max(region[1], point[0]);
+		region[2] = std::min(region[2], point[1]);
+		region[3] = std::max(region[3], point[1]);
+	}
+	double center[2], beside[2];
+	if (!planePoint(size[0] / 2.0, size[1] / 2.0, center) || !planePoint(size[0] / 2.0 + 1.0, size[1] / 2.0, beside)){
+		return false;
+	}
+	unitsPerPixel = std::hypot(beside[0] - center[0], beside[1] - center[1]);
+
+	region[0] = std::max(region[0], 0.0);
+	region[1] = std::min(region[1], static_cast<double>(Pyramid->getWidth()));
+	region[2] = std::max(region[2], 0.0);
+	region[3] = std::min(region[3], static_cast<double>(Pyramid->getHeight()));
+	return region[0] < region[1] && region[2] < region[3];
+}
+
+void VtkTiledImageMapper::RequestTile(TileKey key, std::chrono::steady_clock::time_point now){
+	Requested[key] = now;
+	const std::shared_ptr<VtkTilePyramid> pyramid = Pyramid;
+	const unsigned long generation = Generation;
+	Workers.submit([this, pyramid, key, generation](){
+		if (ShuttingDown){
+			return;
+		}
+		DecodedTile tile;
+		tile.key = key;
+		tile.width = tile.height = 0;
+		tile.decodeTime = 0.0;
+		tile.generation = generation;
+		{
+			std::lock_guard<std::mutex> lock(DecodedMutex);
+			tile.dropped = Wanted.count(key) == 0;
+		}
+		if (!tile.dropped){
+			const auto start = std::chrono::steady_clock::now();
+			if (!pyramid->readTile(keyLevel(key), keyX(key), keyY(key), tile.pixels, tile.width, tile.height)){
+				tile.pixels.clear();
+			}
+			tile.decodeTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+		std::function<void()> callback;
+		{
+			std::lock_guard<std::mutex> lock(DecodedMutex);
+			Decoded.push_back(std::move(tile));
+			callback = DecodedCallback;
+		}
+		if (callback){
+			callback();
+		}
+	});
+}
+
+void VtkTiledImageMapper::UploadDecodedTiles(vtkOpenGLState* state){
+	std::vector<DecodedTile> ready;
+	{
+		std::lock_guard<std::mutex> lock(DecodedMutex);
+		ready.swap(Decoded);
+	}
+	const auto now = std::chrono::steady_clock::now();
+	const int components = Pyramid->getComponents();
+	const GLint internalFormats[4] = {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+	const GLenum formats[4] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+	int uploads = 0;
+	size_t next = 0;
+	for (; next < ready.size() && uploads < UploadsPerRender; next++){
+		DecodedTile& tile = ready[next];
+		if (tile.generation != Generation){
+			continue; // Requested already forgot it
+		}
+		auto request = Requested.find(tile.key);
+		if (request == Requested.end()){
+			continue;
+		}
+		const double latency = std::chrono::duration<double, std::milli>(now - request->second).count();
+		Requested.erase(request);
+		if (tile.dropped){
+			Stats.droppedTiles++;
+			continue;
+		}
+		if (tile.pixels.empty()){
+			Failed.insert(tile.key);
+			continue;
+		}
+
+		ResidentTile resident;
+		glGenTextures(1, &resident.texture);
+		glBindTexture(GL_TEXTURE_2D, resident.texture);
+		state->vtkglPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexImage2D(GL_TEXTURE_2D, 0, internalFormats[components - 1], tile.width, tile.height, 0, formats[components - 1], GL_UNSIGNED_BYTE, tile.pixels.data());
+		state->vtkglPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glGenerateMipmap(GL_TEXTURE_2D); // smooth minification between two pyramid levels
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		resident.width = tile.width;
+		resident.height = tile.height;
+		resident.bytes = tile.pixels.size() * 4 / 3; // with the mipmaps
+		resident.lastDrawn = 0;
+		Lru.push_front(tile.key);
+		resident.lruPosition = Lru.begin();
+		Resident[tile.key] = resident;
+		ResidentBytes += resident.bytes;
+		Stats.loadedTiles++;
+		uploads++;
+
+		if (Latencies.size() < timingSamples){
+			Latencies.push_back(latency);
+			DecodeTimes.push_back(tile.decodeTime);
+		}
+		else{
+			Latencies[TimingIndex] = latency;
+			DecodeTimes[TimingIndex] = tile.decodeTime;
+		}
+		TimingIndex = (TimingIndex + 1) % timingSamples;
+	}
+
+	// Over the budget: back in front of the queue for the next render
+	if (next < ready.size()){
+		std::lock_guard<std::mutex> lock(DecodedMutex);
+		Decoded.insert(Decoded.begin(), std::make_move_iterator(ready.begin() + next), std::make_move_iterator(ready.end()));
+	}
+}
+
+void VtkTiledImageMapper::DrawTile(vtkShaderProgram* program, TileKey key, ResidentTile& tile){
+	const int level = keyLevel(key);
+	const double scale = std::ldexp(1.0, level);
+	const double tileUnits = Pyramid->getTileSize() * scale;
+	const float rect[4] = {
+		static_cast<float>(keyX(key) * tileUnits),
+		static_cast<float>(keyY(key) * tileUnits),
+		static_cast<float>(std::min(keyX(key) * tileUnits + tile.width * scale, static_cast<double>(Pyramid->getWidth()))),
+		static_cast<float>(std::min(keyY(key) * tileUnits + tile.height * scale, static_cast<double>(Pyramid->getHeight())))
+	};
+	program->SetUniform4f("rect", rect);
+	glBindTexture(GL_TEXTURE_2D, tile.texture);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+	tile.lastDrawn = RenderCount;
+	Lru.splice(Lru.begin(), Lru, tile.lruPosition);
+}
+
+void VtkTiledImageMapper::EvictTiles(){
+	// Least recently drawn first, never a tile of this render
+	while (ResidentBytes > MemoryLimit && !Lru.empty()){
+		auto resident = Resident.find(Lru.back());
+		if (resident->second.lastDrawn == RenderCount){
+			break;
+		}
+		glDeleteTextures(1, &resident->second.texture);
+		ResidentBytes -= resident->second.bytes;
+		Resident.erase(resident);
+		Lru.pop_back();
+		Stats.evictedTiles++;
+	}
+}
+
+void VtkTiledImageMapper::DeleteAllTiles(){
+	for (const auto& resident : Resident){
+		glDeleteTextures(1, &resident.second.texture);
+	}
+	Resident.clear();
+	Lru.clear();
+	ResidentBytes = 0;
+	if (!StaleTextures.empty()){
+		glDeleteTextures(static_cast<GLsizei>(StaleTextures.size()), StaleTextures.data());
+		StaleTextures.clear();
+	}
+}
+
+void VtkTiledImageMapper::Render(vtkRenderer* ren, vtkActor* actor){
+	if (!StaleTextures.empty()){
+		glDeleteTextures(static_cast<GLsizei>(StaleTextures.size()), StaleTextures.data());
+		StaleTextures.clear();
+	}
+	if (!Pyramid){
+		return;
+	}
+	vtkOpenGLRenderWindow* renWin = vtkOpenGLRenderWindow::SafeDownCast(ren->GetRenderWindow());
+	RenderCount++;
+	UploadDecodedTiles(renWin->GetState());
+
+	// Visible tiles of the coarsest level whose pixels are no larger than a screen pixel, nearest to the center first
+	const VtkTilePyramid& pyramid = *Pyramid;
+	double region[4], unitsPerPixel = 1.0;
+	const bool inView = VisibleRegion(ren, actor, region, unitsPerPixel);
+	int level = 0;
+	if (unitsPerPixel > 1.0){
+		level = std::min(pyramid.getLevelCount() - 1, static_cast<int>(std::floor(std::log2(unitsPerPixel))));
+	}
+	std::vector<std::pair<double, TileKey>> visible;
+	if (inView){
+		const double tileUnits = std::ldexp(static_cast<double>(pyramid.getTileSize()), level);
+		const int x0 = std::max(0, static_cast<int>(std::floor(region[0] / tileUnits)));
+		const int x1 = std::min(pyramid.getTilesX(level) - 1, static_cast<int>(std::floor(region[1] / tileUnits)));
+		const int y0 = std::max(0, static_cast<int>(std::floor(region[2] / tileUnits)));
+		const int y1 = std::min(pyramid.getTilesY(level) - 1, static_cast<int>(std::floor(region[3] / tileUnits)));
+		const double centerX = (region[0] + region[1]) / 2.0, centerY = (region[2] + region[3]) / 2.0;
+		for (int y = y0; y <= y1; y++){
+			for (int x = x0; x <= x1; x++){
+				const double dx = (x + 0.5) * tileUnits - centerX, dy = (y + 0.5) * tileUnits - centerY;
+				visible.push_back(std::make_pair(dx * dx + dy * dy, MakeKey(level, x, y)));
+			}
+		}
+		std::sort(visible.begin(), visible.end());
+	}
+
+	// Missing tiles are drawn from their finest resident ancestor; without one, the coarsest level's tile covering
+	// them is requested ahead of everything else, as a cheap preview
+	std::vector<TileKey> drawn, fallbacks, previews, wanted;
+	for (const auto& tile : visible){
+		const TileKey key = tile.second;
+		if (Resident.count(key)){
+			drawn.push_back(key);
+			continue;
+		}
+		wanted.push_back(key);
+		int ancestor = level + 1;
+		for (; ancestor < pyramid.getLevelCount(); ancestor++){
+			const TileKey ancestorKey = MakeKey(ancestor, keyX(key) >> (ancestor - level), keyY(key) >> (ancestor - level));
+			if (Resident.count(ancestorKey)){
+				fallbacks.push_back(ancestorKey);
+				break;
+			}
+		}
+		if (ancestor == pyramid.getLevelCount() && level + 1 < pyramid.getLevelCount()){
+			const int top = pyramid.getLevelCount() - 1;
+			previews.push_back(MakeKey(top, keyX(key) >> (top - level), keyY(key) >> (top - level)));
+		}
+	}
+	// Coarsest first, finer tiles paint over them (the level is in the key's high bits)
+	std::sort(fallbacks.begin(), fallbacks.end(), std::greater<TileKey>());
+	fallbacks.erase(std::unique(fallbacks.begin(), fallbacks.end()), fallbacks.end());
+	std::sort(previews.begin(), previews.end());
+	previews.erase(std::unique(previews.begin(), previews.end()), previews.end());
+	wanted.insert(wanted.begin(), previews.begin(), previews.end());
+
+	{
+		std::lock_guard<std::mutex> lock(DecodedMutex);
+		Wanted.clear();
+		Wanted.insert(wanted.begin(), wanted.end());
+	}
+	// Only a few requests ahead of the workers, so the queue follows the view
+	const size_t maximumRequested = Workers.getThreadCount() * 2 + 2;
+	const auto now = std::chrono::steady_clock::now();
+	for (const TileKey key : wanted){
+		if (Requested.size() >= maximumRequested){
+			break;
+		}
+		if (!Requested.count(key) && !Failed.count(key)){
+			RequestTile(key, now);
+		}
+	}
+
+	if (!drawn.empty() || !fallbacks.empty()){
+		vtkShaderProgram* program = renWin->GetShaderCache()->ReadyShaderProgram(tileVertexShader, tileFragmentShader, "");
+		if (!program){
+			vtkErrorMacro("Could not build the tile shader program");
+			return;
+		}
+
+		if (!VertexBuffer){
+			const float corners[8] = {0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f};
+			glGenBuffers(1, &VertexBuffer);
+			glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+		}
+		if (!VertexArray || VertexArrayProgram != program->GetHandle()){
+			if (!VertexArray){
+				glGenVertexArrays(1, &VertexArray);
+			}
+			glBindVertexArray(VertexArray);
+			GLint cornerLocation = glGetAttribLocation(program->GetHandle(), "cornerMC");
+			glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
+			glEnableVertexAttribArray(cornerLocation);
+			glVertexAttribPointer(cornerLocation, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), nullptr);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			glBindVertexArray(0);
+			VertexArrayProgram = program->GetHandle();
+		}
+
+		// Same matrix conventions as vtkOpenGLPolyDataMapper (matrices are already transposed for GL)
+		vtkOpenGLCamera* camera = static_cast<vtkOpenGLCamera*>(ren->GetActiveCamera());
+		vtkMatrix4x4* wcvc;
+		vtkMatrix3x3* cameraNormals;
+		vtkMatrix4x4* vcdc;
+		vtkMatrix4x4* wcdc;
+		camera->GetKeyMatrices(ren, wcvc, cameraNormals, vcdc, wcdc);
+		if (actor->GetIsIdentity()){
+			program->SetUniformMatrix("MCDCMatrix", wcdc);
+		}
+		else{
+			vtkMatrix4x4* mcwc;
+			vtkMatrix3x3* actorNormals;
+			static_cast<vtkOpenGLActor*>(actor)->GetKeyMatrices(mcwc, actorNormals);
+			vtkSmartPointer<vtkMatrix4x4> mcdc = vtkSmartPointer<vtkMatrix4x4>::New();
+			vtkMatrix4x4::Multiply4x4(mcwc, wcdc, mcdc);
+			program->SetUniformMatrix("MCDCMatrix", mcdc);
+		}
+		program->SetUniformi("components", pyramid.getComponents());
+		program->SetUniformf("opacity", static_cast<float>(actor->GetProperty()->GetOpacity()));
+
+		vtkTextureUnitManager* units = renWin->GetTextureUnitManager();
+		const int unit = units->Allocate();
+		program->SetUniformi("tile", unit);
+		renWin->GetState()->vtkglActiveTexture(GL_TEXTURE0 + unit);
+		glBindVertexArray(VertexArray);
+		for (const TileKey key : fallbacks){
+			DrawTile(program, key, Resident[key]);
+		}
+		for (const TileKey key : drawn){
+			DrawTile(program, key, Resident[key]);
+		}
+		glBindVertexArray(0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		renWin->GetState()->vtkglActiveTexture(GL_TEXTURE0);
+		units->Free(unit);
+	}
+	EvictTiles();
+
+	Stats.level = level;
+	Stats.visibleTiles = static_cast<int>(visible.size());
+	Stats.missingTiles = static_cast<int>(visible.size() - drawn.size());
+	Stats.residentTiles = Resident.size();
+	Stats.residentBytes = ResidentBytes;
+	Stats.pendingTiles = Requested.size();
+	Stats.averageLatency = Stats.maximumLatency = Stats.averageDecodeTime = 0.0;
+	for (size_t i = 0; i < Latencies.size(); i++){
+		Stats.averageLatency += Latencies[i] / Latencies.size();
+		Stats.maximumLatency = std::max(Stats.maximumLatency, Latencies[i]);
+		Stats.averageDecodeTime += DecodeTimes[i] / DecodeTimes.size();
+	}
+}
+
+void VtkTiledImageMapper::ReleaseGraphicsResources(vtkWindow* window){
+	DeleteAllTiles(); // visible tiles are requested again at the next render
+	if (VertexArray){
+		glDeleteVertexArrays(1, &VertexArray);
+		VertexArray = 0;
+		VertexArrayProgram = 0;
+	}
+	if (VertexBuffer){
+		glDeleteBuffers(1, &VertexBuffer);
+		VertexBuffer = 0;
+	}
+}
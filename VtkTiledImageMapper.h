@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <vtkMapper.h>
+
+#include "VtkTilePyramid.h"
+#include "VtkWorkerPool.h"
+
+class vtkOpenGLState;
+class vtkShaderProgram;
+
+// State of a VtkTiledImageMapper's tile cache, as of its last render
+struct VtkTileCacheStats {
+	int level; // pyramid level drawn
+	int visibleTiles; // at that level
+	int missingTiles; // visible but not resident yet, drawn from a coarser level meanwhile
+	size_t residentTiles; // textures in the GPU cache
+	size_t residentBytes; // mipmaps included; above memoryLimit only while the visible tiles alone need more
+	size_t memoryLimit;
+	size_t pendingTiles; // requested, not uploaded yet
+	unsigned long loadedTiles; // uploaded since the pyramid was set
+	unsigned long evictedTiles;
+	unsigned long droppedTiles; // left the view before a worker got to them
+	double averageLatency; // ms from request to upload, over the last 256 tiles
+	double maximumLatency;
+	double averageDecodeTime; // ms of file read and decoding per tile, same tiles
+};
+
+// Draws a VtkTilePyramid in the z = 0 plane, one world unit per full-resolution pixel, reading only the tiles
+// covering the view at the coarsest level whose pixels are no larger than a screen pixel. Missing tiles
+// are requested nearest to the center of the view first, decoded on a VtkWorkerPool and uploaded a few per render
+// as mipmapped textures into an LRU cache with a memory limit; until a tile arrives, the finest resident tile of a
+// coarser level covering it is drawn instead. Requests that left the view before a worker started on them are
+// dropped. Meant for a parallel projection looking down z; use it with a vtkActor.
+class VtkTiledImageMapper : public vtkMapper {
+public:
+	static VtkTiledImageMapper* New();
+	vtkTypeMacro(VtkTiledImageMapper, vtkMapper);
+public:
+	void Render(vtkRenderer* ren, vtkActor* actor) override;
+	void ReleaseGraphicsResources(vtkWindow* window) override;
+	using vtkMapper::GetBounds;
+	double* GetBounds() override;
+
+	// Drops every tile of the previous pyramid; nullptr draws nothing
+	void SetPyramid(const std::shared_ptr<VtkTilePyramid>& pyramid);
+	inline const std::shared_ptr<VtkTilePyramid>& GetPyramid() const {
+		return Pyramid;
+	}
+
+	// GPU memory for tile textures (default 256 MB); least recently drawn tiles are evicted beyond it
+	void SetMemoryLimit(size_t bytes);
+	inline size_t GetMemoryLimit() const {
+		return MemoryLimit;
+	}
+
+	// Decoded tiles uploaded per render at most (default 8), which bounds the upload stall of a frame
+	vtkSetClampMacro(UploadsPerRender, int, 1, 1024);
+	vtkGetMacro(UploadsPerRender, int);
+
+	// True when decoded tiles wait for upload: the viewer should render again (VtkViewer::requestRedraw())
+	bool HasDecodedTiles();
+	// Called on a worker thread whenever a tile is decoded, e.g. to wake an event loop waiting for input
+	void SetDecodedCallback(const std::function<void()>& callback);
+
+	inline const VtkTileCacheStats& GetStats() const {
+		return Stats;
+	}
+protected:
+	VtkTiledImageMapper();
+	~VtkTiledImageMapper() override;
+protected:
+	typedef uint64_t TileKey; // level << 48 | y << 24 | x
+
+	struct ResidentTile {
+		unsigned int texture;
+		int width, height;
+		size_t bytes;
+		unsigned long lastDrawn; // render count
+		std::list<TileKey>::iterator lruPosition;
+	};
+	struct DecodedTile {
+		TileKey key;
+		int width, height;
+		std::vector<unsigned char> pixels; // empty when the request was dropped or failed
+		bool dropped;
+		double decodeTime;
+		unsigned long generation; // pyramid it was requested from
+	};
+protected:
+	static inline TileKey MakeKey(int level, int x, int y) {
+		return (static_cast<TileKey>(level) << 48) | (static_cast<TileKey>(y) << 24) | static_cast<TileKey>(x);
+	}
+	// Rectangle of the z = 0 plane (model coordinates) seen by the renderer, and model units per screen pixel;
+	// false if the plane isn't in view
+	bool VisibleRegion(vtkRenderer* ren, vtkActor* actor, double region[4], double& unitsPerPixel);
+	void RequestTile(TileKey key, std::chrono::steady_clock::time_point now);
+	void UploadDecodedTiles(vtkOpenGLState* state);
+	void DrawTile(vtkShaderProgram* program, TileKey key, ResidentTile& tile); // on the active texture unit
+	void EvictTiles();
+	void DeleteAllTiles();
+protected:
+	std::shared_ptr<VtkTilePyramid> Pyramid;
+	unsigned long Generation; // bumped by SetPyramid(), decodes of older pyramids are ignored
+	size_t MemoryLimit;
+	int UploadsPerRender;
+	unsigned long RenderCount;
+
+	// Render thread: GPU cache, most recently drawn first in Lru
+	std::unordered_map<TileKey, ResidentTile> Resident;
+	std::list<TileKey> Lru;
+	size_t ResidentBytes;
+	std::unordered_map<TileKey, std::chrono::steady_clock::time_point> Requested; // submitted, with the request time
+	std::unordered_set<TileKey> Failed; // unreadable, not requested again
+	std::vector<unsigned int> StaleTextures; // of a previous pyramid, deleted at the next render
+	std::vector<double> Latencies, DecodeTimes; // ring buffers
+	size_t TimingIndex;
+
+	unsigned int VertexBuffer; // unit quad corners
+	unsigned int VertexArray;
+	unsigned int VertexArrayProgram; // program handle the vertex array was set up for
+
+	VtkTileCacheStats Stats;
+
+	std::mutex DecodedMutex; // guards the three below
+	std::vector<DecodedTile> Decoded;
+	std::unordered_set<TileKey> Wanted; // tiles still worth decoding, updated every render
+	std::function<void()> DecodedCallback;
+	std::atomic<bool> ShuttingDown;
+
+	VtkWorkerPool Workers; // declared last: joined before the members its decodes write to are destroyed
+private:
+	VtkTiledImageMapper(const VtkTiledImageMapper&) = delete;
+	void operator=(const VtkTiledImageMapper&) = delete;
+};
@@ -1,4 +1,9 @@
 #include "VtkViewer.h"
+#include "VtkLodManager.h"
+#include "VtkRenderThread.h"
+#include "VtkOrientationMarker.h"
+#include "VtkTemporalAccumulator.h"
+#include "VtkInstancedGlyphs.h"
 
 // dear imgui: Renderer for VTK(OpenGL back end)
 // - Desktop GL: 2.x 3.x 4.x
@@ -25,6 +30,10 @@
 #else
 #include <stdint.h>     // intptr_t
 #endif
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 
 // OpenGL Loader
 // This can be replaced with another loader, e.g. glad, but
@@ -34,91 +43,338 @@
 // Include glfw3.h after our OpenGL definitions
 #include <GLFW/glfw3.h>
 
+#include <vtkVersion.h>
+#include <vtkSMPTools.h>
+#include <vtkMapper.h>
+#include <vtkVolume.h>
+#include <vtkAbstractVolumeMapper.h>
+#include <vtkImageSlice.h>
+#include <vtkImageMapper3D.h>
+#include <vtkActor2D.h>
+#include <vtkMapper2D.h>
+#include <vtkCamera.h>
+#include <vtkLight.h>
+#include <vtkLightCollection.h>
+#include <vtkDataObject.h>
+#include <vtkImageData.h>
+#include <vtkTexture.h>
+#include <vtkMatrix4x4.h>
+#include <vtkOpenGLState.h>
+#include <vtkProperty.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkCellPicker.h>
+#include <vtkRenderStepsPass.h>
+#include <vtkOrderIndependentTranslucentPass.h>
+
+#if VTK_MAJOR_VERSION > 9 || (VTK_MAJOR_VERSION == 9 && VTK_MINOR_VERSION >= 2)
+#define IMGUI_VTK_SMP_LOCAL_SCOPE 1 // vtkSMPTools::LocalScope / vtkSMPTools::Config
+#endif
+#if VTK_MAJOR_VERSION > 9 || (VTK_MAJOR_VERSION == 9 && VTK_MINOR_VERSION >= 1)
+#define IMGUI_VTK_SMP_RUNTIME_BACKEND 1 // vtkSMPTools::SetBackend / vtkSMPTools::GetBackend
+#endif
+
+namespace {
+	// Filters whose RequestData is parallelized with vtkSMPTools
+	const char* smpCapableFilters[] = {
+		"vtkFlyingEdges2D", "vtkFlyingEdges3D", "vtkFlyingEdgesPlaneCutter", "vtkDiscreteFlyingEdges3D",
+		"vtkSMPContourGrid", "vtkContour3DLinearGrid", "vtkPolyDataNormals", "vtkWindowedSincPolyDataFilter",
+		"vtkElevationFilter", "vtkStaticCleanPolyData", "vtkPointDataToCellData", "vtkCellDataToPointData",
+		"vtkTransformFilter", "vtkTransformPolyDataFilter", "vtkThreshold", "vtkGradientFilter", "vtkImageReslice",
+		"vtkCutter", "vtkPlaneCutter", "vtkSurfaceNets3D"
+	};
+
+	bool isSMPCapable(vtkAlgorithm* algorithm){
+		for (const char* name : smpCapableFilters){
+			if (algorithm->IsA(name)){
+				return true;
+			}
+		}
+		return false;
+	}
+
+	std::string currentSMPBackend(){
+#ifdef IMGUI_VTK_SMP_RUNTIME_BACKEND
+		return vtkSMPTools::GetBackend();
+#else
+		return "compile-time";
+#endif
+	}
+
+	const float MinRenderScale = 0.5f;
+	const float MaxRenderScale = 2.0f;
+
+	float clampRenderScale(float scale, float minScale, float maxScale){
+		return std::min(std::max(scale, minScale), maxScale);
+	}
+
+	vtkAlgorithm* propMapper(vtkProp* prop){
+		if (auto actor = vtkActor::SafeDownCast(prop)){
+			return actor->GetMapper();
+		}
+		if (auto volume = vtkVolume::SafeDownCast(prop)){
+			return volume->GetMapper();
+		}
+		if (auto slice = vtkImageSlice::SafeDownCast(prop)){
+			return slice->GetMapper();
+		}
+		if (auto actor2D = vtkActor2D::SafeDownCast(prop)){
+			return actor2D->GetMapper();
+		}
+		return nullptr;
+	}
+
+	// Largest MTime of algorithm and everything upstream of it (trivial producers include their data object)
+	vtkMTimeType pipelineMTime(vtkAlgorithm* algorithm){
+		if (!algorithm){
+			return 0;
+		}
+		vtkMTimeType mtime = algorithm->GetMTime();
+		for (int port = 0; port < algorithm->GetNumberOfInputPorts(); port++){
+			for (int connection = 0; connection < algorithm->GetNumberOfInputConnections(port); connection++){
+				mtime = std::max(mtime, pipelineMTime(algorithm->GetInputAlgorithm(port, connection)));
+			}
+		}
+		return mtime;
+	}
+}
+
+std::vector<VtkViewer*> VtkViewer::instances;
+std::atomic<unsigned long> VtkViewer::totalRenderCount(0);
+std::atomic<long long> VtkViewer::totalRenderTime(0);
+unsigned int VtkViewer::nextViewerId = 1;
+size_t VtkViewer::gpuMemoryBudget = 0;
+double VtkViewer::gpuEvictionDelay = 0.0;
+int VtkViewer::budgetFrame = -1;
+std::mutex VtkViewer::filterMutex;
+
 void VtkViewer::isCurrentCallbackFn(vtkObject* caller, long unsigned int eventId, void* clientData, void* callData){
 	bool* isCurrent = static_cast<bool*>(callData);
 	*isCurrent = true;
 }
 
-void VtkViewer::processEvents(){
+void VtkViewer::filterStartCallbackFn(vtkObject* caller, long unsigned int eventId, void* clientData, void* callData){
+	VtkFilterExecution* execution = static_cast<VtkFilterExecution*>(clientData);
+	std::lock_guard<std::mutex> lock(filterMutex);
+	execution->start = std::chrono::steady_clock::now();
+}
+
+void VtkViewer::filterEndCallbackFn(vtkObject* caller, long unsigned int eventId, void* clientData, void* callData){
+	VtkFilterExecution* execution = static_cast<VtkFilterExecution*>(clientData);
+	std::lock_guard<std::mutex> lock(filterMutex);
+	execution->lastExecutionTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - execution->start).count();
+	execution->executions++;
+	// Queried while the filter's SMP scope is still active, so this is what the filter actually ran with
+	execution->threads = vtkSMPTools::GetEstimatedNumberOfThreads();
+	execution->backend = currentSMPBackend();
+	execution->ranParallel = execution->smpCapable && execution->threads > 1 && execution->backend != "Sequential";
+}
+
+void VtkViewer::dynamicLayerStartCallbackFn(vtkObject* caller, long unsigned int eventId, void* clientData, void* callData){
+	static_cast<VtkViewer*>(clientData)->blitStaticLayer();
+}
+
+void VtkViewer::processEvents(unsigned int width, unsigned int height){
 	if (!ImGui::IsWindowFocused() && !ImGui::IsWindowHovered()){
 		return;
 	}
 
 	ImGuiIO& io = ImGui::GetIO(); (void)io;
 	io.ConfigWindowsMoveFromTitleBarOnly = true; // don't drag window when clicking on image.
-	ImVec2 viewportPos = ImGui::GetCursorStartPos();
 
-	double xpos = static_cast<double>(io.MousePos[0]) - static_cast<double>(viewportPos.x);
-	double ypos = static_cast<double>(io.MousePos[1]) - static_cast<double>(viewportPos.y);
+	// Relative to the image (the last item), in render target pixels rather than ImGui units
+	const ImVec2 imagePos = ImGui::GetItemRectMin();
+	const ImVec2 imageSize = ImGui::GetItemRectSize();
+	const double scaleX = imageSize.x > 0.0f ? width / static_cast<double>(imageSize.x) : 1.0;
+	const double scaleY = imageSize.y > 0.0f ? height / static_cast<double>(imageSize.y) : 1.0;
+	double xpos = (static_cast<double>(io.MousePos[0]) - static_cast<double>(imagePos.x)) * scaleX;
+	double ypos = (static_cast<double>(io.MousePos[1]) - static_cast<double>(imagePos.y)) * scaleY;
 	int ctrl = static_cast<int>(io.KeyCtrl);
 	int shift = static_cast<int>(io.KeyShift);
 	bool dclick = io.MouseDoubleClicked[0] || io.MouseDoubleClicked[1] || io.MouseDoubleClicked[2];
 
-	interactor->SetEventInformationFlipY(xpos, ypos, ctrl, shift, dclick);
+	// With a render thread the interactor (and the camera it drives) belongs to that thread, events are queued
+	VtkViewerEvent event = {0, xpos, ypos, ctrl, shift, dclick};
+	auto dispatch = [this, &event](unsigned long eventId){
+		if (renderThread){
+			event.eventId = eventId;
+			renderThread->pushEvent(event);
+		}
+		else{
+			interactor->InvokeEvent(eventId, nullptr);
+		}
+	};
+	if (!renderThread){
+		interactor->SetEventInformationFlipY(xpos, ypos, ctrl, shift, dclick);
+	}
 
 	if (ImGui::IsWindowHovered()){
 		if (io.MouseClicked[ImGuiMouseButton_Left]){
-			interactor->InvokeEvent(vtkCommand::LeftButtonPressEvent, nullptr);
+			dispatch(vtkCommand::LeftButtonPressEvent);
 		}
 		else if (io.MouseClicked[ImGuiMouseButton_Right]){
-			interactor->InvokeEvent(vtkCommand::RightButtonPressEvent, nullptr);
+			dispatch(vtkCommand::RightButtonPressEvent);
 			ImGui::SetWindowFocus(); // make right-clicks bring window into focus
 		}
 		else if (io.MouseWheel > 0){
-			interactor->InvokeEvent(vtkCommand::MouseWheelForwardEvent, nullptr);
+			dispatch(vtkCommand::MouseWheelForwardEvent);
 		}
 		else if (io.MouseWheel < 0){
-			interactor->InvokeEvent(vtkCommand::MouseWheelBackwardEvent, nullptr);
+			dispatch(vtkCommand::MouseWheelBackwardEvent);
 		}
 	}
 
 	if (io.MouseReleased[ImGuiMouseButton_Left]){
-		interactor->InvokeEvent(vtkCommand::LeftButtonReleaseEvent, nullptr);
+		dispatch(vtkCommand::LeftButtonReleaseEvent);
 	}
 	else if (io.MouseReleased[ImGuiMouseButton_Right]){
-		interactor->InvokeEvent(vtkCommand::RightButtonReleaseEvent, nullptr);
+		dispatch(vtkCommand::RightButtonReleaseEvent);
 	}
 
-	interactor->InvokeEvent(vtkCommand::MouseMoveEvent, nullptr);
+	dispatch(vtkCommand::MouseMoveEvent);
+}
+
+void VtkViewer::replayEvent(const VtkViewerEvent& event){
+	interactor->SetEventInformationFlipY(event.x, event.y, event.ctrl, event.shift, event.dclick);
+	interactor->InvokeEvent(event.eventId, nullptr);
 }
 
 VtkViewer::VtkViewer() 
 	: viewportWidth(0), viewportHeight(0), renderWindow(nullptr), interactor(nullptr), interactorStyle(nullptr),
-	renderer(nullptr), tex(0), firstRender(true){
+	renderer(nullptr), tex(0), firstRender(true), frameTexture(0), multiSamples(0), lastRenderTime(0.0), framerate(0.0), smpThreads(0), lodManager(nullptr),
+	orientationMarker(nullptr), renderScale(1.0f), currentRenderScale(1.0f), dynamicRenderScale(false), targetFrameTime(16.0),
+	minRenderScale(MinRenderScale), maxRenderScale(1.0f), scaledFrameCount(0), accumulationFrames(0), accumulatedFrames(0),
+	transparencyMode(TransparencyMode::Unsorted), maximumPeels(4), peelingTimeBudget(16.0),
+	dynamicStartTag(0), layerCacheValid(false), staticLayerDrawn(false), staticRenderedMTime(0), staticRenderCount(0), dynamicRenderCount(0),
+	commands(new MpscQueue<VtkSceneCommand>(CommandQueueCapacity)), applyingThread(std::thread::id()), lastCommandBatch(0), maxCommandBatch(0),
+	commandLatency(0.0), maxCommandLatency(0.0), droppedCommands(0),
+	renderOnDemand(false), animating(false), redrawRequested(false), renderedMTime(0),
+	renderedFrame(-1), renderCount(0), firstFramePending(false), firstFrameTime(0.0), name("VtkViewer #" + std::to_string(nextViewerId++)), gpuBytes(0), lastShown(std::chrono::steady_clock::now()){
 	init();
-}
-
-VtkViewer::VtkViewer(const VtkViewer& vtkViewer) 
-	: viewportWidth(0), viewportHeight(0), renderWindow(vtkViewer.renderWindow), interactor(vtkViewer.interactor),
-	interactorStyle(vtkViewer.interactorStyle), renderer(vtkViewer.renderer), tex(vtkViewer.tex),
-	firstRender(vtkViewer.firstRender){
+	instances.push_back(this);
 }
 
 VtkViewer::VtkViewer(VtkViewer&& vtkViewer) noexcept 
-	: viewportWidth(0), viewportHeight(0), renderWindow(std::move(vtkViewer.renderWindow)),
-	interactor(std::move(vtkViewer.interactor)), interactorStyle(std::move(vtkViewer.interactorStyle)),
-	renderer(std::move(vtkViewer.renderer)), tex(vtkViewer.tex), firstRender(vtkViewer.firstRender){
+	: viewportWidth(0), viewportHeight(0), renderWindow(nullptr), interactor(nullptr), interactorStyle(nullptr),
+	renderer(nullptr), tex(0), firstRender(true), frameTexture(0), multiSamples(0), lastRenderTime(0.0), framerate(0.0), smpThreads(0), lodManager(nullptr),
+	orientationMarker(nullptr), renderScale(1.0f), currentRenderScale(1.0f), dynamicRenderScale(false), targetFrameTime(16.0),
+	minRenderScale(MinRenderScale), maxRenderScale(1.0f), scaledFrameCount(0), accumulationFrames(0), accumulatedFrames(0),
+	transparencyMode(TransparencyMode::Unsorted), maximumPeels(4), peelingTimeBudget(16.0),
+	dynamicStartTag(0), layerCacheValid(false), staticLayerDrawn(false), staticRenderedMTime(0), staticRenderCount(0), dynamicRenderCount(0),
+	commands(new MpscQueue<VtkSceneCommand>(CommandQueueCapacity)), applyingThread(std::thread::id()), lastCommandBatch(0), maxCommandBatch(0),
+	commandLatency(0.0), maxCommandLatency(0.0), droppedCommands(0),
+	renderOnDemand(false), animating(false), redrawRequested(false), renderedMTime(0),
+	renderedFrame(-1), renderCount(0), firstFramePending(false), firstFrameTime(0.0), gpuBytes(0){
+	instances.push_back(this);
+	takeFrom(vtkViewer);
 }
 
 VtkViewer::~VtkViewer(){
+	releaseAll();
+	instances.erase(std::remove(instances.begin(), instances.end(), this), instances.end());
+}
+
+VtkViewer& VtkViewer::operator=(VtkViewer&& vtkViewer) noexcept{
+	if (this != &vtkViewer){
+		releaseAll();
+		takeFrom(vtkViewer);
+	}
+	return *this;
+}
+
+void VtkViewer::releaseAll(){
+	renderThread.reset();
+	untrackPipeline();
+
 	renderer = nullptr;
 	interactorStyle = nullptr;
 	interactor = nullptr;
 	renderWindow = nullptr;
 
 	glDeleteTextures(1, &tex);
+	tex = 0;
 }
 
-VtkViewer& VtkViewer::operator=(const VtkViewer& vtkViewer){
-	viewportWidth = vtkViewer.viewportWidth;
-	viewportHeight = vtkViewer.viewportHeight;
-	renderWindow = vtkViewer.renderWindow;
-	interactor = vtkViewer.interactor;
-	interactorStyle = vtkViewer.interactorStyle;
-	renderer = vtkViewer.renderer;
+void VtkViewer::takeFrom(VtkViewer& vtkViewer){
+	// The render thread is bound to the viewer it was started for; the moved-to viewer renders on the ImGui thread
+	vtkViewer.renderThread.reset();
+
+	// The texture (and the render window FBO it is attached to) changes owner, the source no longer deletes it
+	viewportWidth = vtkViewer.viewportWidth.load();
+	viewportHeight = vtkViewer.viewportHeight.load();
+	imageMin = vtkViewer.imageMin;
+	imageMax = vtkViewer.imageMax;
+	renderWindow = std::move(vtkViewer.renderWindow);
+	interactor = std::move(vtkViewer.interactor);
+	interactorStyle = std::move(vtkViewer.interactorStyle);
+	renderer = std::move(vtkViewer.renderer);
 	tex = vtkViewer.tex;
+	vtkViewer.tex = 0;
 	firstRender = vtkViewer.firstRender;
-	return *this;
+	frameTexture = vtkViewer.frameTexture;
+	multiSamples = vtkViewer.multiSamples;
+	accumulator = std::move(vtkViewer.accumulator);
+	accumulationFrames = vtkViewer.accumulationFrames;
+	accumulatedFrames = 0;
+	transparencyMode = vtkViewer.transparencyMode;
+	maximumPeels = vtkViewer.maximumPeels;
+	peelingTimeBudget = vtkViewer.peelingTimeBudget;
+	translucentPass = std::move(vtkViewer.translucentPass);
+	depthSortedActors = std::move(vtkViewer.depthSortedActors);
+	vtkViewer.depthSortedActors.clear();
+	dynamicRenderer = std::move(vtkViewer.dynamicRenderer);
+	if (dynamicRenderer){
+		// The observer's client data is the viewer
+		dynamicRenderer->RemoveObserver(vtkViewer.dynamicStartTag);
+		observeDynamicLayer();
+	}
+	layerCache = std::move(vtkViewer.layerCache);
+	layerCacheValid = false;
+	staticRenderedMTime = 0;
+	staticRenderCount = vtkViewer.staticRenderCount.load();
+	dynamicRenderCount = vtkViewer.dynamicRenderCount.load();
+	// Commands still queued were posted for the moved scene, the source is left with this viewer's emptied queue
+	discardCommands();
+	std::swap(commands, vtkViewer.commands);
+	lastCommandBatch = vtkViewer.lastCommandBatch;
+	maxCommandBatch = vtkViewer.maxCommandBatch;
+	commandLatency = vtkViewer.commandLatency;
+	maxCommandLatency = vtkViewer.maxCommandLatency;
+	droppedCommands = vtkViewer.droppedCommands.load();
+	lastRenderTime = vtkViewer.lastRenderTime.load();
+	framerate = vtkViewer.framerate.load();
+	smpBackend = std::move(vtkViewer.smpBackend);
+	smpThreads = vtkViewer.smpThreads;
+	{
+		std::lock_guard<std::mutex> lock(filterMutex);
+		filterExecutions = std::move(vtkViewer.filterExecutions);
+		vtkViewer.filterExecutions.clear();
+	}
+	lodManager = vtkViewer.lodManager;
+	orientationMarker = vtkViewer.orientationMarker;
+	renderScale = vtkViewer.renderScale;
+	currentRenderScale = vtkViewer.currentRenderScale;
+	dynamicRenderScale = vtkViewer.dynamicRenderScale;
+	targetFrameTime = vtkViewer.targetFrameTime;
+	minRenderScale = vtkViewer.minRenderScale;
+	maxRenderScale = vtkViewer.maxRenderScale;
+	scaledFrameCount = 0;
+	renderOnDemand = vtkViewer.renderOnDemand;
+	animating = vtkViewer.animating.load();
+	redrawRequested = true;
+	renderedMTime = 0;
+	renderedFrame = -1;
+	renderCount = vtkViewer.renderCount.load();
+	firstFrameStart = vtkViewer.firstFrameStart;
+	firstFramePending = vtkViewer.firstFramePending;
+	firstFrameTime = vtkViewer.firstFrameTime;
+	name = std::move(vtkViewer.name);
+	gpuBytes = vtkViewer.gpuBytes.load();
+	lastShown = vtkViewer.lastShown;
+
+	vtkViewer.gpuBytes = 0;
+	vtkViewer.viewportWidth = vtkViewer.viewportHeight = 0;
+	vtkViewer.firstRender = true;
+	vtkViewer.renderedFrame = -1; // the moved-from viewer has no renderer left to check
 }
 
 void VtkViewer::init(){
@@ -161,25 +417,891 @@ void VtkViewer::render(){
 	render(ImGui::GetContentRegionAvail());
 }
 void VtkViewer::render(const ImVec2 size){
-	setViewportSize(size);
+	if (budgetFrame != ImGui::GetFrameCount()){
+		EnforceGpuMemoryBudget();
+	}
+	renderedFrame = ImGui::GetFrameCount();
+	lastShown = std::chrono::steady_clock::now();
+	applyCommands();
 
-	renderWindow->Render();
-	renderWindow->WaitForCompletion();
+	// Render target in pixels: HiDPI framebuffer scale, then the viewer's own resolution scale
+	const ImVec2 framebufferScale = ImGui::GetIO().DisplayFramebufferScale;
+	const unsigned int width = static_cast<unsigned int>(size.x * framebufferScale.x * currentRenderScale + 0.5f);
+	const unsigned int height = static_cast<unsigned int>(size.y * framebufferScale.y * currentRenderScale + 0.5f);
+	unsigned int texture = tex;
+	if (renderThread){
+		texture = renderThread->acquireFrame();
+	}
+	else{
+		renderToTexture(width, height);
+	}
 
 	ImGui::PushStyleVar(ImGuiStyleVar_WindowPadding, ImVec2(0,0));
 	ImGui::BeginChild("##Viewport", size, true, VtkViewer::NoScrollFlags());
-	ImGui::Image(reinterpret_cast<void*>(tex), ImGui::GetContentRegionAvail(), ImVec2(0, 1), ImVec2(1, 0));
-	processEvents();
+	ImGui::Image(reinterpret_cast<void*>(texture), ImGui::GetContentRegionAvail(), ImVec2(0, 1), ImVec2(1, 0));
+	imageMin = ImGui::GetItemRectMin();
+	imageMax = ImGui::GetItemRectMax();
+	if (firstFramePending && texture && renderCount > 0){
+		firstFrameTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - firstFrameStart).count();
+		firstFramePending = false;
+	}
+	if (orientationMarker){
+		// The camera belongs to the render thread when threaded, the marker keeps its last texture then
+		orientationMarker->draw(renderThread ? nullptr : renderer->GetActiveCamera(), ImGui::GetWindowDrawList(),
+			ImGui::GetItemRectMin(), ImGui::GetItemRectMax());
+	}
+	processEvents(width, height);
 	ImGui::EndChild();
 	ImGui::PopStyleVar();
+
+	if (renderThread){
+		// Picked up asynchronously; the frame shows up in a later ImGui frame
+		renderThread->requestFrame(width, height);
+	}
+	updateDynamicRenderScale();
+}
+
+void VtkViewer::renderToTexture(unsigned int width, unsigned int height){
+	applyCommands();
+	if (renderThread){
+		renderThread->requestFrame(width, height);
+		return;
+	}
+	applyMultiSamples();
+	const bool resized = firstRender || viewportWidth != width || viewportHeight != height;
+	setViewportSize(ImVec2(static_cast<float>(width), static_cast<float>(height)));
+	renderScene(resized);
+}
+
+void VtkViewer::keepResident(){
+	renderedFrame = ImGui::GetFrameCount();
+	lastShown = std::chrono::steady_clock::now();
+}
+
+void VtkViewer::startFirstFrameTimer(std::chrono::steady_clock::time_point start){
+	firstFrameStart = start;
+	firstFramePending = true;
+	firstFrameTime = 0.0;
+}
+
+void VtkViewer::reset(){
+	setThreaded(false);
+	setLayered(false);
+	setTransparencyMode(TransparencyMode::Unsorted);
+	maximumPeels = 4;
+	peelingTimeBudget = 16.0;
+	renderer->SetMaximumNumberOfPeels(maximumPeels);
+	untrackPipeline();
+	lodManager = nullptr;
+	orientationMarker = nullptr;
+
+	renderer->RemoveAllViewProps();
+	renderer->RemoveAllLights(); // the default light is recreated on the next render
+	renderer->SetActiveCamera(nullptr); // a new camera is created on demand
+	renderer->SetBackground(DEFAULT_BACKGROUND);
+	renderer->SetBackgroundAlpha(DEFAULT_ALPHA);
+	renderer->SetUseFXAA(false);
+	renderWindow->SetMultiSamples(0); // framebuffers are rebuilt on the next render if they were multisampled
+
+	smpBackend.clear();
+	smpThreads = 0;
+	renderScale = currentRenderScale = 1.0f;
+	dynamicRenderScale = false;
+	accumulationFrames = 0;
+	renderOnDemand = false;
+	animating = false;
+	redrawRequested = true;
+	lastRenderTime = 0.0;
+	framerate = 0.0;
+	renderCount = 0;
+	firstFramePending = false;
+	firstFrameTime = 0.0;
+	staticRenderCount = dynamicRenderCount = 0;
+	discardCommands();
+	lastCommandBatch = maxCommandBatch = 0;
+	commandLatency = maxCommandLatency = 0.0;
+	droppedCommands = 0;
+}
+
+bool VtkViewer::post(const std::function<void(VtkViewer&)>& command){
+	VtkSceneCommand sceneCommand;
+	sceneCommand.apply = command;
+	sceneCommand.posted = std::chrono::steady_clock::now();
+	if (!commands || !commands->push(std::move(sceneCommand))){
+		droppedCommands++;
+		return false;
+	}
+	glfwPostEmptyEvent(); // wakes a VtkFramePacer waiting for events, thread-safe
+	return true;
+}
+
+bool VtkViewer::postAddActor(const vtkSmartPointer<vtkProp>& actor){
+	return post([actor](VtkViewer& viewer){
+		viewer.addActor(actor);
+	});
+}
+
+bool VtkViewer::postRemoveActor(const vtkSmartPointer<vtkProp>& actor){
+	return post([actor](VtkViewer& viewer){
+		viewer.removeActor(actor);
+	});
+}
+
+bool VtkViewer::postInputData(const vtkSmartPointer<vtkAlgorithm>& algorithm, const vtkSmartPointer<vtkDataObject>& data){
+	return post([algorithm, data](VtkViewer&){
+		algorithm->SetInputDataObject(0, data);
+	});
+}
+
+bool VtkViewer::postProperty(const vtkSmartPointer<vtkActor>& actor, const std::function<void(vtkProperty*)>& change){
+	return post([actor, change](VtkViewer&){
+		change(actor->GetProperty());
+	});
+}
+
+size_t VtkViewer::getPendingCommands() const{
+	return commands ? commands->size() : 0;
+}
+
+bool VtkViewer::pick(double position[3]){
+	const ImVec2 mouse = ImGui::GetIO().MousePos;
+	const float imageWidth = imageMax.x - imageMin.x, imageHeight = imageMax.y - imageMin.y;
+	if (imageWidth <= 0.0f || imageHeight <= 0.0f || mouse.x < imageMin.x || mouse.y < imageMin.y || mouse.x >= imageMax.x || mouse.y >= imageMax.y){
+		return false;
+	}
+
+	// Display coordinates of the render target: pixels from the bottom left corner
+	std::unique_lock<std::mutex> lock = lockScene();
+	const double x = (mouse.x - imageMin.x) * viewportWidth / imageWidth;
+	const double y = (imageMax.y - mouse.y) * viewportHeight / imageHeight;
+	vtkSmartPointer<vtkCellPicker> picker = vtkSmartPointer<vtkCellPicker>::New();
+	picker->SetTolerance(0.005);
+	if (!picker->Pick(x, y, 0.0, renderer)){
+		return false;
+	}
+	picker->GetPickPosition(position);
+	return true;
+}
+
+void VtkViewer::applyCommands(){
+	if (!commands || commands->size() == 0){
+		return;
+	}
+	std::unique_lock<std::mutex> lock = lockScene();
+	applyingThread = std::this_thread::get_id();
+
+	// Only what is queued now: producers posting continuously can't keep the batch going
+	const size_t pending = commands->size();
+	const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	size_t applied = 0;
+	double totalLatency = 0.0, worstLatency = 0.0;
+	VtkSceneCommand command;
+	while (applied < pending && commands->pop(command)){
+		const double latency = std::chrono::duration<double, std::milli>(start - command.posted).count();
+		totalLatency += latency;
+		worstLatency = std::max(worstLatency, latency);
+		applied++;
+		try{
+			command.apply(*this);
+		}
+		catch (...){
+			applyingThread = std::thread::id();
+			throw;
+		}
+	}
+	command.apply = nullptr;
+	applyingThread = std::thread::id();
+
+	lastCommandBatch = applied;
+	maxCommandBatch = std::max(maxCommandBatch, applied);
+	commandLatency = applied > 0 ? totalLatency / applied : 0.0;
+	maxCommandLatency = worstLatency;
+	redrawRequested = true;
+}
+
+void VtkViewer::discardCommands(){
+	if (!commands){
+		return;
+	}
+	VtkSceneCommand command;
+	while (commands->pop(command)){
+	}
+}
+
+bool VtkViewer::renderScene(bool resized){
+	bool levelsChanged = false;
+	if (lodManager){
+		levelsChanged = lodManager->selectLevels(renderer, viewportWidth, viewportHeight);
+	}
+
+	updateDepthSort();
+
+	// The texture keeps the last frame, so an unchanged scene doesn't need to be rendered again
+	const bool changed = resized || levelsChanged || animating || redrawRequested || sceneMTime() > renderedMTime;
+	if (changed){
+		accumulatedFrames = 0;
+	}
+	const bool refining = accumulationFrames > 0 && accumulatedFrames < accumulationFrames;
+	const bool converged = accumulationFrames > 0 && !refining;
+	if ((!renderOnDemand && !converged) || changed || refining){
+		auto renderStart = std::chrono::steady_clock::now();
+		vtkCamera* camera = renderer->GetActiveCamera();
+		double windowCenter[2];
+		camera->GetWindowCenter(windowCenter);
+		if (accumulationFrames > 0 && accumulatedFrames > 0){
+			// One pixel is 2 / size in window center units
+			double jitter[2];
+			VtkTemporalAccumulator::JitterOffset(accumulatedFrames, jitter);
+			camera->SetWindowCenter(windowCenter[0] + 2.0 * jitter[0] / std::max(1u, viewportWidth.load()),
+				windowCenter[1] + 2.0 * jitter[1] / std::max(1u, viewportHeight.load()));
+		}
+		if (dynamicRenderer){
+			if (resized){
+				layerCacheValid = false; // holds the old size, never blit from it
+			}
+			// Taken after the jitter, which moves the static layer too
+			staticLayerDrawn = resized || levelsChanged || animating || redrawRequested || !layerCacheValid ||
+				rendererMTime(renderer) > staticRenderedMTime;
+			renderer->SetDraw(staticLayerDrawn);
+		}
+		// Pipelines update lazily inside Render(), so the SMP settings only need to be active around it.
+		// vtkSMPTools' configuration is process-wide and not thread-safe: it is only changed on the UI thread,
+		// a render thread renders with whatever is configured.
+		if (renderThread){
+			renderWindow->Render();
+		}
+		else{
+#ifdef IMGUI_VTK_SMP_LOCAL_SCOPE
+			vtkSMPTools::Config smpConfig;
+			smpConfig.MaxNumberOfThreads = smpThreads;
+			if (!smpBackend.empty()){
+				smpConfig.Backend = smpBackend;
+			}
+			vtkSMPTools::LocalScope(smpConfig, [this](){ renderWindow->Render(); });
+#else
+			// No scope before VTK 9.2: set, render, then restore the defaults so other viewers don't inherit them
+#ifdef IMGUI_VTK_SMP_RUNTIME_BACKEND
+			const std::string previousBackend = vtkSMPTools::GetBackend();
+			if (!smpBackend.empty()){
+				vtkSMPTools::SetBackend(smpBackend.c_str());
+			}
+#endif
+			vtkSMPTools::Initialize(smpThreads);
+			renderWindow->Render();
+			vtkSMPTools::Initialize(0);
+#ifdef IMGUI_VTK_SMP_RUNTIME_BACKEND
+			if (!smpBackend.empty()){
+				vtkSMPTools::SetBackend(previousBackend.c_str());
+			}
+#endif
+#endif
+		}
+		if (dynamicRenderer){
+			renderer->SetDraw(true);
+			staticRenderCount += staticLayerDrawn ? 1 : 0;
+			dynamicRenderCount++;
+		}
+		if (accumulationFrames > 0){
+			camera->SetWindowCenter(windowCenter[0], windowCenter[1]);
+			if (!accumulator){
+				accumulator.reset(new VtkTemporalAccumulator());
+			}
+			accumulator->accumulate(renderWindow, frameTexture, viewportWidth, viewportHeight, accumulatedFrames++);
+		}
+		renderWindow->WaitForCompletion();
+		lastRenderTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - renderStart).count();
+		if (lastRenderTime > 0.0){
+			// exponential moving average so the reported value doesn't flicker every frame
+			const double previous = framerate;
+			framerate = previous <= 0.0 ? 1000.0 / lastRenderTime : 0.9 * previous + 0.1 * (1000.0 / lastRenderTime);
+		}
+		renderCount++;
+		totalRenderCount++;
+		totalRenderTime += static_cast<long long>(lastRenderTime * 1000.0);
+		redrawRequested = false;
+		adaptPeelCount();
+		// Taken after Render(), which itself touches the camera (clipping range) and executes pipelines
+		renderedMTime = sceneMTime();
+		staticRenderedMTime = rendererMTime(renderer);
+		gpuBytes = estimateGpuBytes();
+		return true;
+	}
+	return false;
+}
+
+bool VtkViewer::prepareThreadedFrame(unsigned int width, unsigned int height, unsigned int texture){
+	// Same as setViewportSize(), except that the target texture belongs to the render thread's ring
+	applyMultiSamples();
+	const bool resized = firstRender || viewportWidth != width || viewportHeight != height;
+	if (resized){
+		viewportWidth = width;
+		viewportHeight = height;
+		int viewportSize[] = {static_cast<int>(width), static_cast<int>(height)};
+		renderWindow->InitializeFromCurrentContext();
+		renderWindow->SetSize(viewportSize);
+		interactor->SetSize(viewportSize);
+		firstRender = false;
+	}
+
+	frameTexture = texture;
+	auto vtkfbo = renderWindow->GetDisplayFramebuffer();
+	vtkfbo->Bind();
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+	vtkfbo->UnBind();
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	return resized;
+}
+
+void VtkViewer::applyMultiSamples(){
+	int samples = std::max(0, renderWindow->GetMultiSamples());
+	if (samples == multiSamples){
+		return;
+	}
+	if (samples > 1){
+		GLint maxSamples = 0;
+		glGetIntegerv(GL_MAX_SAMPLES, &maxSamples);
+		if (samples > maxSamples){
+			samples = maxSamples;
+			renderWindow->SetMultiSamples(samples);
+		}
+	}
+	// VTK picks the sample count of its render framebuffer when it creates it; resizes keep it, so new
+	// framebuffers are needed. The display framebuffer our texture is attached to stays single-sampled and
+	// receives the resolve.
+	releaseGraphicsResources();
+	multiSamples = samples;
+}
+
+void VtkViewer::releaseGraphicsResources(){
+	if (accumulator){
+		accumulator->releaseGraphicsResources(renderWindow);
+	}
+	accumulatedFrames = 0;
+	if (layerCache){
+		layerCache->ReleaseGraphicsResources(renderWindow);
+		layerCache = nullptr;
+	}
+	layerCacheValid = false;
+	if (!firstRender){
+		renderWindow->ReleaseGraphicsResources(renderWindow);
+	}
+	firstRender = true;
+}
+
+size_t VtkViewer::estimateGpuBytes(){
+	const size_t pixels = static_cast<size_t>(viewportWidth) * viewportHeight;
+	const size_t samples = static_cast<size_t>(std::max(1, renderWindow->GetMultiSamples()));
+	// Our texture, then color + depth of VTK's render framebuffer (per sample) and display framebuffer
+	size_t bytes = pixels * 4 + pixels * 8 * samples + pixels * 8;
+	if (accumulator && accumulationFrames > 0){
+		bytes += pixels * 8; // RGBA16F running average
+	}
+	if (layerCache && dynamicRenderer){
+		bytes += pixels * 8 * samples; // static layer color + depth
+	}
+
+	// Vertex buffers and textures hold roughly what the mappers' inputs hold on the CPU
+	vtkPropCollection* props = renderer->GetViewProps();
+	vtkProp* prop;
+	vtkCollectionSimpleIterator sit;
+	for (props->InitTraversal(sit); (prop = props->GetNextProp(sit));){
+		vtkAlgorithm* mapper = propMapper(prop);
+		if (mapper && mapper->GetNumberOfInputPorts() > 0 && mapper->GetNumberOfInputConnections(0) > 0){
+			if (vtkDataObject* input = mapper->GetInputDataObject(0, 0)){
+				bytes += static_cast<size_t>(input->GetActualMemorySize()) * 1024;
+			}
+		}
+		vtkActor* actor = vtkActor::SafeDownCast(prop);
+		if (actor && actor->GetTexture() && actor->GetTexture()->GetInput()){
+			bytes += static_cast<size_t>(actor->GetTexture()->GetInput()->GetActualMemorySize()) * 1024;
+		}
+	}
+	return bytes;
+}
+
+void VtkViewer::evictGraphicsResources(){
+	releaseGraphicsResources();
+	glDeleteTextures(1, &tex);
+	tex = 0;
+	gpuBytes = 0;
+	redrawRequested = true;
+}
+
+size_t VtkViewer::GetTotalGpuBytes(){
+	size_t total = 0;
+	for (VtkViewer* viewer : instances){
+		total += viewer->gpuBytes;
+	}
+	return total;
+}
+
+void VtkViewer::EnforceGpuMemoryBudget(){
+	const int frame = ImGui::GetFrameCount();
+	budgetFrame = frame;
+	auto now = std::chrono::steady_clock::now();
+
+	// Viewers shown in the previous frame are probably shown in this one too; threaded viewers own their context
+	std::vector<VtkViewer*> candidates;
+	size_t total = 0;
+	for (VtkViewer* viewer : instances){
+		total += viewer->gpuBytes;
+		if (viewer->gpuBytes > 0 && !viewer->renderThread && viewer->renderedFrame < frame - 1){
+			candidates.push_back(viewer);
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [](const VtkViewer* a, const VtkViewer* b){
+		return a->lastShown < b->lastShown;
+	});
+
+	for (VtkViewer* viewer : candidates){
+		const double idle = std::chrono::duration<double>(now - viewer->lastShown).count();
+		const bool overBudget = gpuMemoryBudget > 0 && total > gpuMemoryBudget;
+		const bool expired = gpuEvictionDelay > 0.0 && idle > gpuEvictionDelay;
+		if (overBudget || expired){
+			total -= viewer->gpuBytes;
+			viewer->evictGraphicsResources();
+		}
+	}
+}
+
+void VtkViewer::ShowGpuMemoryWindow(bool* open){
+	if (!ImGui::Begin("VtkViewer GPU memory", open)){
+		ImGui::End();
+		return;
+	}
+
+	int budgetMB = static_cast<int>(gpuMemoryBudget / (1024 * 1024));
+	if (ImGui::DragInt("Budget (MB, 0 = unlimited)", &budgetMB, 1.0f, 0, 1 << 16)){
+		gpuMemoryBudget = static_cast<size_t>(std::max(0, budgetMB)) * 1024 * 1024;
+	}
+	float delay = static_cast<float>(gpuEvictionDelay);
+	if (ImGui::DragFloat("Evict after (s, 0 = never)", &delay, 1.0f, 0.0f, 3600.0f, "%.0f")){
+		gpuEvictionDelay = std::max(0.0f, delay);
+	}
+	ImGui::Text("Resident: %.2f MB in %d viewers", GetTotalGpuBytes() / (1024.0 * 1024.0), static_cast<int>(instances.size()));
+
+	if (ImGui::BeginTable("##gpuMemory", 4, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)){
+		ImGui::TableSetupColumn("Viewer");
+		ImGui::TableSetupColumn("Size");
+		ImGui::TableSetupColumn("Resident (MB)");
+		ImGui::TableSetupColumn("Last shown");
+		ImGui::TableHeadersRow();
+		auto now = std::chrono::steady_clock::now();
+		for (VtkViewer* viewer : instances){
+			ImGui::TableNextRow();
+			ImGui::TableNextColumn(); ImGui::TextUnformatted(viewer->name.c_str());
+			ImGui::TableNextColumn(); ImGui::Text("%u x %u", viewer->viewportWidth.load(), viewer->viewportHeight.load());
+			ImGui::TableNextColumn();
+			if (viewer->gpuBytes > 0){
+				ImGui::Text("%.2f", viewer->gpuBytes / (1024.0 * 1024.0));
+			}
+			else{
+				ImGui::TextUnformatted("evicted");
+			}
+			ImGui::TableNextColumn();
+			ImGui::Text("%.0f s ago%s", std::chrono::duration<double>(now - viewer->lastShown).count(), viewer->renderThread ? " (threaded)" : "");
+		}
+		ImGui::EndTable();
+	}
+	ImGui::End();
+}
+
+void VtkViewer::setRenderScale(float scale){
+	renderScale = clampRenderScale(scale, MinRenderScale, MaxRenderScale);
+	if (!dynamicRenderScale){
+		currentRenderScale = renderScale;
+	}
+}
+
+void VtkViewer::setDynamicRenderScale(bool enabled, double targetFrameTime, float minScale, float maxScale){
+	dynamicRenderScale = enabled;
+	this->targetFrameTime = std::max(1.0, targetFrameTime);
+	minRenderScale = clampRenderScale(std::min(minScale, maxScale), MinRenderScale, MaxRenderScale);
+	maxRenderScale = clampRenderScale(std::max(minScale, maxScale), MinRenderScale, MaxRenderScale);
+	currentRenderScale = enabled ? clampRenderScale(currentRenderScale, minRenderScale, maxRenderScale) : renderScale;
+}
+
+void VtkViewer::updateDynamicRenderScale(){
+	if (!dynamicRenderScale){
+		return;
+	}
+	// Only react to renders that actually happened since the last update
+	const unsigned long frames = renderThread ? renderThread->getPublishedFrames() : renderCount.load();
+	const double frameTime = lastRenderTime;
+	if (frames == scaledFrameCount || frameTime <= 0.0){
+		return;
+	}
+	scaledFrameCount = frames;
+
+	// Render time follows the pixel count, i.e. the square of the scale. A dead band and coarse steps keep the
+	// texture from being reallocated on every frame.
+	if (frameTime > targetFrameTime * 1.1 || frameTime < targetFrameTime * 0.8){
+		const float ideal = currentRenderScale * static_cast<float>(std::sqrt(targetFrameTime / frameTime));
+		float scale = std::round((currentRenderScale + 0.5f * (ideal - currentRenderScale)) * 16.0f) / 16.0f;
+		if (scale == currentRenderScale){
+			scale += ideal > currentRenderScale ? 1.0f / 16.0f : -1.0f / 16.0f; // damping alone would stall within one step
+		}
+		currentRenderScale = clampRenderScale(scale, minRenderScale, maxRenderScale);
+	}
+}
+
+void VtkViewer::setLayered(bool layered){
+	if (layered == isLayered()){
+		return;
+	}
+	std::unique_lock<std::mutex> lock = lockScene();
+	if (layered){
+		dynamicRenderer = vtkSmartPointer<vtkRenderer>::New();
+		dynamicRenderer->SetLayer(1);
+		dynamicRenderer->SetActiveCamera(renderer->GetActiveCamera());
+		dynamicRenderer->InteractiveOff(); // the interactor style keeps driving the static layer's camera
+		dynamicRenderer->PreserveColorBufferOn();
+		dynamicRenderer->PreserveDepthBufferOn(); // dynamic props are depth tested against the static scene
+		observeDynamicLayer();
+		renderWindow->SetNumberOfLayers(2);
+		renderWindow->AddRenderer(dynamicRenderer);
+	}
+	else{
+		renderWindow->RemoveRenderer(dynamicRenderer);
+		renderWindow->SetNumberOfLayers(1);
+		dynamicRenderer = nullptr;
+	}
+	layerCacheValid = false;
+	redrawRequested = true;
+}
+
+void VtkViewer::addDynamicActor(const vtkSmartPointer<vtkProp>& actor){
+	std::unique_lock<std::mutex> lock = lockScene();
+	if (!dynamicRenderer){
+		throw VtkViewerError("VtkViewer isn't layered, call setLayered(true) before adding dynamic actors");
+	}
+	dynamicRenderer->AddActor(actor);
+}
+
+void VtkViewer::removeDynamicActor(const vtkSmartPointer<vtkProp>& actor){
+	std::unique_lock<std::mutex> lock = lockScene();
+	if (!dynamicRenderer){
+		throw VtkViewerError("VtkViewer isn't layered");
+	}
+	dynamicRenderer->RemoveActor(actor);
+}
+
+void VtkViewer::observeDynamicLayer(){
+	vtkSmartPointer<vtkCallbackCommand> startCallback = vtkSmartPointer<vtkCallbackCommand>::New();
+	startCallback->SetCallback(&dynamicLayerStartCallbackFn);
+	startCallback->SetClientData(this);
+	dynamicStartTag = dynamicRenderer->AddObserver(vtkCommand::StartEvent, startCallback);
+}
+
+void VtkViewer::blitStaticLayer(){
+	// Runs when the dynamic layer starts rendering, with VTK's render framebuffer bound: right after the static
+	// layer was drawn (cache it) or instead of drawing it (restore it)
+	vtkOpenGLFramebufferObject* target = renderWindow->GetRenderFramebuffer();
+	const int samples = std::max(1, target->GetMultiSamples());
+	if (!layerCache){
+		layerCache = vtkSmartPointer<vtkOpenGLFramebufferObject>::New();
+		layerCache->SetContext(renderWindow);
+	}
+	int cacheSize[2];
+	layerCache->GetLastSize(cacheSize);
+	// Checked on every call: a cache of another size or sample count can never be blitted from
+	if (cacheSize[0] != static_cast<int>(viewportWidth) || cacheSize[1] != static_cast<int>(viewportHeight) ||
+		std::max(1, layerCache->GetMultiSamples()) != samples){
+		// Same formats as VTK's own render framebuffer, blits between them need them to match
+		layerCache->ReleaseGraphicsResources(renderWindow);
+		layerCache->SetContext(renderWindow);
+		layerCache->PopulateFramebuffer(viewportWidth, viewportHeight, true, 1, VTK_UNSIGNED_CHAR, true, 32, samples > 1 ? samples : 0);
+		layerCacheValid = false;
+	}
+	if (!staticLayerDrawn && !layerCacheValid){
+		return;
+	}
+
+	vtkOpenGLState* state = renderWindow->GetState();
+	state->PushFramebufferBindings();
+	vtkOpenGLFramebufferObject* read = staticLayerDrawn ? target : layerCache.GetPointer();
+	vtkOpenGLFramebufferObject* draw = staticLayerDrawn ? layerCache.GetPointer() : target;
+	read->Bind(GL_READ_FRAMEBUFFER);
+	read->ActivateReadBuffer(0);
+	draw->Bind(GL_DRAW_FRAMEBUFFER);
+	draw->ActivateDrawBuffer(0);
+	state->vtkglBlitFramebuffer(0, 0, viewportWidth, viewportHeight, 0, 0, viewportWidth, viewportHeight,
+		GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+	state->PopFramebufferBindings();
+	layerCacheValid = true;
+}
+
+void VtkViewer::setMultiSamples(int samples){
+	std::unique_lock<std::mutex> lock = lockScene();
+	renderWindow->SetMultiSamples(std::max(0, samples));
+}
+
+void VtkViewer::setFXAA(bool enabled){
+	std::unique_lock<std::mutex> lock = lockScene();
+	renderer->SetUseFXAA(enabled);
+}
+
+void VtkViewer::setAccumulation(int frames){
+	std::unique_lock<std::mutex> lock = lockScene();
+	accumulationFrames = std::max(0, frames);
+	accumulatedFrames = 0;
+}
+
+void VtkViewer::setTransparencyMode(TransparencyMode mode){
+	std::unique_lock<std::mutex> lock = lockScene();
+	transparencyMode = mode;
+
+	const bool peeling = mode == TransparencyMode::DepthPeeling || mode == TransparencyMode::AdaptivePeeling;
+	if (peeling){
+		renderWindow->SetAlphaBitPlanes(1);
+	}
+	renderer->SetUseDepthPeeling(peeling);
+#if VTK_MAJOR_VERSION >= 9
+	// On by default: Unsorted would otherwise composite with VTK's own OIT pass, and it would undo DepthSort's order
+	renderer->SetUseOIT(mode == TransparencyMode::WeightedBlended);
+#endif
+	renderer->SetMaximumNumberOfPeels(maximumPeels);
+	// A small occlusion ratio ends peeling once hardly any pixel changes, usually before the last peel
+	renderer->SetOcclusionRatio(mode == TransparencyMode::AdaptivePeeling ? 0.001 : 0.0);
+
+	if (mode == TransparencyMode::WeightedBlended){
+		if (!translucentPass){
+			// The default render steps, with the translucent step wrapped in the OIT pass
+			vtkSmartPointer<vtkRenderStepsPass> steps = vtkSmartPointer<vtkRenderStepsPass>::New();
+			vtkSmartPointer<vtkOrderIndependentTranslucentPass> oit = vtkSmartPointer<vtkOrderIndependentTranslucentPass>::New();
+			oit->SetTranslucentPass(steps->GetTranslucentPass());
+			steps->SetTranslucentPass(oit);
+			translucentPass = steps;
+		}
+		renderer->SetPass(translucentPass);
+	}
+	else if (renderer->GetPass() == translucentPass.GetPointer()){
+		renderer->SetPass(nullptr);
+	}
+
+	if (mode != TransparencyMode::DepthSort){
+		// Mappers get their own inputs back
+		for (auto& sorted : depthSortedActors){
+			vtkActor* actor = sorted.actor;
+			if (actor && actor->GetMapper() && actor->GetMapper()->GetInputConnection(0, 0) == sorted.sorter->GetOutputPort()){
+				actor->GetMapper()->SetInputConnection(sorted.input);
+			}
+			untrackAlgorithm(sorted.sorter);
+		}
+		depthSortedActors.clear();
+	}
+	redrawRequested = true;
+}
+
+void VtkViewer::setMaximumPeels(int peels){
+	std::unique_lock<std::mutex> lock = lockScene();
+	maximumPeels = std::max(1, peels);
+	renderer->SetMaximumNumberOfPeels(maximumPeels);
+}
+
+void VtkViewer::setPeelingTimeBudget(double ms){
+	std::unique_lock<std::mutex> lock = lockScene(); // read by adaptPeelCount() on the render thread
+	peelingTimeBudget = std::max(0.1, ms);
+}
+
+int VtkViewer::getPeelCount() const{
+	return renderer->GetMaximumNumberOfPeels();
+}
+
+void VtkViewer::updateDepthSort(){
+	if (transparencyMode != TransparencyMode::DepthSort){
+		return;
+	}
+	depthSortedActors.erase(std::remove_if(depthSortedActors.begin(), depthSortedActors.end(), [this](const DepthSortedActor& sorted){
+		const bool removed = !sorted.actor || !sorted.actor->GetMapper() || sorted.actor->GetMapper()->GetInputConnection(0, 0) != sorted.sorter->GetOutputPort();
+		if (removed){
+			untrackAlgorithm(sorted.sorter);
+		}
+		return removed;
+	}), depthSortedActors.end());
+
+	// Actors added or made translucent since the last render
+	vtkPropCollection* props = renderer->GetViewProps();
+	vtkProp* prop;
+	vtkCollectionSimpleIterator sit;
+	for (props->InitTraversal(sit); (prop = props->GetNextProp(sit));){
+		vtkActor* actor = vtkActor::SafeDownCast(prop);
+		vtkPolyDataMapper* mapper = actor ? vtkPolyDataMapper::SafeDownCast(actor->GetMapper()) : nullptr;
+		if (!mapper || actor->GetProperty()->GetOpacity() >= 1.0 || mapper->GetNumberOfInputConnections(0) == 0){
+			continue;
+		}
+		bool sorted = false;
+		for (auto& entry : depthSortedActors){
+			sorted = sorted || entry.actor.GetPointer() == actor;
+		}
+		if (sorted){
+			continue;
+		}
+
+		// Re-sorts whenever the camera or the actor's transform changes (both are part of the sorter's MTime)
+		DepthSortedActor entry;
+		entry.actor = actor;
+		entry.input = mapper->GetInputConnection(0, 0);
+		entry.sorter = vtkSmartPointer<vtkDepthSortPolyData>::New();
+		entry.sorter->SetInputConnection(entry.input);
+		entry.sorter->SetDirectionToBackToFront();
+		entry.sorter->SetCamera(renderer->GetActiveCamera());
+		entry.sorter->SetProp3D(actor);
+		mapper->SetInputConnection(entry.sorter->GetOutputPort());
+		trackAlgorithm(entry.sorter);
+		depthSortedActors.push_back(entry);
+	}
+}
+
+void VtkViewer::adaptPeelCount(){
+	if (transparencyMode != TransparencyMode::AdaptivePeeling || lastRenderTime <= 0.0){
+		return;
+	}
+	// One peel at a time, the render time of a scene without translucent geometry doesn't depend on it anyway
+	const int peels = renderer->GetMaximumNumberOfPeels();
+	if (lastRenderTime > peelingTimeBudget && peels > 1){
+		renderer->SetMaximumNumberOfPeels(peels - 1);
+	}
+	else if (lastRenderTime < peelingTimeBudget * 0.7 && peels < maximumPeels){
+		renderer->SetMaximumNumberOfPeels(peels + 1);
+	}
+}
+
+int VtkViewer::getMultiSamples() const{
+	return renderWindow->GetMultiSamples();
+}
+
+bool VtkViewer::getFXAA() const{
+	return renderer->GetUseFXAA();
+}
+
+void VtkViewer::setThreaded(bool threaded){
+	if (threaded == isThreaded()){
+		return;
+	}
+	// FBOs and VAOs can't be shared between contexts, VTK rebuilds them on the context that renders next
+	if (threaded){
+		releaseGraphicsResources();
+		renderThread.reset(new VtkRenderThread(this));
+	}
+	else{
+		renderThread.reset(); // releases on its own context before exiting
+	}
+	redrawRequested = true;
+}
+
+std::unique_lock<std::mutex> VtkViewer::lockScene(){
+	if (!renderThread || applyingThread.load() == std::this_thread::get_id()){
+		return std::unique_lock<std::mutex>();
+	}
+	return std::unique_lock<std::mutex>(sceneMutex);
+}
+
+bool VtkViewer::needsRedraw(){
+	if (getPendingCommands() > 0){
+		return true; // applied by the next render()
+	}
+	if (renderThread){
+		// The scene belongs to the render thread, only its published frames matter here
+		return renderThread->hasNewFrame();
+	}
+	if (firstRender || animating || redrawRequested || sceneMTime() > renderedMTime){
+		return true;
+	}
+	if (accumulationFrames > 0){
+		return accumulatedFrames < accumulationFrames; // converged views stop rendering even without render-on-demand
+	}
+	return !renderOnDemand;
+}
+
+bool VtkViewer::hasPendingWork() const{
+	return lodManager && lodManager->getPendingJobs() > 0;
+}
+
+vtkMTimeType VtkViewer::sceneMTime(){
+	if (!renderer){
+		return 0;
+	}
+	vtkMTimeType mtime = rendererMTime(renderer);
+	if (dynamicRenderer){
+		mtime = std::max(mtime, rendererMTime(dynamicRenderer));
+	}
+	return mtime;
+}
+
+vtkMTimeType VtkViewer::rendererMTime(vtkRenderer* layer){
+	vtkMTimeType mtime = std::max(layer->GetMTime(), layer->GetViewProps()->GetMTime());
+	mtime = std::max(mtime, layer->GetActiveCamera()->GetMTime());
+
+	vtkLightCollection* lights = layer->GetLights();
+	mtime = std::max(mtime, lights->GetMTime());
+	vtkLight* light;
+	vtkCollectionSimpleIterator lit;
+	for (lights->InitTraversal(lit); (light = lights->GetNextLight(lit));){
+		mtime = std::max(mtime, light->GetMTime());
+	}
+
+	// Props include their properties and user transforms, mappers include their lookup tables
+	vtkPropCollection* props = layer->GetViewProps();
+	vtkProp* prop;
+	vtkCollectionSimpleIterator sit;
+	for (props->InitTraversal(sit); (prop = props->GetNextProp(sit));){
+		if (!prop->GetVisibility()){
+			continue;
+		}
+		mtime = std::max(mtime, prop->GetMTime());
+		mtime = std::max(mtime, pipelineMTime(propMapper(prop)));
+	}
+	return mtime;
+}
+
+bool VtkViewer::AnyNeedsRedraw(){
+	const int frame = ImGui::GetFrameCount();
+	for (VtkViewer* viewer : instances){
+		// Viewers that weren't shown this frame (closed windows, hidden tabs) don't keep the loop busy
+		if (viewer->renderedFrame == frame && viewer->needsRedraw()){
+			return true;
+		}
+	}
+	return false;
+}
+
+bool VtkViewer::AnyHasPendingWork(){
+	for (VtkViewer* viewer : instances){
+		if (viewer->hasPendingWork()){
+			return true;
+		}
+	}
+	return false;
+}
+
+bool VtkViewer::IsSoftwareRenderer(){
+	const char* glRenderer = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+	if (!glRenderer){
+		return false;
+	}
+
+	static const char* softwareRenderers[] = {
+		"llvmpipe", "softpipe", "SwiftShader", "Software Rasterizer", "Microsoft Basic Render", "GDI Generic"
+	};
+	for (const char* name : softwareRenderers){
+		if (strstr(glRenderer, name)){
+			return true;
+		}
+	}
+	return false;
 }
 
 void VtkViewer::addActor(const vtkSmartPointer<vtkProp>& actor){
+	std::unique_lock<std::mutex> lock = lockScene();
 	renderer->AddActor(actor);
 	renderer->ResetCamera();
+	trackPipeline();
 }
 
 void VtkViewer::addActors(const vtkSmartPointer<vtkPropCollection>& actors){
+	std::unique_lock<std::mutex> lock = lockScene();
 	actors->InitTraversal();
 	vtkProp* actor;
 	vtkCollectionSimpleIterator sit;
@@ -187,12 +1309,159 @@ void VtkViewer::addActors(const vtkSmartPointer<vtkPropCollection>& actors){
 		renderer->AddActor(actor);
 		renderer->ResetCamera();
 	}
+	trackPipeline();
 }
 
 void VtkViewer::removeActor(const vtkSmartPointer<vtkProp>& actor){
+	std::unique_lock<std::mutex> lock = lockScene();
 	renderer->RemoveActor(actor);
 }
 
+void VtkViewer::setTransforms(const std::vector<vtkSmartPointer<vtkProp3D>>& props, const std::vector<float>& positions,
+	const std::vector<float>& orientations){
+	const size_t count = props.size();
+	if (positions.size() != count * 3 || orientations.size() != count * 4){
+		throw VtkViewerError("setTransforms needs 3 position and 4 orientation components per prop");
+	}
+	transformBuffer.resize(count * 16);
+
+	// One branch-free pass over the packed arrays: rotation from the quaternion, translation in the last column
+	double* matrices = transformBuffer.data();
+	for (size_t i = 0; i < count; i++){
+		const float* p = positions.data() + i * 3;
+		const float* q = orientations.data() + i * 4;
+		const double w = q[0], x = q[1], y = q[2], z = q[3];
+		double* m = matrices + i * 16;
+		m[0] = 1.0 - 2.0 * (y * y + z * z); m[1] = 2.0 * (x * y - w * z); m[2] = 2.0 * (x * z + w * y); m[3] = p[0];
+		m[4] = 2.0 * (x * y + w * z); m[5] = 1.0 - 2.0 * (x * x + z * z); m[6] = 2.0 * (y * z - w * x); m[7] = p[1];
+		m[8] = 2.0 * (x * z - w * y); m[9] = 2.0 * (y * z + w * x); m[10] = 1.0 - 2.0 * (x * x + y * y); m[11] = p[2];
+		m[12] = 0.0; m[13] = 0.0; m[14] = 0.0; m[15] = 1.0;
+	}
+
+	std::unique_lock<std::mutex> lock = lockScene();
+	for (size_t i = 0; i < count; i++){
+		vtkProp3D* prop = props[i];
+		vtkMatrix4x4* matrix = prop->GetUserMatrix();
+		if (!matrix){
+			vtkSmartPointer<vtkMatrix4x4> userMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+			prop->SetUserMatrix(userMatrix);
+			matrix = userMatrix;
+		}
+		matrix->DeepCopy(matrices + i * 16); // one Modified() per prop; VTK rebuilds the prop matrix from it when drawn
+	}
+	redrawRequested = true;
+}
+
+std::shared_ptr<VtkInstancedGlyphs> VtkViewer::addInstances(vtkAlgorithmOutput* source,
+	const std::vector<VtkInstanceTransform>& transforms, const std::vector<unsigned char>& colors){
+	if (!colors.empty() && colors.size() != transforms.size() * 4){
+		throw VtkViewerError("addInstances needs 4 color components per transform");
+	}
+	std::shared_ptr<VtkInstancedGlyphs> instances = std::make_shared<VtkInstancedGlyphs>(source);
+	instances->resize(static_cast<vtkIdType>(transforms.size()));
+	static const unsigned char white[4] = {255, 255, 255, 255};
+	for (size_t i = 0; i < transforms.size(); i++){
+		instances->setInstance(static_cast<vtkIdType>(i), transforms[i], colors.empty() ? white : &colors[i * 4]);
+	}
+	instances->modified();
+	addActor(instances->getActor());
+	return instances;
+}
+
+void VtkViewer::setSMPBackend(const std::string& backend){
+	smpBackend = backend;
+}
+
+void VtkViewer::setSMPThreads(int threads){
+	smpThreads = threads < 0 ? 0 : threads;
+}
+
+void VtkViewer::trackAlgorithm(vtkAlgorithm* algorithm){
+	if (!algorithm){
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(filterMutex);
+		for (auto& execution : filterExecutions){
+			if (execution->algorithm.GetPointer() == algorithm){
+				return; // already instrumented, and so is everything upstream of it
+			}
+		}
+	}
+
+	auto execution = std::make_shared<VtkFilterExecution>();
+	execution->className = algorithm->GetClassName();
+	execution->algorithm = algorithm;
+	execution->smpCapable = isSMPCapable(algorithm);
+	execution->executions = 0;
+	execution->lastExecutionTime = 0.0;
+	execution->threads = 0;
+	execution->ranParallel = false;
+
+	vtkSmartPointer<vtkCallbackCommand> startCallback = vtkSmartPointer<vtkCallbackCommand>::New();
+	startCallback->SetCallback(&filterStartCallbackFn);
+	startCallback->SetClientData(execution.get());
+	execution->startTag = algorithm->AddObserver(vtkCommand::StartEvent, startCallback);
+
+	vtkSmartPointer<vtkCallbackCommand> endCallback = vtkSmartPointer<vtkCallbackCommand>::New();
+	endCallback->SetCallback(&filterEndCallbackFn);
+	endCallback->SetClientData(execution.get());
+	execution->endTag = algorithm->AddObserver(vtkCommand::EndEvent, endCallback);
+
+	{
+		std::lock_guard<std::mutex> lock(filterMutex);
+		filterExecutions.push_back(execution);
+	}
+
+	for (int port = 0; port < algorithm->GetNumberOfInputPorts(); port++){
+		for (int connection = 0; connection < algorithm->GetNumberOfInputConnections(port); connection++){
+			trackAlgorithm(algorithm->GetInputAlgorithm(port, connection));
+		}
+	}
+}
+
+void VtkViewer::untrackAlgorithm(vtkAlgorithm* algorithm){
+	std::lock_guard<std::mutex> lock(filterMutex);
+	for (auto it = filterExecutions.begin(); it != filterExecutions.end(); ++it){
+		if ((*it)->algorithm.GetPointer() == algorithm){
+			algorithm->RemoveObserver((*it)->startTag);
+			algorithm->RemoveObserver((*it)->endTag);
+			filterExecutions.erase(it);
+			return;
+		}
+	}
+}
+
+void VtkViewer::trackPipeline(){
+	vtkPropCollection* props = renderer->GetViewProps();
+	vtkProp* prop;
+	vtkCollectionSimpleIterator sit;
+	for (props->InitTraversal(sit); (prop = props->GetNextProp(sit));){
+		trackAlgorithm(propMapper(prop));
+	}
+}
+
+void VtkViewer::untrackPipeline(){
+	std::lock_guard<std::mutex> lock(filterMutex);
+	for (auto& execution : filterExecutions){
+		// Observers point at the execution records
+		if (execution->algorithm){
+			execution->algorithm->RemoveObserver(execution->startTag);
+			execution->algorithm->RemoveObserver(execution->endTag);
+		}
+	}
+	filterExecutions.clear();
+}
+
+std::vector<VtkFilterExecution> VtkViewer::getFilterExecutions() const{
+	std::lock_guard<std::mutex> lock(filterMutex);
+	std::vector<VtkFilterExecution> executions;
+	for (const auto& execution : filterExecutions){
+		executions.push_back(*execution);
+	}
+	return executions;
+}
+
 void VtkViewer::setViewportSize(const ImVec2 newSize){
 	if (((viewportWidth == newSize.x && viewportHeight == newSize.y) || viewportWidth <= 0 || viewportHeight <= 0) && !firstRender){
 		return;
@@ -220,6 +1489,7 @@ void VtkViewer::setViewportSize(const ImVec2 newSize){
 	renderWindow->SetSize(viewportSize);
 	interactor->SetSize(viewportSize);
 
+	frameTexture = tex;
 	auto vtkfbo = renderWindow->GetDisplayFramebuffer();
 	vtkfbo->Bind();
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
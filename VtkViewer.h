@@ -2,7 +2,14 @@
 
 #include <iostream>
 #include <string>
+#include <thread>
 #include <exception>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <functional>
 
 #include "imgui.h"
 
@@ -17,12 +24,28 @@
 #include <vtkGenericRenderWindowInteractor.h>
 #include <vtkInteractorStyleTrackballCamera.h>
 #include <vtkRenderer.h>
+#include <vtkAlgorithm.h>
+#include <vtkWeakPointer.h>
+#include <vtkRenderPass.h>
+#include <vtkDepthSortPolyData.h>
+#include <vtkAlgorithmOutput.h>
+#include <vtkProp3D.h>
+
+#include "LockFreeQueue.h"
 
 // RGB Color in range [0.0, 1.0]
 #define DEFAULT_BACKGROUND 0.39, 0.39, 0.39
 // Alpha value in range [0.0, 1.0] where 1 = opaque
 #define DEFAULT_ALPHA 1
 
+class VtkLodManager;
+class VtkRenderThread;
+class VtkOrientationMarker;
+class VtkTemporalAccumulator;
+class VtkInstancedGlyphs;
+struct VtkInstanceTransform;
+struct VtkViewerEvent;
+
 class VtkViewerError : public std::runtime_error {
 public:
 	explicit VtkViewerError(const std::string& message) throw() : std::runtime_error(message) {}
@@ -33,39 +56,316 @@ public:
 	}
 };
 
+// Execution record of one pipeline filter feeding a VtkViewer (see VtkViewer::trackPipeline)
+struct VtkFilterExecution {
+	std::string className;
+	vtkWeakPointer<vtkAlgorithm> algorithm;
+	unsigned long startTag, endTag;
+	bool smpCapable; // RequestData is implemented with vtkSMPTools, guessed from the class (a list of known filters)
+	int executions;
+	double lastExecutionTime; // ms
+	int threads; // SMP threads available during the last execution
+	std::string backend; // SMP backend active during the last execution
+	bool ranParallel; // a guess, not observed: smpCapable, more than one thread and a parallel backend
+	std::chrono::steady_clock::time_point start;
+};
+
+class VtkViewer;
+
+// Scene change posted from any thread, see VtkViewer::post()
+struct VtkSceneCommand {
+	std::function<void(VtkViewer&)> apply;
+	std::chrono::steady_clock::time_point posted;
+};
+
 class VtkViewer {
+public:
+	// How translucent geometry is composited, see setTransparencyMode()
+	enum class TransparencyMode {
+		Unsorted, // blended in draw order (VTK 9 OIT turned off), cheapest, wrong where surfaces overlap
+		DepthPeeling, // (dual) depth peeling, exact up to the peel count
+		AdaptivePeeling, // depth peeling with the peel count adjusted to the peeling time budget
+		WeightedBlended, // weighted blended OIT: one pass, approximate colors
+		DepthSort // polygons of translucent actors sorted back to front on the CPU whenever the camera moves
+	};
 private:
 	static void isCurrentCallbackFn(vtkObject* caller, long unsigned int eventId, void* clientData, void* callData);
-	void processEvents();
+	static void filterStartCallbackFn(vtkObject* caller, long unsigned int eventId, void* clientData, void* callData);
+	static void filterEndCallbackFn(vtkObject* caller, long unsigned int eventId, void* clientData, void* callData);
+	static void dynamicLayerStartCallbackFn(vtkObject* caller, long unsigned int eventId, void* clientData, void* callData);
+	void processEvents(unsigned int width, unsigned int height);
+	void trackAlgorithm(vtkAlgorithm* algorithm);
+	void untrackAlgorithm(vtkAlgorithm* algorithm); // that one only, not its inputs
+	vtkMTimeType sceneMTime();
+	vtkMTimeType rendererMTime(vtkRenderer* layer);
+	bool renderScene(bool resized);
+	// Render thread side (see VtkRenderThread)
+	bool prepareThreadedFrame(unsigned int width, unsigned int height, unsigned int texture);
+	void replayEvent(const VtkViewerEvent& event);
+	void releaseGraphicsResources();
+	size_t estimateGpuBytes();
+	void updateDynamicRenderScale();
+	void applyMultiSamples();
+	void updateDepthSort();
+	void adaptPeelCount();
+	void observeDynamicLayer();
+	void blitStaticLayer();
+	void evictGraphicsResources();
+	void applyCommands();
+	void discardCommands();
+	void untrackPipeline();
+	void releaseAll();
+	void takeFrom(VtkViewer& vtkViewer);
 private:
 	vtkSmartPointer<vtkGenericOpenGLRenderWindow> renderWindow;
 	vtkSmartPointer<vtkGenericRenderWindowInteractor> interactor;
 	vtkSmartPointer<vtkInteractorStyleTrackballCamera> interactorStyle;
 	vtkSmartPointer<vtkRenderer> renderer;
 private:
-	unsigned int viewportWidth, viewportHeight;
+	std::atomic<unsigned int> viewportWidth, viewportHeight; // set by the render thread while threaded, read by pick()
+	ImVec2 imageMin, imageMax; // screen rectangle of the image shown by the last render()
 	unsigned int tex;
 	bool firstRender;
+	unsigned int frameTexture; // texture attached to the display framebuffer: tex, or a render thread slot
+	int multiSamples; // MSAA samples VTK's framebuffers were created with
+	std::atomic<double> lastRenderTime; // ms spent in the last renderWindow->Render(), written by the render thread too
+	std::atomic<double> framerate; // smoothed renders per second of this viewer, read by the UI thread
+private:
+	std::string smpBackend; // empty = VTK's default backend
+	int smpThreads; // 0 = VTK's default thread count
+	std::vector<std::shared_ptr<VtkFilterExecution>> filterExecutions;
+	static std::mutex filterMutex; // guards filterExecutions and the records, written on the render thread too
+private:
+	VtkLodManager* lodManager; // not owned
+	VtkOrientationMarker* orientationMarker; // not owned
+private:
+	float renderScale; // render target pixels per framebuffer pixel, see setRenderScale()
+	float currentRenderScale; // used by the last render(), follows the frame time in dynamic mode
+	bool dynamicRenderScale;
+	double targetFrameTime; // ms
+	float minRenderScale, maxRenderScale; // dynamic mode range
+	unsigned long scaledFrameCount; // renders seen by the last dynamic scale update
+private:
+	std::unique_ptr<VtkTemporalAccumulator> accumulator; // created on the rendering context when first used
+	int accumulationFrames; // 0 = off
+	std::atomic<int> accumulatedFrames; // in the current average
+private:
+	TransparencyMode transparencyMode;
+	int maximumPeels;
+	double peelingTimeBudget; // ms, AdaptivePeeling
+	vtkSmartPointer<vtkRenderPass> translucentPass; // WeightedBlended
+	struct DepthSortedActor {
+		vtkWeakPointer<vtkActor> actor;
+		vtkSmartPointer<vtkDepthSortPolyData> sorter;
+		vtkSmartPointer<vtkAlgorithmOutput> input; // mapper input before the sorter was inserted
+	};
+	std::vector<DepthSortedActor> depthSortedActors;
+private:
+	vtkSmartPointer<vtkRenderer> dynamicRenderer; // layer 1 while layered, see setLayered()
+	unsigned long dynamicStartTag;
+	vtkSmartPointer<vtkOpenGLFramebufferObject> layerCache; // color + depth of the static layer
+	bool layerCacheValid;
+	bool staticLayerDrawn; // in the frame being rendered
+	vtkMTimeType staticRenderedMTime;
+	std::atomic<unsigned long> staticRenderCount, dynamicRenderCount;
+private:
+	std::vector<double> transformBuffer; // setTransforms() scratch, 16 per prop
+private:
+	std::unique_ptr<MpscQueue<VtkSceneCommand>> commands; // posted scene changes, applied by render()
+	// Thread applying a command batch under lockScene(): only it skips locking again meanwhile, every other
+	// thread still waits for the scene mutex
+	std::atomic<std::thread::id> applyingThread;
+	size_t lastCommandBatch, maxCommandBatch;
+	double commandLatency, maxCommandLatency; // ms from post() to applied, mean and worst of the last batch
+	std::atomic<unsigned long> droppedCommands; // posted while the queue was full
+private:
+	bool renderOnDemand; // skip renderWindow->Render() when nothing in the scene changed
+	std::atomic<bool> animating; // also read by the render thread
+	std::atomic<bool> redrawRequested;
+	vtkMTimeType renderedMTime; // scene MTime right after the last renderWindow->Render()
+	int renderedFrame; // ImGui frame count of the last render() call
+	std::atomic<unsigned long> renderCount;
+	std::chrono::steady_clock::time_point firstFrameStart;
+	bool firstFramePending; // timing until render() shows a frame
+	double firstFrameTime; // ms
+	static std::vector<VtkViewer*> instances;
+	static std::atomic<unsigned long> totalRenderCount;
+	static std::atomic<long long> totalRenderTime; // us, render threads add to it too
+private:
+	std::string name;
+	std::atomic<size_t> gpuBytes; // estimate of what this viewer keeps on the GPU, 0 while evicted
+	std::chrono::steady_clock::time_point lastShown;
+	static unsigned int nextViewerId;
+	static size_t gpuMemoryBudget; // bytes, 0 = unlimited
+	static double gpuEvictionDelay; // s, 0 = only evict to stay within the budget
+	static int budgetFrame; // ImGui frame in which the budget was last enforced
+private:
+	friend class VtkRenderThread;
+	std::unique_ptr<VtkRenderThread> renderThread; // set while threaded
+	std::mutex sceneMutex; // held by the render thread while it handles events and renders
 public:
 	VtkViewer();
-	VtkViewer(const VtkViewer& vtkViewer);
 	VtkViewer(VtkViewer&& vtkViewer) noexcept;
 	~VtkViewer();
 
-	VtkViewer& operator=(const VtkViewer& vtkViewer);
+	// Move-only: the viewer owns its texture and render window
+	VtkViewer(const VtkViewer&) = delete;
+	VtkViewer& operator=(const VtkViewer&) = delete;
+	VtkViewer& operator=(VtkViewer&& vtkViewer) noexcept;
 private:
 	IMGUI_IMPL_API void init();
 public:
 	IMGUI_IMPL_API void render();
 	IMGUI_IMPL_API void render(const ImVec2 size);
+	// Renders into getTexture() without any ImGui call (pre-warming, thumbnails, off-screen use)
+	IMGUI_IMPL_API void renderToTexture(unsigned int width, unsigned int height);
+	// Counts as shown in this ImGui frame (GPU memory eviction, frame pacing) for viewers whose texture is
+	// displayed without calling render()
+	IMGUI_IMPL_API void keepResident();
+	// Back to a freshly constructed state (no props, default camera, lights and settings), keeping the render
+	// window, its GL objects, the texture and compiled shaders; used by VtkViewerPool
+	IMGUI_IMPL_API void reset();
 	IMGUI_IMPL_API void addActor(const vtkSmartPointer<vtkProp>& actor);
 	IMGUI_IMPL_API void addActors(const vtkSmartPointer<vtkPropCollection>& actors);
 	IMGUI_IMPL_API void removeActor(const vtkSmartPointer<vtkProp>& actor);
+	// Copies of source placed by transforms and colored by colors (RGBA, 4 per instance, white when empty),
+	// drawn with GPU instancing by one actor. The returned object updates the instances in place; the viewer
+	// keeps its actor until removeActor(instances->getActor()).
+	IMGUI_IMPL_API std::shared_ptr<VtkInstancedGlyphs> addInstances(vtkAlgorithmOutput* source,
+		const std::vector<VtkInstanceTransform>& transforms, const std::vector<unsigned char>& colors);
+	// Moves many props at once: positions holds x, y, z (3 per prop) and orientations a unit quaternion w, x, y, z
+	// (4 per prop); throws VtkViewerError on any other size. All matrices are computed in one pass and copied into
+	// each prop's user matrix (created on first use, applied after the prop's own position/orientation) under one
+	// scene lock. This saves the caller-side Euler angle and vtkTransform work of SetPosition()/SetOrientation();
+	// VTK still rebuilds every moved prop's matrix from its user matrix before drawing.
+	IMGUI_IMPL_API void setTransforms(const std::vector<vtkSmartPointer<vtkProp3D>>& props, const std::vector<float>& positions,
+		const std::vector<float>& orientations);
+	// Layered viewers draw getDynamicRenderer() over getRenderer() (the static layer) with the same camera. The
+	// static layer's color and depth are cached and it is only rendered again when its props, its lights or the
+	// camera change; other frames restore the cache and render the dynamic layer alone.
+	IMGUI_IMPL_API void setLayered(bool layered);
+	// Throw VtkViewerError while the viewer isn't layered
+	IMGUI_IMPL_API void addDynamicActor(const vtkSmartPointer<vtkProp>& actor);
+	IMGUI_IMPL_API void removeDynamicActor(const vtkSmartPointer<vtkProp>& actor);
 	void setViewportSize(const ImVec2 newSize);
 public:
+	// Scene changes from any thread (data acquisition, workers) without waiting for the ImGui thread: commands
+	// are queued lock-free and applied in posting order at the start of the next render(), or renderToTexture(),
+	// all pending ones in one batch under lockScene(). Commands may call any viewer method. VTK objects passed
+	// in must not be touched by the posting thread afterwards. Returns false, dropping the command, when
+	// CommandQueueCapacity commands are already waiting.
+	IMGUI_IMPL_API bool post(const std::function<void(VtkViewer&)>& command);
+	IMGUI_IMPL_API bool postAddActor(const vtkSmartPointer<vtkProp>& actor);
+	IMGUI_IMPL_API bool postRemoveActor(const vtkSmartPointer<vtkProp>& actor);
+	// New data on input port 0 of a mapper or filter, e.g. a vtkPolyData built by the posting thread
+	IMGUI_IMPL_API bool postInputData(const vtkSmartPointer<vtkAlgorithm>& algorithm, const vtkSmartPointer<vtkDataObject>& data);
+	// change is called with the actor's property when the command is applied
+	IMGUI_IMPL_API bool postProperty(const vtkSmartPointer<vtkActor>& actor, const std::function<void(vtkProperty*)>& change);
+	IMGUI_IMPL_API size_t getPendingCommands() const; // approximate while other threads post
+public:
+	// World position of the surface under the mouse in the image shown by the last render(), found with a
+	// vtkCellPicker over the renderer's pickable props; false over the background. Call after render().
+	IMGUI_IMPL_API bool pick(double position[3]);
+public:
+	// SMP (vtkSMPTools) settings applied while this viewer's pipelines execute during render(); ignored while
+	// threaded, since vtkSMPTools is configured process-wide and only from the UI thread
+	// Backend is one of "Sequential", "STDThread", "TBB", "OpenMP" (it must be enabled in the VTK build)
+	IMGUI_IMPL_API void setSMPBackend(const std::string& backend);
+	IMGUI_IMPL_API void setSMPThreads(int threads);
+	// Instrument every filter upstream of the props in the renderer (called by addActor/addActors)
+	IMGUI_IMPL_API void trackPipeline();
+public:
+	// render() sizes its texture at ImGui size x DisplayFramebufferScale (HiDPI) x render scale, in [0.5, 2]:
+	// below 1 renders fewer pixels and is upscaled, above 1 supersamples. Mouse positions are mapped accordingly.
+	IMGUI_IMPL_API void setRenderScale(float scale);
+	// Dynamic mode picks the scale within [minScale, maxScale] after every render so that renders take about
+	// targetFrameTime ms; disabling it goes back to the fixed render scale
+	IMGUI_IMPL_API void setDynamicRenderScale(bool enabled, double targetFrameTime = 16.0, float minScale = 0.5f, float maxScale = 1.0f);
+	// MSAA samples of VTK's render framebuffer (0 = off, clamped to GL_MAX_SAMPLES), resolved into getTexture()
+	// when VTK finishes a frame. Changing the count rebuilds the viewer's GL resources on its next render;
+	// a count set on the render window directly is picked up the same way.
+	IMGUI_IMPL_API void setMultiSamples(int samples);
+	// FXAA post pass: one full-screen pass instead of rendering every pixel several times
+	IMGUI_IMPL_API void setFXAA(bool enabled);
+	// Progressive refinement of still views: while nothing in the scene changes, every render adds a frame with
+	// a sub-pixel camera jitter to a running average, until `frames` frames are in it; then rendering stops as
+	// if render-on-demand were set. Any change restarts from a single plain frame, so interaction stays as
+	// cheap as without anti-aliasing. 0 frames turns it off.
+	IMGUI_IMPL_API void setAccumulation(int frames);
+	// DepthSort inserts a vtkDepthSortPolyData in front of the vtkPolyDataMapper of every actor with an opacity
+	// below 1, and takes it out again when another mode is chosen
+	IMGUI_IMPL_API void setTransparencyMode(TransparencyMode mode);
+	// Upper bound for DepthPeeling and AdaptivePeeling, at least 1 (VTK's default is 4)
+	IMGUI_IMPL_API void setMaximumPeels(int peels);
+	// AdaptivePeeling lowers the peel count while renders take longer than this and raises it again below it
+	IMGUI_IMPL_API void setPeelingTimeBudget(double ms);
+	IMGUI_IMPL_API int getPeelCount() const; // peels currently allowed
+	IMGUI_IMPL_API int getMultiSamples() const;
+	IMGUI_IMPL_API bool getFXAA() const;
+public:
+	// True when the next render() will actually render: first frame, resize, requested redraw, animation,
+	// or any prop, camera, light, mapper or upstream filter modified since the last render
+	IMGUI_IMPL_API bool needsRedraw();
+	// Background work (e.g. LOD decimation) whose results will need a redraw once they arrive
+	IMGUI_IMPL_API bool hasPendingWork() const;
+public:
+	// Opt-in: render on a dedicated thread with its own shared GL context, render() then only shows the
+	// newest finished frame and forwards interaction. Main thread only, with the ImGui context current.
+	// Props, pipelines and the LOD manager of a threaded viewer must not be shared with other viewers,
+	// and changes to them from the ImGui thread must hold lockScene().
+	IMGUI_IMPL_API void setThreaded(bool threaded);
+	// Locks out the render thread while the scene is modified; a no-op lock when not threaded
+	IMGUI_IMPL_API std::unique_lock<std::mutex> lockScene();
+public:
+	static const size_t CommandQueueCapacity = 4096;
+
 	static inline unsigned int NoScrollFlags(){
 		return ImGuiWindowFlags_NoScrollbar | ImGuiWindowFlags_NoScrollWithMouse;
 	}
+
+	// True when the current OpenGL context is backed by a software rasterizer (llvmpipe, SwiftShader, ...)
+	// Requires a current context
+	static bool IsSoftwareRenderer();
+
+	// Over the viewers shown in the current ImGui frame, used by VtkFramePacer to decide whether to block
+	static bool AnyNeedsRedraw();
+	static bool AnyHasPendingWork();
+
+	// GPU memory of viewers that weren't shown in the last frame (closed windows, hidden tabs) is released,
+	// least recently shown first, while the resident total is over the budget, and after gpuEvictionDelay
+	// seconds regardless. Evicted viewers rebuild everything on their next render().
+	// Estimates count the texture, VTK's framebuffers and the data uploaded by each viewer's props; props
+	// shared between viewers are counted in each of them.
+	static inline void SetGpuMemoryBudget(size_t bytes){
+		gpuMemoryBudget = bytes;
+	}
+
+	static inline size_t GetGpuMemoryBudget(){
+		return gpuMemoryBudget;
+	}
+
+	static inline void SetGpuEvictionDelay(double seconds){
+		gpuEvictionDelay = seconds;
+	}
+
+	static inline double GetGpuEvictionDelay(){
+		return gpuEvictionDelay;
+	}
+
+	static size_t GetTotalGpuBytes();
+	// Called by render() once per ImGui frame, needs the ImGui OpenGL context current
+	static void EnforceGpuMemoryBudget();
+	// Per-viewer resident memory and budget controls
+	static void ShowGpuMemoryWindow(bool* open = nullptr);
+
+	// Renders and time spent in renderWindow->Render() (ms) by all viewers since startup
+	static inline unsigned long GetTotalRenderCount(){
+		return totalRenderCount;
+	}
+
+	static inline double GetTotalRenderTime(){
+		return totalRenderTime.load() / 1000.0;
+	}
 public:
 	inline void setRenderWindow(const vtkSmartPointer<vtkGenericOpenGLRenderWindow>& renderWindow) {
 		this->renderWindow = renderWindow;
@@ -82,6 +382,31 @@ public:
 	inline void setRenderer(const vtkSmartPointer<vtkRenderer>& renderer) {
 		this->renderer = renderer;
 	}
+
+	// Level of detail of the manager's actors is chosen for this viewer's size before every render
+	inline void setLodManager(VtkLodManager* lodManager) {
+		this->lodManager = lodManager;
+	}
+
+	// Drawn over the viewer's image from a cached texture, see VtkOrientationMarker
+	inline void setOrientationMarker(VtkOrientationMarker* orientationMarker) {
+		this->orientationMarker = orientationMarker;
+	}
+
+	// Off by default: every render() call renders, as before
+	inline void setRenderOnDemand(bool renderOnDemand) {
+		this->renderOnDemand = renderOnDemand;
+	}
+
+	// While animating, every render() call renders even if VTK sees no change (e.g. time-driven shaders)
+	inline void setAnimating(bool animating) {
+		this->animating = animating;
+	}
+
+	// For changes VTK can't see (e.g. data arrays written in place without Modified())
+	inline void requestRedraw() {
+		redrawRequested = true;
+	}
 public:
 	inline vtkSmartPointer<vtkGenericOpenGLRenderWindow>& getRenderWindow() {
 		return renderWindow;
@@ -98,6 +423,126 @@ public:
 	inline vtkSmartPointer<vtkRenderer>& getRenderer() {
 		return renderer;
 	}
+
+	inline vtkSmartPointer<vtkRenderer>& getDynamicRenderer() {
+		return dynamicRenderer;
+	}
+
+	inline VtkLodManager* getLodManager() const {
+		return lodManager;
+	}
+
+	inline VtkOrientationMarker* getOrientationMarker() const {
+		return orientationMarker;
+	}
+
+	inline bool getRenderOnDemand() const {
+		return renderOnDemand;
+	}
+
+	inline bool isAnimating() const {
+		return animating.load();
+	}
+
+	inline unsigned long getRenderCount() const {
+		return renderCount;
+	}
+
+	// Times until render() shows a rendered frame, e.g. from the moment a UI asked for this viewer (VtkViewerPool
+	// starts it in acquire()); getFirstFrameTime() is 0 until then
+	IMGUI_IMPL_API void startFirstFrameTimer(std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now());
+	inline double getFirstFrameTime() const {
+		return firstFrameTime;
+	}
+
+	inline bool isLayered() const {
+		return dynamicRenderer != nullptr;
+	}
+
+	// Renders of each layer while layered; the dynamic layer is drawn in every render
+	inline unsigned long getStaticRenderCount() const {
+		return staticRenderCount;
+	}
+
+	inline unsigned long getDynamicRenderCount() const {
+		return dynamicRenderCount;
+	}
+
+	inline void setName(const std::string& name) {
+		this->name = name;
+	}
+
+	inline const std::string& getName() const {
+		return name;
+	}
+
+	inline size_t getGpuBytes() const {
+		return gpuBytes;
+	}
+
+	inline bool isThreaded() const {
+		return renderThread != nullptr;
+	}
+
+	inline float getRenderScale() const {
+		return renderScale;
+	}
+
+	// Scale of the current texture; equals getRenderScale() unless the dynamic mode is on
+	inline float getCurrentRenderScale() const {
+		return currentRenderScale;
+	}
+
+	inline bool isDynamicRenderScale() const {
+		return dynamicRenderScale;
+	}
+
+	inline double getTargetFrameTime() const {
+		return targetFrameTime;
+	}
+
+	inline TransparencyMode getTransparencyMode() const {
+		return transparencyMode;
+	}
+
+	inline int getMaximumPeels() const {
+		return maximumPeels;
+	}
+
+	inline double getPeelingTimeBudget() const {
+		return peelingTimeBudget;
+	}
+
+	inline int getAccumulation() const {
+		return accumulationFrames;
+	}
+
+	// Frames averaged into the current image, equals getAccumulation() once converged
+	inline int getAccumulatedFrames() const {
+		return accumulatedFrames;
+	}
+
+	// Commands applied by the last batch and the largest batch so far
+	inline size_t getLastCommandBatch() const {
+		return lastCommandBatch;
+	}
+
+	inline size_t getMaxCommandBatch() const {
+		return maxCommandBatch;
+	}
+
+	// ms between post() and the command being applied, over the last batch
+	inline double getCommandLatency() const {
+		return commandLatency;
+	}
+
+	inline double getMaxCommandLatency() const {
+		return maxCommandLatency;
+	}
+
+	inline unsigned long getDroppedCommands() const {
+		return droppedCommands;
+	}
 public:
 
 	inline unsigned int getViewportWidth() const {
@@ -111,4 +556,23 @@ public:
 	inline unsigned int getTexture() const {
 		return tex;
 	}
+
+	inline double getLastRenderTime() const {
+		return lastRenderTime;
+	}
+
+	inline double getFramerate() const {
+		return framerate;
+	}
+
+	inline const std::string& getSMPBackend() const {
+		return smpBackend;
+	}
+
+	inline int getSMPThreads() const {
+		return smpThreads;
+	}
+
+	// Copy of the records, consistent even while a render thread executes the filters
+	IMGUI_IMPL_API std::vector<VtkFilterExecution> getFilterExecutions() const;
 };
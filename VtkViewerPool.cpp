@@ -0,0 +1,47 @@
+#include "VtkViewerPool.h"
+
+#include <chrono>
+
+VtkViewerPool::VtkViewerPool(size_t maxIdle)
+	: maxIdle(maxIdle), lastAcquireTime(0.0), lastAcquireWasHit(false){
+}
+
+void VtkViewerPool::warmUp(size_t count, unsigned int width, unsigned int height, vtkProp* prop){
+	while (idle.size() < count && idle.size() < maxIdle){
+		std::unique_ptr<VtkViewer> viewer(new VtkViewer());
+		if (prop){
+			viewer->getRenderer()->AddViewProp(prop);
+			viewer->getRenderer()->ResetCamera();
+		}
+		viewer->renderToTexture(width, height);
+		viewer->reset();
+		idle.push_back(std::move(viewer));
+	}
+}
+
+std::unique_ptr<VtkViewer> VtkViewerPool::acquire(){
+	auto start = std::chrono::steady_clock::now();
+	std::unique_ptr<VtkViewer> viewer;
+	lastAcquireWasHit = !idle.empty();
+	if (lastAcquireWasHit){
+		viewer = std::move(idle.back());
+		idle.pop_back();
+	}
+	else{
+		viewer.reset(new VtkViewer());
+	}
+	lastAcquireTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	viewer->startFirstFrameTimer(start);
+	return viewer;
+}
+
+void VtkViewerPool::release(std::unique_ptr<VtkViewer> viewer){
+	if (!viewer){
+		return;
+	}
+	if (idle.size() >= maxIdle){
+		return; // destroyed here
+	}
+	viewer->reset();
+	idle.push_back(std::move(viewer));
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include <vtkProp.h>
+#include <vtkSmartPointer.h>
+
+#include "VtkViewer.h"
+
+// Recycles VtkViewers (render window, FBOs, texture, compiled shaders) for UIs that open and close viewers
+// often, e.g. one viewer per tab. Constructing a VtkViewer and rendering it for the first time sets up the
+// context and compiles shaders; acquiring a warmed-up pooled viewer only resets its scene.
+// Main thread only, with the ImGui OpenGL context current.
+class VtkViewerPool {
+public:
+	// At most maxIdle released viewers are kept, extra ones are destroyed
+	explicit VtkViewerPool(size_t maxIdle = 8);
+
+	VtkViewerPool(const VtkViewerPool&) = delete;
+	VtkViewerPool& operator=(const VtkViewerPool&) = delete;
+public:
+	// Creates count idle viewers and renders one width x height frame in each, so the first real render
+	// doesn't pay for context setup. If prop is given it is rendered too so its shaders get compiled.
+	void warmUp(size_t count, unsigned int width = 256, unsigned int height = 256, vtkProp* prop = nullptr);
+	std::unique_ptr<VtkViewer> acquire();
+	// The viewer is reset() and kept for later (or destroyed when the pool is full)
+	void release(std::unique_ptr<VtkViewer> viewer);
+public:
+	inline size_t getIdleCount() const {
+		return idle.size();
+	}
+
+	inline size_t getMaxIdle() const {
+		return maxIdle;
+	}
+
+	inline void setMaxIdle(size_t maxIdle) {
+		this->maxIdle = maxIdle;
+		if (idle.size() > maxIdle){
+			idle.resize(maxIdle);
+		}
+	}
+
+	// Time spent in the last acquire() call (ms), and whether it had to construct a new viewer. Most of the cost
+	// of opening a viewer comes with its first render: the acquired viewer's getFirstFrameTime() measures from
+	// the start of acquire() to the first frame its render() shows.
+	inline double getLastAcquireTime() const {
+		return lastAcquireTime;
+	}
+
+	inline bool getLastAcquireWasHit() const {
+		return lastAcquireWasHit;
+	}
+private:
+	std::vector<std::unique_ptr<VtkViewer>> idle;
+	size_t maxIdle;
+	double lastAcquireTime;
+	bool lastAcquireWasHit;
+};
@@ -0,0 +1,342 @@
+#include "VtkWindowLevelImageMapper.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+// VTK's own OpenGL loader; the context is the one VTK renders with
+#include "vtk_glew.h"
+
+#include <vtkActor.h>
+#include <vtkDataArray.h>
+#include <vtkInformation.h>
+#include <vtkMath.h>
+#include <vtkMatrix3x3.h>
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkOpenGLActor.h>
+#include <vtkOpenGLCamera.h>
+#include <vtkOpenGLRenderWindow.h>
+#include <vtkOpenGLShaderCache.h>
+#include <vtkOpenGLState.h>
+#include <vtkPointData.h>
+#include <vtkProperty.h>
+#include <vtkRenderer.h>
+#include <vtkScalarsToColors.h>
+#include <vtkShaderProgram.h>
+#include <vtkTextureUnitManager.h>
+
+namespace {
+	const char* windowLevelVertexShader =
+		"//VTK::System::Dec\n"
+		"in vec3 vertexMC;\n"
+		"in vec2 tcoordMC;\n"
+		"uniform mat4 MCDCMatrix;\n"
+		"out vec2 tcoord;\n"
+		"void main() {\n"
+		"  tcoord = tcoordMC;\n"
+		"  gl_Position = MCDCMatrix * vec4(vertexMC, 1.0);\n"
+		"}\n";
+
+	// The image is filtered in raw values, then window/level picks the lookup table entry
+	const char* windowLevelFragmentShader =
+		"//VTK::System::Dec\n"
+		"//VTK::Output::Dec\n"
+		"in vec2 tcoord;\n"
+		"uniform sampler2D image;\n"
+		"uniform sampler2D lookupTable;\n"
+		"uniform float textureScale;\n"
+		"uniform float lower;\n"
+		"uniform float inverseWindow;\n"
+		"uniform float opacity;\n"
+		"void main() {\n"
+		"  float value = texture(image, tcoord).r * textureScale;\n"
+		"  float t = clamp((value - lower) * inverseWindow, 0.0, 1.0);\n"
+		"  vec4 color = texture(lookupTable, vec2(t * (255.0 / 256.0) + 0.5 / 256.0, 0.5));\n"
+		"  gl_FragData[0] = vec4(color.rgb, color.a * opacity);\n"
+		"}\n";
+
+	const int lookupTableSize = 256;
+}
+
+vtkStandardNewMacro(VtkWindowLevelImageMapper);
+
+VtkWindowLevelImageMapper::VtkWindowLevelImageMapper()
+	: Window(255.0), Level(127.5), ImageTexture(0), LookupTableTexture(0), TextureScale(1.0f), UploadedLookupTable(nullptr),
+	VertexBuffer(0), VertexArray(0), VertexArrayProgram(0), Stats(){
+	Stats.textureFormat = "";
+}
+
+VtkWindowLevelImageMapper::~VtkWindowLevelImageMapper() = default;
+
+int VtkWindowLevelImageMapper::FillInputPortInformation(int port, vtkInformation* info){
+	info->Set(vtkAlgorithm::INPUT_REQUIRED_DATA_TYPE(), "vtkImageData");
+	return 1;
+}
+
+vtkImageData* VtkWindowLevelImageMapper::GetInput(){
+	return vtkImageData::SafeDownCast(this->GetInputDataObject(0, 0));
+}
+
+double* VtkWindowLevelImageMapper::GetBounds(){
+	if (this->GetNumberOfInputConnections(0) > 0){
+		this->GetInputAlgorithm()->Update();
+	}
+	vtkImageData* input = this->GetInput();
+	if (!input){
+		vtkMath::UninitializeBounds(this->Bounds);
+	}
+	else{
+		input->GetBounds(this->Bounds);
+		this->Bounds[5] = this->Bounds[4]; // first slice only
+	}
+	return this->Bounds;
+}
+
+void VtkWindowLevelImageMapper::UploadImage(vtkImageData* input, vtkOpenGLState* state){
+	const auto start = std::chrono::steady_clock::now();
+	vtkDataArray* scalars = input->GetPointData()->GetScalars();
+	int dimensions[3];
+	input->GetDimensions(dimensions);
+	const int width = dimensions[0], height = dimensions[1];
+	const size_t pixels = static_cast<size_t>(width) * height;
+	const int components = scalars->GetNumberOfComponents();
+
+	// Single-component 8/16-bit images go up as they are, normalized; anything else is converted to float
+	GLint internalFormat = GL_R32F;
+	GLenum type = GL_FLOAT;
+	const void* data = nullptr;
+	size_t texelBytes = sizeof(float);
+	TextureScale = 1.0f;
+	Stats.textureFormat = "R32F";
+	if (components == 1){
+		switch (scalars->GetDataType()){
+		case VTK_UNSIGNED_SHORT:
+			internalFormat = GL_R16; type = GL_UNSIGNED_SHORT; texelBytes = 2; TextureScale = 65535.0f; Stats.textureFormat = "R16";
+			break;
+		case VTK_SHORT:
+			internalFormat = GL_R16_SNORM; type = GL_SHORT; texelBytes = 2; TextureScale = 32767.0f; Stats.textureFormat = "R16 snorm";
+			break;
+		case VTK_UNSIGNED_CHAR:
+			internalFormat = GL_R8; type = GL_UNSIGNED_BYTE; texelBytes = 1; TextureScale = 255.0f; Stats.textureFormat = "R8";
+			break;
+		case VTK_SIGNED_CHAR:
+			internalFormat = GL_R8_SNORM; type = GL_BYTE; texelBytes = 1; TextureScale = 127.0f; Stats.textureFormat = "R8 snorm";
+			break;
+		case VTK_FLOAT:
+			break;
+		default:
+			type = GL_NONE;
+			break;
+		}
+		if (type != GL_NONE){
+			data = scalars->GetVoidPointer(0); // the first slice comes first
+		}
+	}
+	std::vector<float> converted;
+	if (!data){
+		converted.resize(pixels);
+		for (size_t i = 0; i < pixels; i++){
+			converted[i] = static_cast<float>(scalars->GetComponent(static_cast<vtkIdType>(i), 0));
+		}
+		internalFormat = GL_R32F;
+		type = GL_FLOAT;
+		data = converted.data();
+	}
+
+	if (!ImageTexture){
+		glGenTextures(1, &ImageTexture);
+	}
+	glBindTexture(GL_TEXTURE_2D, ImageTexture);
+	// Through vtkOpenGLState, whose cached value VTK relies on for its own uploads
+	state->vtkglPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, GL_RED, type, data);
+	state->vtkglPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	// Quad over the point bounds of the first slice, texture coordinates at the centers of the edge texels
+	double bounds[6];
+	input->GetBounds(bounds);
+	const float s0 = 0.5f / width, s1 = 1.0f - s0, t0 = 0.5f / height, t1 = 1.0f - t0;
+	const float x0 = static_cast<float>(bounds[0]), x1 = static_cast<float>(bounds[1]);
+	const float y0 = static_cast<float>(bounds[2]), y1 = static_cast<float>(bounds[3]), z = static_cast<float>(bounds[4]);
+	const float quad[20] = {
+		x0, y0, z, s0, t0,
+		x1, y0, z, s1, t0,
+		x0, y1, z, s0, t1,
+		x1, y1, z, s1, t1
+	};
+	if (!VertexBuffer){
+		glGenBuffers(1, &VertexBuffer);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	Stats.uploads++;
+	Stats.uploadedBytes = pixels * texelBytes;
+	Stats.uploadTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	UploadTime.Modified();
+}
+
+void VtkWindowLevelImageMapper::UploadLookupTable(){
+	unsigned char colors[lookupTableSize * 4];
+	vtkScalarsToColors* lookupTable = this->LookupTable; // not GetLookupTable(), which creates a default one
+	if (lookupTable){
+		lookupTable->Build();
+	}
+	for (int i = 0; i < lookupTableSize; i++){
+		const double t = i / (lookupTableSize - 1.0);
+		double rgb[3] = {t, t, t};
+		double alpha = 1.0;
+		if (lookupTable){
+			const double* range = lookupTable->GetRange();
+			const double value = range[0] + t * (range[1] - range[0]);
+			lookupTable->GetColor(value, rgb);
+			alpha = lookupTable->GetOpacity(value);
+		}
+		for (int c = 0; c < 3; c++){
+			colors[i * 4 + c] = static_cast<unsigned char>(std::lround(std::max(0.0, std::min(1.0, rgb[c])) * 255.0));
+		}
+		colors[i * 4 + 3] = static_cast<unsigned char>(std::lround(std::max(0.0, std::min(1.0, alpha)) * 255.0));
+	}
+
+	if (!LookupTableTexture){
+		glGenTextures(1, &LookupTableTexture);
+	}
+	glBindTexture(GL_TEXTURE_2D, LookupTableTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, lookupTableSize, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, colors);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	UploadedLookupTable = lookupTable;
+	Stats.lookupTableUploads++;
+	LookupTableTime.Modified();
+}
+
+void VtkWindowLevelImageMapper::Render(vtkRenderer* ren, vtkActor* actor){
+	if (this->GetNumberOfInputConnections(0) > 0){
+		this->GetInputAlgorithm()->Update();
+	}
+	vtkImageData* input = this->GetInput();
+	if (!input || !input->GetPointData()->GetScalars()){
+		return;
+	}
+	int dimensions[3];
+	input->GetDimensions(dimensions);
+	if (dimensions[0] < 1 || dimensions[1] < 1){
+		return;
+	}
+
+	vtkOpenGLRenderWindow* renWin = vtkOpenGLRenderWindow::SafeDownCast(ren->GetRenderWindow());
+	vtkOpenGLState* state = renWin->GetState();
+	if (!ImageTexture || input->GetMTime() > UploadTime){
+		UploadImage(input, state);
+	}
+	vtkScalarsToColors* lookupTable = this->LookupTable;
+	if (!LookupTableTexture || lookupTable != UploadedLookupTable || (lookupTable && lookupTable->GetMTime() > LookupTableTime)){
+		UploadLookupTable();
+	}
+
+	vtkShaderProgram* program = renWin->GetShaderCache()->ReadyShaderProgram(windowLevelVertexShader, windowLevelFragmentShader, "");
+	if (!program){
+		vtkErrorMacro("Could not build the window/level shader program");
+		return;
+	}
+
+	if (!VertexArray || VertexArrayProgram != program->GetHandle()){
+		if (!VertexArray){
+			glGenVertexArrays(1, &VertexArray);
+		}
+		glBindVertexArray(VertexArray);
+		GLint vertexLocation = glGetAttribLocation(program->GetHandle(), "vertexMC");
+		GLint tcoordLocation = glGetAttribLocation(program->GetHandle(), "tcoordMC");
+		glBindBuffer(GL_ARRAY_BUFFER, VertexBuffer);
+		glEnableVertexAttribArray(vertexLocation);
+		glVertexAttribPointer(vertexLocation, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), nullptr);
+		glEnableVertexAttribArray(tcoordLocation);
+		glVertexAttribPointer(tcoordLocation, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), reinterpret_cast<const void*>(3 * sizeof(float)));
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glBindVertexArray(0);
+		VertexArrayProgram = program->GetHandle();
+	}
+
+	// Same matrix conventions as vtkOpenGLPolyDataMapper (matrices are already transposed for GL)
+	vtkOpenGLCamera* camera = static_cast<vtkOpenGLCamera*>(ren->GetActiveCamera());
+	vtkMatrix4x4* wcvc;
+	vtkMatrix3x3* cameraNormals;
+	vtkMatrix4x4* vcdc;
+	vtkMatrix4x4* wcdc;
+	camera->GetKeyMatrices(ren, wcvc, cameraNormals, vcdc, wcdc);
+	if (actor->GetIsIdentity()){
+		program->SetUniformMatrix("MCDCMatrix", wcdc);
+	}
+	else{
+		vtkMatrix4x4* mcwc;
+		vtkMatrix3x3* actorNormals;
+		static_cast<vtkOpenGLActor*>(actor)->GetKeyMatrices(mcwc, actorNormals);
+		vtkSmartPointer<vtkMatrix4x4> mcdc = vtkSmartPointer<vtkMatrix4x4>::New();
+		vtkMatrix4x4::Multiply4x4(mcwc, wcdc, mcdc);
+		program->SetUniformMatrix("MCDCMatrix", mcdc);
+	}
+
+	// Window/level are the only per-frame inputs besides the matrices
+	const double window = Window != 0.0 ? Window : 1e-12;
+	program->SetUniformf("textureScale", TextureScale);
+	program->SetUniformf("lower", static_cast<float>(Level - window / 2.0));
+	program->SetUniformf("inverseWindow", static_cast<float>(1.0 / window));
+	program->SetUniformf("opacity", static_cast<float>(actor->GetProperty()->GetOpacity()));
+
+	vtkTextureUnitManager* units = renWin->GetTextureUnitManager();
+	const int imageUnit = units->Allocate();
+	const int lookupTableUnit = units->Allocate();
+	state->vtkglActiveTexture(GL_TEXTURE0 + imageUnit);
+	glBindTexture(GL_TEXTURE_2D, ImageTexture);
+	state->vtkglActiveTexture(GL_TEXTURE0 + lookupTableUnit);
+	glBindTexture(GL_TEXTURE_2D, LookupTableTexture);
+	program->SetUniformi("image", imageUnit);
+	program->SetUniformi("lookupTable", lookupTableUnit);
+
+	glBindVertexArray(VertexArray);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	glBindVertexArray(0);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	state->vtkglActiveTexture(GL_TEXTURE0 + imageUnit);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	state->vtkglActiveTexture(GL_TEXTURE0);
+	units->Free(lookupTableUnit);
+	units->Free(imageUnit);
+}
+
+void VtkWindowLevelImageMapper::ReleaseGraphicsResources(vtkWindow* window){
+	if (VertexArray){
+		glDeleteVertexArrays(1, &VertexArray);
+		VertexArray = 0;
+		VertexArrayProgram = 0;
+	}
+	if (VertexBuffer){
+		glDeleteBuffers(1, &VertexBuffer);
+		VertexBuffer = 0;
+	}
+	if (ImageTexture){
+		glDeleteTextures(1, &ImageTexture);
+		ImageTexture = 0;
+	}
+	if (LookupTableTexture){
+		glDeleteTextures(1, &LookupTableTexture);
+		LookupTableTexture = 0;
+	}
+	// Both are uploaded again on the next render
+	UploadTime = vtkTimeStamp();
+	LookupTableTime = vtkTimeStamp();
+	UploadedLookupTable = nullptr;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vtkImageData.h>
+#include <vtkMapper.h>
+#include <vtkTimeStamp.h>
+
+class vtkOpenGLState;
+
+// Uploads done by a VtkWindowLevelImageMapper
+struct VtkWindowLevelStats {
+	int uploads; // image uploads; window, level and lookup table changes don't cause any
+	size_t uploadedBytes; // by the last image upload
+	double uploadTime; // ms of the last image upload, conversion included
+	int lookupTableUploads;
+	const char* textureFormat; // of the image texture, e.g. "R16"
+};
+
+// Draws a 2D vtkImageData (its first z slice, first component) as a textured quad over the image bounds, with
+// window/level and the lookup table applied in the fragment shader. The raw values are uploaded once, 8/16-bit
+// integer images as normalized R8/R16 textures (other types as R32F), and only again when the image changes:
+// contrast changes cost a uniform update instead of vtkImageActor's CPU pass over the image and texture upload.
+// The mapper's lookup table (SetLookupTable) is sampled into 256 colors over its range, which window/level map
+// onto; without one the ramp is grayscale. Use it with a vtkActor; the actor's opacity applies.
+class VtkWindowLevelImageMapper : public vtkMapper {
+public:
+	static VtkWindowLevelImageMapper* New();
+	vtkTypeMacro(VtkWindowLevelImageMapper, vtkMapper);
+public:
+	void Render(vtkRenderer* ren, vtkActor* actor) override;
+	void ReleaseGraphicsResources(vtkWindow* window) override;
+	using vtkMapper::GetBounds;
+	double* GetBounds() override;
+
+	vtkImageData* GetInput();
+
+	// Same meaning as vtkImageProperty's ColorWindow/ColorLevel, in raw image values (defaults 255, 127.5);
+	// a negative window inverts the ramp
+	vtkSetMacro(Window, double);
+	vtkGetMacro(Window, double);
+	vtkSetMacro(Level, double);
+	vtkGetMacro(Level, double);
+
+	inline const VtkWindowLevelStats& GetStats() const {
+		return Stats;
+	}
+protected:
+	VtkWindowLevelImageMapper();
+	~VtkWindowLevelImageMapper() override;
+
+	int FillInputPortInformation(int port, vtkInformation* info) override;
+	void UploadImage(vtkImageData* input, vtkOpenGLState* state);
+	void UploadLookupTable();
+protected:
+	double Window;
+	double Level;
+
+	unsigned int ImageTexture;
+	unsigned int LookupTableTexture;
+	float TextureScale; // raw value of a texel value of 1 (65535 for R16, ...)
+	vtkTimeStamp UploadTime;
+	vtkTimeStamp LookupTableTime;
+	vtkScalarsToColors* UploadedLookupTable; // compared only, not dereferenced
+
+	unsigned int VertexBuffer; // quad: x, y, z, s, t per corner
+	unsigned int VertexArray;
+	unsigned int VertexArrayProgram; // program handle the vertex array was set up for
+
+	VtkWindowLevelStats Stats;
+private:
+	VtkWindowLevelImageMapper(const VtkWindowLevelImageMapper&) = delete;
+	void operator=(const VtkWindowLevelImageMapper&) = delete;
+};
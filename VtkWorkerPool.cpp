@@ -0,0 +1,107 @@
+#include "VtkWorkerPool.h"
+
+#include <algorithm>
+
+VtkWorkerPool::VtkWorkerPool(unsigned int threads)
+	: pending(0), stopping(false){
+	if (threads == 0){
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	for (unsigned int i = 0; i < threads; i++){
+		workers.emplace_back(&VtkWorkerPool::workerLoop, this);
+	}
+}
+
+VtkWorkerPool::~VtkWorkerPool(){
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	taskAvailable.notify_all();
+	for (auto& worker : workers){
+		worker.join();
+	}
+}
+
+void VtkWorkerPool::submit(std::function<void()> task){
+	pending++;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+	taskAvailable.notify_one();
+}
+
+void VtkWorkerPool::parallelFor(size_t first, size_t last, size_t grain, const std::function<void(size_t, size_t)>& fn){
+	if (last <= first){
+		return;
+	}
+	grain = std::max<size_t>(1, grain);
+	const size_t count = last - first;
+	const size_t chunks = std::min((count + grain - 1) / grain, static_cast<size_t>(workers.size() + 1) * 4);
+	if (chunks <= 1){
+		fn(first, last);
+		return;
+	}
+
+	// Chunks are claimed from a shared counter so that the caller and the workers balance the load
+	struct Loop {
+		std::atomic<size_t> nextChunk;
+		std::atomic<size_t> remaining;
+		std::mutex mutex;
+		std::condition_variable done;
+	};
+	auto loop = std::make_shared<Loop>();
+	loop->nextChunk = 0;
+	loop->remaining = chunks;
+	const size_t chunkSize = (count + chunks - 1) / chunks;
+
+	auto runChunks = [loop, first, last, chunks, chunkSize, &fn](){
+		size_t chunk;
+		while ((chunk = loop->nextChunk++) < chunks){
+			size_t begin = first + chunk * chunkSize;
+			size_t end = std::min(last, begin + chunkSize);
+			if (begin < end){
+				fn(begin, end);
+			}
+			if (--loop->remaining == 0){
+				std::lock_guard<std::mutex> lock(loop->mutex);
+				loop->done.notify_all();
+			}
+		}
+	};
+
+	const size_t helpers = std::min(chunks - 1, workers.size());
+	for (size_t i = 0; i < helpers; i++){
+		submit(runChunks);
+	}
+	runChunks();
+
+	std::unique_lock<std::mutex> lock(loop->mutex);
+	loop->done.wait(lock, [&loop](){ return loop->remaining.load() == 0; });
+}
+
+void VtkWorkerPool::waitIdle(){
+	std::unique_lock<std::mutex> lock(mutex);
+	idle.wait(lock, [this](){ return pending.load() == 0; });
+}
+
+void VtkWorkerPool::workerLoop(){
+	for (;;){
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			taskAvailable.wait(lock, [this](){ return stopping || !tasks.empty(); });
+			if (stopping && tasks.empty()){
+				return;
+			}
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+		if (--pending == 0){
+			std::lock_guard<std::mutex> lock(mutex);
+			idle.notify_all();
+		}
+	}
+}
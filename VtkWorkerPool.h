@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Small fixed-size thread pool for background work (decimation, decoding, ...) and data-parallel loops
+// Tasks must not touch VTK objects that are being rendered; hand results back to the render thread instead.
+class VtkWorkerPool {
+public:
+	// threads = 0 uses std::thread::hardware_concurrency()
+	explicit VtkWorkerPool(unsigned int threads = 0);
+	~VtkWorkerPool();
+
+	VtkWorkerPool(const VtkWorkerPool&) = delete;
+	VtkWorkerPool& operator=(const VtkWorkerPool&) = delete;
+public:
+	void submit(std::function<void()> task);
+	// Runs fn(begin, end) over [first, last) split in chunks of at least grain items, blocking until done.
+	// The calling thread works on chunks too.
+	void parallelFor(size_t first, size_t last, size_t grain, const std::function<void(size_t, size_t)>& fn);
+	// Blocks until the queue is empty and no task is running
+	void waitIdle();
+public:
+	inline unsigned int getThreadCount() const {
+		return static_cast<unsigned int>(workers.size());
+	}
+
+	inline size_t getPendingTasks() const {
+		return pending.load();
+	}
+private:
+	void workerLoop();
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable taskAvailable;
+	std::condition_variable idle;
+	std::atomic<size_t> pending; // queued + running
+	bool stopping;
+};
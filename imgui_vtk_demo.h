@@ -1,17 +1,53 @@
 #pragma once
 #include <vtkActor.h>
 #include <vtkSmartPointer.h>
+#include <vtkCamera.h>
+#include <vtkColorTransferFunction.h>
 #include <vtkContourFilter.h>
+#include <vtkCubeSource.h>
+#include <vtkFloatArray.h>
+#include <vtkFlyingEdges3D.h>
+#include <vtkImageActor.h>
+#include <vtkImageData.h>
+#include <vtkImageProperty.h>
 #include <vtkMath.h>
+#include <vtkMultiThreader.h>
 #include <vtkNamedColors.h>
+#include <vtkOutlineFilter.h>
+#include <vtkPiecewiseFunction.h>
+#include <vtkPlaneSource.h>
 #include <vtkPointData.h>
+#include <vtkPropCollection.h>
 #include <vtkPolyDataMapper.h>
 #include <vtkProperty.h>
-#include <vtkShortArray.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartVolumeMapper.h>
+#include <vtkSphereSource.h>
 #include <vtkStructuredPoints.h>
+#include <vtkUnsignedShortArray.h>
+#include <vtkVersion.h>
+#include <vtkVolume.h>
+#include <vtkVolumeProperty.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <thread>
+#include <vector>
 
-static vtkSmartPointer<vtkActor> SetupDemoPipeline()
+#include "imgui.h"
+#include "VtkViewer.h"
+#include "VtkInstancedGlyphs.h"
+#include "VtkSparseBrickVolume.h"
+#include "VtkOdeVolumeEngine.h"
+#include "VtkWindowLevelImageMapper.h"
+#include "VtkTilePyramid.h"
+
+
+// Integrates the Lorenz system and bins the trajectory into a density volume
+static vtkSmartPointer<vtkStructuredPoints> SetupDemoVolume()
 {
   double Pr = 10.0; // The Lorenz parameters
   double b = 2.667;
@@ -27,11 +63,6 @@ static vtkSmartPointer<vtkActor> SetupDemoPipeline()
   double zmin = -10.0;
   double zmax = 60.0;
 
-  // take a stab at an integration step size
-  auto xIncr = resolution / (xmax - xmin);
-  auto yIncr = resolution / (ymax - ymin);
-  auto zIncr = resolution / (zmax - zmin);
-
   printf("The Lorenz Attractor\n");
   printf("  Pr = %f\n", Pr);
   printf("  b = %f\n", b);
@@ -49,56 +80,38 @@ static vtkSmartPointer<vtkActor> SetupDemoPipeline()
   z = vtkMath::Random(zmin, zmax);
   printf("  starting at %f, %f, %f\n", x, y, z);
 
-  // allocate memory for the slices
-  auto sliceSize = resolution * resolution;
-  auto numPts = sliceSize * resolution;
-  auto scalars =
-    vtkSmartPointer<vtkShortArray>::New();
-  auto s = scalars->WritePointer(0, numPts);
-  for (auto i = 0; i < numPts; i++)
-  {
-    s[i] = 0;
-  }
-  for (auto j = 0; j < iter; j++)
-  {
-    // integrate to next time step
-    auto xx = x + h * Pr * (y - x);
-    auto yy = y + h * (x * (r - z) - y);
-    auto zz = z + h * (x * y - (b * z));
-
-    x = xx;
-    y = yy;
-    z = zz;
-
-    // calculate voxel index
-    if (x < xmax && x > xmin && y < ymax && y > ymin && z < zmax && z > zmin)
-    {
-      auto xxx = static_cast<short>(static_cast<double>(xx - xmin) * xIncr);
-      auto yyy = static_cast<short>(static_cast<double>(yy - ymin) * yIncr);
-      auto zzz = static_cast<short>(static_cast<double>(zz - zmin) * zIncr);
-      auto index = xxx + yyy * resolution + zzz * sliceSize;
-      s[index] += 1;
-    }
-  }
+  // One lane reproduces the single forward Euler trajectory counted in shorts
+  auto volume =
+    vtkSmartPointer<vtkStructuredPoints>::New();
+  VtkLorenzSystem lorenz;
+  lorenz.sigma = Pr;
+  lorenz.rho = r;
+  lorenz.beta = b;
+  const double bounds[6] = {xmin, xmax, ymin, ymax, zmin, zmax};
+  VtkOdeVolumeEngine<VtkLorenzSystem, VtkEulerIntegrator, double, short, 1> engine(lorenz, resolution, bounds, volume);
+  const double start[3] = {x, y, z};
+  engine.seed(start);
+  engine.run(iter, h);
 
+  return volume;
+}
+
+// Iso-surface of the density volume (CPU contouring on every iso-value change)
+// vtkFlyingEdges3D is used instead of vtkContourFilter: it produces the same surface but its passes
+// are parallelized with vtkSMPTools, so it follows the SMP settings of the VtkViewer rendering it
+static vtkSmartPointer<vtkActor> SetupDemoPipeline(const vtkSmartPointer<vtkStructuredPoints>& volume)
+{
   auto colors =
     vtkSmartPointer<vtkNamedColors>::New();
 
-  auto volume =
-    vtkSmartPointer<vtkStructuredPoints>::New();
-  volume->GetPointData()->SetScalars(scalars);
-  volume->SetDimensions(resolution, resolution, resolution);
-  volume->SetOrigin(xmin, ymin, zmin);
-  volume->SetSpacing((xmax - xmin) / resolution, (ymax - ymin) / resolution,
-    (zmax - zmin) / resolution);
-
   printf("  contouring...\n");
 
   // create iso-surface
   auto contour =
-    vtkSmartPointer<vtkContourFilter>::New();
+    vtkSmartPointer<vtkFlyingEdges3D>::New();
   contour->SetInputData(volume);
   contour->SetValue(0, 50);
+  contour->ComputeNormalsOn();
 
   // create mapper
   auto mapper =
@@ -115,4 +128,783 @@ static vtkSmartPointer<vtkActor> SetupDemoPipeline()
 #endif
 
   return actor;
-}
\ No newline at end of file
+}
+
+static vtkSmartPointer<vtkActor> SetupDemoPipeline()
+{
+  return SetupDemoPipeline(SetupDemoVolume());
+}
+
+// Direct volume rendering of the density volume
+// The GPU path uploads the scalars once as a 3D texture; editing the transfer functions afterwards
+// only refreshes the small transfer function textures. When the context is a software rasterizer
+// (see VtkViewer::IsSoftwareRenderer()), the multithreaded CPU ray caster is used instead.
+static vtkSmartPointer<vtkVolume> SetupDemoVolumeRendering(const vtkSmartPointer<vtkStructuredPoints>& volume, bool useCpuRayCaster)
+{
+  double range[2];
+  volume->GetScalarRange(range);
+
+  // opacity ramps up around the iso-value used by the contour pipeline
+  auto opacity =
+    vtkSmartPointer<vtkPiecewiseFunction>::New();
+  opacity->AddPoint(range[0], 0.0);
+  opacity->AddPoint(10.0, 0.0);
+  opacity->AddPoint(50.0, 0.15);
+  opacity->AddPoint(range[1] > 50.0 ? range[1] : 51.0, 0.8);
+
+  auto color =
+    vtkSmartPointer<vtkColorTransferFunction>::New();
+  color->AddRGBPoint(range[0], 0.0, 0.0, 0.3);
+  color->AddRGBPoint(50.0, 0.69, 0.93, 0.93); // PaleTurquoise, like the iso-surface
+  color->AddRGBPoint(range[1] > 50.0 ? range[1] : 51.0, 1.0, 1.0, 1.0);
+
+  auto property =
+    vtkSmartPointer<vtkVolumeProperty>::New();
+  property->SetScalarOpacity(opacity);
+  property->SetColor(color);
+  property->SetInterpolationTypeToLinear();
+  property->ShadeOff();
+
+  auto mapper =
+    vtkSmartPointer<vtkSmartVolumeMapper>::New();
+  mapper->SetInputData(volume);
+  if (useCpuRayCaster){
+    // vtkFixedPointVolumeRayCastMapper, split across vtkMultiThreader threads
+    mapper->SetRequestedRenderModeToRayCast();
+  }
+  else{
+    mapper->SetRequestedRenderModeToGPU();
+  }
+
+  auto prop =
+    vtkSmartPointer<vtkVolume>::New();
+  prop->SetMapper(mapper);
+  prop->SetProperty(property);
+
+  printf("  volume rendering: %s\n", useCpuRayCaster ? "CPU ray cast" : "GPU ray cast");
+
+  return prop;
+}
+
+static const char* DemoVolumeRenderPath(vtkVolume* volume)
+{
+  auto mapper = vtkSmartVolumeMapper::SafeDownCast(volume->GetMapper());
+  if (!mapper){
+    return "Unknown";
+  }
+  switch (mapper->GetLastUsedRenderMode()){
+  case vtkSmartVolumeMapper::GPURenderMode:
+    return "GPU ray cast (3D texture)";
+  case vtkSmartVolumeMapper::RayCastRenderMode:
+    return "CPU ray cast";
+  default:
+    return "Not rendered yet";
+  }
+}
+
+// ImGui editor for the opacity and color transfer functions of a volume
+// Returns true when a transfer function was modified
+static bool DemoTransferFunctionEditor(vtkVolumeProperty* property)
+{
+  bool changed = false;
+  auto opacity = property->GetScalarOpacity();
+  auto color = property->GetRGBTransferFunction();
+
+  double range[2];
+  opacity->GetRange(range);
+
+  // preview of the opacity curve
+  float curve[128];
+  double table[128];
+  opacity->GetTable(range[0], range[1], 128, table);
+  for (int i = 0; i < 128; i++){
+    curve[i] = static_cast<float>(table[i]);
+  }
+  ImGui::PlotLines("Opacity", curve, 128, 0, nullptr, 0.0f, 1.0f, ImVec2(0, 60));
+
+  if (ImGui::TreeNode("Opacity points")){
+    for (int i = 0; i < opacity->GetSize(); i++){
+      double node[4]; // x, y, midpoint, sharpness
+      opacity->GetNodeValue(i, node);
+      float xy[2] = {static_cast<float>(node[0]), static_cast<float>(node[1])};
+      ImGui::PushID(i);
+      if (ImGui::DragFloat2("##point", xy, 0.5f)){
+        node[0] = xy[0];
+        node[1] = xy[1] < 0.0f ? 0.0 : (xy[1] > 1.0f ? 1.0 : xy[1]);
+        opacity->SetNodeValue(i, node);
+        changed = true;
+      }
+      ImGui::SameLine();
+      if (opacity->GetSize() > 2 && ImGui::SmallButton("x")){
+        opacity->RemovePoint(node[0]);
+        changed = true;
+        ImGui::PopID();
+        break;
+      }
+      ImGui::PopID();
+    }
+    if (ImGui::SmallButton("Add opacity point")){
+      opacity->AddPoint(0.5 * (range[0] + range[1]), 0.5);
+      changed = true;
+    }
+    ImGui::TreePop();
+  }
+
+  if (ImGui::TreeNode("Color points")){
+    for (int i = 0; i < color->GetSize(); i++){
+      double node[6]; // x, r, g, b, midpoint, sharpness
+      color->GetNodeValue(i, node);
+      float x = static_cast<float>(node[0]);
+      float rgb[3] = {static_cast<float>(node[1]), static_cast<float>(node[2]), static_cast<float>(node[3])};
+      ImGui::PushID(i);
+      ImGui::SetNextItemWidth(80.0f);
+      bool edited = ImGui::DragFloat("##x", &x, 0.5f);
+      ImGui::SameLine();
+      edited |= ImGui::ColorEdit3("##rgb", rgb, ImGuiColorEditFlags_NoInputs);
+      if (edited){
+        node[0] = x;
+        node[1] = rgb[0];
+        node[2] = rgb[1];
+        node[3] = rgb[2];
+        color->SetNodeValue(i, node);
+        changed = true;
+      }
+      ImGui::PopID();
+    }
+    if (ImGui::SmallButton("Add color point")){
+      color->AddRGBPoint(0.5 * (range[0] + range[1]), 1.0, 1.0, 1.0);
+      changed = true;
+    }
+    ImGui::TreePop();
+  }
+
+  return changed;
+}
+
+// Times the demo contour (vtkFlyingEdges3D) with 1..maxThreads SMP threads on the current backend
+// Returns the best of `repeats` runs for each thread count, in ms (index 0 = 1 thread)
+static std::vector<double> BenchmarkDemoContour(const vtkSmartPointer<vtkStructuredPoints>& volume, int maxThreads, int repeats = 3)
+{
+  std::vector<double> timings;
+  if (maxThreads <= 0){
+    maxThreads = vtkSMPTools::GetEstimatedNumberOfThreads();
+  }
+
+#if VTK_MAJOR_VERSION > 9 || (VTK_MAJOR_VERSION == 9 && VTK_MINOR_VERSION >= 1)
+  printf("Contour benchmark (backend: %s)\n", vtkSMPTools::GetBackend());
+#else
+  printf("Contour benchmark\n");
+#endif
+  auto bestOfRepeats = [&volume, repeats](){
+    double best = -1.0;
+    for (int r = 0; r < repeats; r++){
+      auto contour =
+        vtkSmartPointer<vtkFlyingEdges3D>::New();
+      contour->SetInputData(volume);
+      contour->SetValue(0, 50);
+      contour->ComputeNormalsOn();
+
+      auto start = std::chrono::steady_clock::now();
+      contour->Update();
+      double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+      best = best < 0.0 ? ms : std::min(best, ms);
+    }
+    return best;
+  };
+
+  // The thread count is process-wide: scoped where VTK allows it, restored afterwards otherwise, so the
+  // viewers' own SMP settings (VtkViewer::setSMPThreads) aren't overridden for the rest of the session
+#if VTK_MAJOR_VERSION > 9 || (VTK_MAJOR_VERSION == 9 && VTK_MINOR_VERSION >= 2)
+  for (int threads = 1; threads <= maxThreads; threads++){
+    vtkSMPTools::Config config;
+    config.MaxNumberOfThreads = threads;
+    double best = 0.0;
+    vtkSMPTools::LocalScope(config, [&best, &bestOfRepeats](){ best = bestOfRepeats(); });
+    timings.push_back(best);
+    printf("  %2d threads: %8.2f ms (speedup %.2fx)\n", threads, best, timings.front() / best);
+  }
+#else
+  const int previousThreads = vtkSMPTools::GetEstimatedNumberOfThreads();
+  for (int threads = 1; threads <= maxThreads; threads++){
+    vtkSMPTools::Initialize(threads);
+    const double best = bestOfRepeats();
+    timings.push_back(best);
+    printf("  %2d threads: %8.2f ms (speedup %.2fx)\n", threads, best, timings.front() / best);
+  }
+  vtkSMPTools::Initialize(previousThreads);
+#endif
+
+  return timings;
+}
+
+struct DemoAntiAliasingTiming
+{
+  const char* mode;
+  int samples; // what the viewer ended up with after clamping to GL_MAX_SAMPLES
+  double ms; // average render time
+};
+
+// Times renders of the viewer's scene without anti-aliasing, with FXAA and with MSAA 2x/4x/8x at the given size.
+// The camera turns a little before every frame so each one really renders; one untimed frame per mode absorbs
+// the framebuffer rebuild. Needs the ImGui context current and a viewer that isn't threaded.
+static std::vector<DemoAntiAliasingTiming> BenchmarkDemoAntiAliasing(VtkViewer& viewer, unsigned int width, unsigned int height, int frames = 30)
+{
+  struct Mode { const char* name; bool fxaa; int samples; };
+  const Mode modes[] = {{"None", false, 0}, {"FXAA", true, 0}, {"MSAA 2x", false, 2}, {"MSAA 4x", false, 4}, {"MSAA 8x", false, 8}};
+  const int savedSamples = viewer.getMultiSamples();
+  const bool savedFXAA = viewer.getFXAA();
+  vtkCamera* camera = viewer.getRenderer()->GetActiveCamera();
+
+  std::vector<DemoAntiAliasingTiming> timings;
+  printf("Anti-aliasing benchmark (%u x %u, %s renderer)\n", width, height, VtkViewer::IsSoftwareRenderer() ? "software" : "hardware");
+  for (const Mode& mode : modes){
+    viewer.setFXAA(mode.fxaa);
+    viewer.setMultiSamples(mode.samples);
+    viewer.requestRedraw();
+    viewer.renderToTexture(width, height);
+
+    double total = 0.0;
+    for (int f = 0; f < frames; f++){
+      camera->Azimuth(360.0 / frames); // a full turn, the view ends where it started
+      viewer.renderToTexture(width, height);
+      total += viewer.getLastRenderTime();
+    }
+    timings.push_back({mode.name, viewer.getMultiSamples(), total / frames});
+    printf("  %-8s %8.2f ms (%d samples)\n", mode.name, timings.back().ms, timings.back().samples);
+  }
+
+  viewer.setFXAA(savedFXAA);
+  viewer.setMultiSamples(savedSamples);
+  viewer.requestRedraw();
+  return timings;
+}
+
+// Concentric translucent spheres: every pixel in the middle of the view is covered by 2 x layers surfaces
+static vtkSmartPointer<vtkPropCollection> SetupDemoTranslucentLayers(int layers)
+{
+  auto colors = vtkSmartPointer<vtkNamedColors>::New();
+  const char* names[] = {"Tomato", "Gold", "LimeGreen", "DodgerBlue", "Orchid", "Turquoise"};
+  auto props = vtkSmartPointer<vtkPropCollection>::New();
+  for (int i = 0; i < layers; i++){
+    auto sphere = vtkSmartPointer<vtkSphereSource>::New();
+    sphere->SetRadius(1.0 + i * 0.25);
+    sphere->SetThetaResolution(64);
+    sphere->SetPhiResolution(64);
+
+    auto mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+    mapper->SetInputConnection(sphere->GetOutputPort());
+    auto actor = vtkSmartPointer<vtkActor>::New();
+    actor->SetMapper(mapper);
+    actor->GetProperty()->SetColor(colors->GetColor3d(names[i % IM_ARRAYSIZE(names)]).GetData());
+    actor->GetProperty()->SetOpacity(0.3);
+    props->AddItem(actor);
+  }
+  return props;
+}
+
+struct DemoTransparencyTiming
+{
+  const char* mode;
+  int peels; // peel count in use at the end, depth peeling modes only
+  double ms; // average render time
+};
+
+// Times renders of the viewer's scene in every VtkViewer::TransparencyMode, turning the camera before each frame
+// (DepthSort re-sorts, AdaptivePeeling adapts). Needs the ImGui context current and a viewer that isn't threaded.
+static std::vector<DemoTransparencyTiming> BenchmarkDemoTransparency(VtkViewer& viewer, unsigned int width, unsigned int height, int frames = 30)
+{
+  struct Mode { const char* name; VtkViewer::TransparencyMode mode; };
+  const Mode modes[] = {
+    {"Unsorted", VtkViewer::TransparencyMode::Unsorted},
+    {"Depth peeling", VtkViewer::TransparencyMode::DepthPeeling},
+    {"Adaptive peeling", VtkViewer::TransparencyMode::AdaptivePeeling},
+    {"Weighted blended", VtkViewer::TransparencyMode::WeightedBlended},
+    {"Depth sort", VtkViewer::TransparencyMode::DepthSort}
+  };
+  const VtkViewer::TransparencyMode savedMode = viewer.getTransparencyMode();
+  vtkCamera* camera = viewer.getRenderer()->GetActiveCamera();
+
+  std::vector<DemoTransparencyTiming> timings;
+  printf("Transparency benchmark (%u x %u, %s renderer)\n", width, height, VtkViewer::IsSoftwareRenderer() ? "software" : "hardware");
+  for (const Mode& mode : modes){
+    viewer.setTransparencyMode(mode.mode);
+    viewer.renderToTexture(width, height); // builds passes and sorters, not timed
+
+    double total = 0.0;
+    for (int f = 0; f < frames; f++){
+      camera->Azimuth(360.0 / frames);
+      viewer.renderToTexture(width, height);
+      total += viewer.getLastRenderTime();
+    }
+    const bool peeling = mode.mode == VtkViewer::TransparencyMode::DepthPeeling || mode.mode == VtkViewer::TransparencyMode::AdaptivePeeling;
+    timings.push_back({mode.name, peeling ? viewer.getPeelCount() : 0, total / frames});
+    printf("  %-16s %8.2f ms (%d peels)\n", mode.name, timings.back().ms, timings.back().peels);
+  }
+
+  viewer.setTransparencyMode(savedMode);
+  return timings;
+}
+
+// side x side grid of small boxes ("sensors"), colored by position
+static void SetupDemoInstanceGrid(int side, std::vector<VtkInstanceTransform>& transforms, std::vector<unsigned char>& colors)
+{
+  transforms.resize(static_cast<size_t>(side) * side);
+  colors.resize(transforms.size() * 4);
+  for (int y = 0; y < side; y++){
+    for (int x = 0; x < side; x++){
+      const size_t i = static_cast<size_t>(y) * side + x;
+      VtkInstanceTransform& transform = transforms[i];
+      transform.position[0] = static_cast<float>(x);
+      transform.position[1] = static_cast<float>(y);
+      transform.position[2] = 0.0f;
+      transform.orientation[0] = 1.0f;
+      transform.orientation[1] = transform.orientation[2] = transform.orientation[3] = 0.0f;
+      transform.scale[0] = transform.scale[1] = 0.6f;
+      transform.scale[2] = 0.3f;
+      colors[i * 4 + 0] = static_cast<unsigned char>(255 * x / std::max(1, side - 1));
+      colors[i * 4 + 1] = static_cast<unsigned char>(255 * y / std::max(1, side - 1));
+      colors[i * 4 + 2] = 160;
+      colors[i * 4 + 3] = 255;
+    }
+  }
+}
+
+// Moves the grid's boxes up and down in place, only the position array is written
+static void AnimateDemoInstances(VtkInstancedGlyphs& instances, int side, double time)
+{
+  float* positions = instances.positions();
+  for (vtkIdType i = 0; i < instances.size(); i++){
+    const double x = static_cast<double>(i % side), y = static_cast<double>(i / side);
+    positions[i * 3 + 2] = static_cast<float>(std::sin(0.3 * x + time) * std::cos(0.3 * y + time));
+  }
+  instances.positionsModified();
+}
+
+struct DemoTransformTiming
+{
+  double perActorMs; // SetPosition + SetOrientation on every actor, per frame
+  double batchMs; // one VtkViewer::setTransforms call, per frame
+};
+
+// Moves `count` actors to the same poses `frames` times through both paths: actor i at (0.01 i, 0.1 f, 0),
+// rotated f degrees about x. Both fill the same packed arrays and include the prop matrix rebuild VTK does
+// before drawing (GetMatrix()); nothing is rendered.
+static DemoTransformTiming BenchmarkDemoTransforms(int count, int frames = 20)
+{
+  auto source = vtkSmartPointer<vtkCubeSource>::New();
+  auto mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+  mapper->SetInputConnection(source->GetOutputPort());
+  std::vector<vtkSmartPointer<vtkProp3D>> props;
+  for (int i = 0; i < count; i++){
+    auto actor = vtkSmartPointer<vtkActor>::New();
+    actor->SetMapper(mapper);
+    props.push_back(actor);
+  }
+
+  std::vector<float> positions(static_cast<size_t>(count) * 3), orientations(static_cast<size_t>(count) * 4);
+  auto fillPoses = [&](int f){
+    const double angle = vtkMath::RadiansFromDegrees(f * 1.0) / 2.0;
+    for (int i = 0; i < count; i++){
+      positions[i * 3 + 0] = i * 0.01f;
+      positions[i * 3 + 1] = f * 0.1f;
+      positions[i * 3 + 2] = 0.0f;
+      orientations[i * 4 + 0] = static_cast<float>(std::cos(angle));
+      orientations[i * 4 + 1] = static_cast<float>(std::sin(angle));
+      orientations[i * 4 + 2] = orientations[i * 4 + 3] = 0.0f;
+    }
+  };
+  DemoTransformTiming timing = {0.0, 0.0};
+
+  auto start = std::chrono::steady_clock::now();
+  for (int f = 0; f < frames; f++){
+    fillPoses(f);
+    for (int i = 0; i < count; i++){
+      const float* p = &positions[i * 3];
+      props[i]->SetPosition(p[0], p[1], p[2]);
+      props[i]->SetOrientation(f * 1.0, 0.0, 0.0); // the quaternion's rotation about x
+      props[i]->GetMatrix();
+    }
+  }
+  timing.perActorMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+
+  // Back to identity so the user matrices carry the whole pose
+  for (auto& prop : props){
+    prop->SetPosition(0.0, 0.0, 0.0);
+    prop->SetOrientation(0.0, 0.0, 0.0);
+  }
+  VtkViewer viewer; // only used for setTransforms(), never rendered
+  start = std::chrono::steady_clock::now();
+  for (int f = 0; f < frames; f++){
+    fillPoses(f);
+    viewer.setTransforms(props, positions, orientations);
+    for (int i = 0; i < count; i++){
+      props[i]->GetMatrix();
+    }
+  }
+  timing.batchMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / frames;
+
+  printf("Transform benchmark (%d actors, same poses): SetPosition/SetOrientation %.3f ms, setTransforms %.3f ms per frame\n",
+    count, timing.perActorMs, timing.batchMs);
+  return timing;
+}
+
+// Lorenz system state for the live trajectory, same parameters as SetupDemoVolume
+struct DemoLorenzState
+{
+  double x, y, z;
+};
+
+// One explicit Euler step of the Lorenz system (x, y, z)
+static void StepDemoLorenz(double state[3], double h)
+{
+  VtkEulerIntegrator::step(VtkLorenzSystem(), state[0], state[1], state[2], h);
+}
+
+// Appends `steps` integration steps of the trajectory to points (x, y, z floats)
+static void IntegrateDemoLorenz(DemoLorenzState& state, int steps, std::vector<float>& points, double h = 0.002)
+{
+  for (int i = 0; i < steps; i++){
+    double xyz[3] = {state.x, state.y, state.z};
+    StepDemoLorenz(xyz, h);
+    state.x = xyz[0];
+    state.y = xyz[1];
+    state.z = xyz[2];
+    points.push_back(static_cast<float>(state.x));
+    points.push_back(static_cast<float>(state.y));
+    points.push_back(static_cast<float>(state.z));
+  }
+}
+
+// Body of a data-acquisition style thread feeding a viewer through VtkViewer::post(): every periodMs it builds a
+// new sphere orbiting `center` on its own thread and posts it, with a color change, until `running` is cleared.
+// Its actor is added with the first command and removed with the last.
+static void RunDemoProducer(VtkViewer& viewer, const std::atomic<bool>& running, const double center[3], double radius, int periodMs = 20)
+{
+  auto mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+  auto actor = vtkSmartPointer<vtkActor>::New();
+  actor->SetMapper(mapper);
+  viewer.postAddActor(actor);
+
+  const double c[3] = {center[0], center[1], center[2]};
+  for (int step = 0; running; step++){
+    const double t = step * periodMs / 1000.0;
+    auto sphere = vtkSmartPointer<vtkSphereSource>::New();
+    sphere->SetCenter(c[0] + radius * std::cos(t), c[1] + radius * std::sin(t), c[2]);
+    sphere->SetRadius(radius * (0.15 + 0.05 * std::sin(3.0 * t)));
+    sphere->SetThetaResolution(8 + step % 32);
+    sphere->SetPhiResolution(8 + step % 32);
+    sphere->Update();
+    // Detached from the source, which goes away with this iteration
+    auto data = vtkSmartPointer<vtkPolyData>::New();
+    data->ShallowCopy(sphere->GetOutput());
+
+    viewer.postInputData(mapper, data);
+    viewer.postProperty(actor, [t](vtkProperty* property){
+      property->SetColor(0.5 + 0.5 * std::sin(t), 0.5 + 0.5 * std::cos(t), 0.8);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(periodMs));
+  }
+  viewer.postRemoveActor(actor);
+}
+
+struct DemoSparseVolumeTiming
+{
+  size_t sparseBytes, denseBytes;
+  int allocatedBricks, bricks;
+  double sparseVoxelizeMs, sparseContourMs;
+  double denseVoxelizeMs, denseContourMs; // 0 when the dense path was skipped
+  vtkIdType sparseTriangles, denseTriangles;
+};
+
+// Voxelizes `steps` Lorenz steps at resolution^3 into a VtkSparseBrickVolume and, if `dense`, into a dense
+// short vtkImageData (resolution^3 * 2 bytes), then contours both at isoValue
+static DemoSparseVolumeTiming BenchmarkDemoSparseVolume(int resolution, int steps, double isoValue, bool dense)
+{
+  const double bounds[6] = {-30.0, 30.0, -30.0, 30.0, -10.0, 60.0}; // as in SetupDemoVolume
+  const double h = 0.01;
+  DemoSparseVolumeTiming timing = {};
+
+  VtkSparseBrickVolume sparse(resolution, bounds);
+  double state[3] = {1.0, 1.0, 1.0};
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < steps; i++){
+    StepDemoLorenz(state, h);
+    int voxel[3];
+    if (sparse.voxelOf(state, voxel)){
+      sparse.increment(voxel[0], voxel[1], voxel[2]);
+    }
+  }
+  timing.sparseVoxelizeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  vtkSmartPointer<vtkPolyData> sparseSurface = sparse.contour(isoValue);
+  timing.sparseContourMs = sparse.getContourStats().time;
+  timing.sparseTriangles = sparseSurface->GetNumberOfPolys();
+  timing.sparseBytes = sparse.getMemoryBytes();
+  timing.denseBytes = sparse.getDenseBytes();
+  timing.allocatedBricks = sparse.getAllocatedBricks();
+  timing.bricks = sparse.getBrickCount();
+  printf("Sparse volume %d^3: %d of %d bricks, %.1f MB (dense %.1f MB), voxelize %.1f ms, contour %.1f ms (%lld triangles)\n",
+    resolution, timing.allocatedBricks, timing.bricks, timing.sparseBytes / 1048576.0, timing.denseBytes / 1048576.0,
+    timing.sparseVoxelizeMs, timing.sparseContourMs, static_cast<long long>(timing.sparseTriangles));
+
+  if (dense){
+    auto image = vtkSmartPointer<vtkImageData>::New();
+    image->SetDimensions(resolution, resolution, resolution);
+    image->SetOrigin(bounds[0], bounds[2], bounds[4]);
+    image->SetSpacing((bounds[1] - bounds[0]) / resolution, (bounds[3] - bounds[2]) / resolution, (bounds[5] - bounds[4]) / resolution);
+    start = std::chrono::steady_clock::now();
+    image->AllocateScalars(VTK_SHORT, 1);
+    short* voxels = static_cast<short*>(image->GetScalarPointer());
+    const size_t slice = static_cast<size_t>(resolution) * resolution;
+    std::fill(voxels, voxels + slice * resolution, static_cast<short>(0));
+    state[0] = state[1] = state[2] = 1.0;
+    for (int i = 0; i < steps; i++){
+      StepDemoLorenz(state, h);
+      int voxel[3];
+      if (sparse.voxelOf(state, voxel)){
+        short& v = voxels[voxel[0] + static_cast<size_t>(voxel[1]) * resolution + voxel[2] * slice];
+        if (v < SHRT_MAX){
+          v++;
+        }
+      }
+    }
+    timing.denseVoxelizeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    auto contour = vtkSmartPointer<vtkFlyingEdges3D>::New();
+    contour->SetInputData(image);
+    contour->SetValue(0, isoValue);
+    contour->ComputeNormalsOn();
+    start = std::chrono::steady_clock::now();
+    contour->Update();
+    timing.denseContourMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    timing.denseTriangles = contour->GetOutput()->GetNumberOfPolys();
+    printf("Dense volume %d^3: voxelize %.1f ms (including allocation), contour %.1f ms (%lld triangles)\n",
+      resolution, timing.denseVoxelizeMs, timing.denseContourMs, static_cast<long long>(timing.denseTriangles));
+  }
+  return timing;
+}
+
+struct DemoOdeTiming
+{
+  const char* name;
+  double ms;
+  double stepsPerSecond;
+  long long counted; // samples inside the volume
+};
+
+template <typename System, typename Integrator, typename Real, typename Count, int Lanes>
+static DemoOdeTiming TimeDemoOdeEngine(const char* name, const System& system, const double bounds[6], long long steps, double h)
+{
+  VtkOdeVolumeEngine<System, Integrator, Real, Count, Lanes> engine(system, 200, bounds);
+  engine.run(Lanes * 1000, h); // settle onto the attractor
+  engine.clear();
+  const auto start = std::chrono::steady_clock::now();
+  const long long counted = engine.run(steps, h);
+  const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  printf("  %-40s %8.1f ms %8.1f M steps/s\n", name, ms, steps / ms / 1000.0);
+  return {name, ms, steps / ms * 1000.0, counted};
+}
+
+// Each specialization of VtkOdeVolumeEngine integrating `steps` samples into a 200^3 volume; the first one is
+// the loop SetupDemoVolume used to hardcode
+static std::vector<DemoOdeTiming> BenchmarkDemoOdeEngines(long long steps = 10000000)
+{
+  const double lorenzBounds[6] = {-30.0, 30.0, -30.0, 30.0, -10.0, 60.0};
+  const double rosslerBounds[6] = {-15.0, 15.0, -15.0, 15.0, -5.0, 30.0};
+  const double thomasBounds[6] = {-5.0, 5.0, -5.0, 5.0, -5.0, 5.0};
+  VtkLorenzSystem lorenz;
+  VtkRosslerSystem rossler;
+  VtkThomasSystem thomas;
+
+  printf("ODE volume engines (%lld steps):\n", steps);
+  std::vector<DemoOdeTiming> timings;
+  timings.push_back(TimeDemoOdeEngine<VtkLorenzSystem, VtkEulerIntegrator, double, short, 1>(
+    "Lorenz Euler double/short, 1 lane", lorenz, lorenzBounds, steps, 0.01));
+  timings.push_back(TimeDemoOdeEngine<VtkLorenzSystem, VtkEulerIntegrator, double, short, 8>(
+    "Lorenz Euler double/short, 8 lanes", lorenz, lorenzBounds, steps, 0.01));
+  timings.push_back(TimeDemoOdeEngine<VtkLorenzSystem, VtkEulerIntegrator, float, short, 8>(
+    "Lorenz Euler float/short, 8 lanes", lorenz, lorenzBounds, steps, 0.01));
+  timings.push_back(TimeDemoOdeEngine<VtkLorenzSystem, VtkRk4Integrator, double, float, 8>(
+    "Lorenz RK4 double/float, 8 lanes", lorenz, lorenzBounds, steps, 0.01));
+  timings.push_back(TimeDemoOdeEngine<VtkLorenzSystem, VtkRk4Integrator, float, unsigned short, 8>(
+    "Lorenz RK4 float/ushort, 8 lanes", lorenz, lorenzBounds, steps, 0.01));
+  timings.push_back(TimeDemoOdeEngine<VtkRosslerSystem, VtkRk4Integrator, float, int, 8>(
+    "Rossler RK4 float/int, 8 lanes", rossler, rosslerBounds, steps, 0.02));
+  timings.push_back(TimeDemoOdeEngine<VtkThomasSystem, VtkRk4Integrator, float, float, 8>(
+    "Thomas RK4 float/float, 8 lanes", thomas, thomasBounds, steps, 0.05));
+  return timings;
+}
+
+// ABC (Arnold-Beltrami-Childress) flow sampled on resolution^3 points over [0, 2 pi]^3: a steady 3D vector field
+// with chaotic streamlines, as point vectors of a vtkImageData
+static vtkSmartPointer<vtkImageData> SetupDemoVectorField(int resolution, double a = std::sqrt(3.0), double b = std::sqrt(2.0), double c = 1.0)
+{
+  const double spacing = 2.0 * vtkMath::Pi() / (resolution - 1);
+  auto field = vtkSmartPointer<vtkImageData>::New();
+  field->SetDimensions(resolution, resolution, resolution);
+  field->SetOrigin(0.0, 0.0, 0.0);
+  field->SetSpacing(spacing, spacing, spacing);
+
+  auto velocity = vtkSmartPointer<vtkFloatArray>::New();
+  velocity->SetName("velocity");
+  velocity->SetNumberOfComponents(3);
+  velocity->SetNumberOfTuples(static_cast<vtkIdType>(resolution) * resolution * resolution);
+  float* v = velocity->GetPointer(0);
+  for (int k = 0; k < resolution; k++){
+    const double z = k * spacing;
+    for (int j = 0; j < resolution; j++){
+      const double y = j * spacing;
+      for (int i = 0; i < resolution; i++){
+        const double x = i * spacing;
+        *v++ = static_cast<float>(a * std::sin(z) + c * std::cos(y));
+        *v++ = static_cast<float>(b * std::sin(x) + a * std::cos(z));
+        *v++ = static_cast<float>(c * std::sin(y) + b * std::cos(x));
+      }
+    }
+  }
+  field->GetPointData()->SetVectors(velocity);
+  return field;
+}
+
+// Outline of a field's bounds and a translucent plane through its middle to pick seed points on
+static vtkSmartPointer<vtkPropCollection> SetupDemoSeedPlane(vtkImageData* field)
+{
+  double bounds[6];
+  field->GetBounds(bounds);
+  auto props = vtkSmartPointer<vtkPropCollection>::New();
+
+  auto outline = vtkSmartPointer<vtkOutlineFilter>::New();
+  outline->SetInputData(field);
+  auto outlineMapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+  outlineMapper->SetInputConnection(outline->GetOutputPort());
+  auto outlineActor = vtkSmartPointer<vtkActor>::New();
+  outlineActor->SetMapper(outlineMapper);
+  outlineActor->PickableOff();
+  props->AddItem(outlineActor);
+
+  const double zMiddle = (bounds[4] + bounds[5]) / 2.0;
+  auto plane = vtkSmartPointer<vtkPlaneSource>::New();
+  plane->SetOrigin(bounds[0], bounds[2], zMiddle);
+  plane->SetPoint1(bounds[1], bounds[2], zMiddle);
+  plane->SetPoint2(bounds[0], bounds[3], zMiddle);
+  auto planeMapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+  planeMapper->SetInputConnection(plane->GetOutputPort());
+  auto planeActor = vtkSmartPointer<vtkActor>::New();
+  planeActor->SetMapper(planeMapper);
+  planeActor->GetProperty()->SetColor(0.4, 0.6, 0.9);
+  planeActor->GetProperty()->SetOpacity(0.2);
+  props->AddItem(planeActor);
+  return props;
+}
+
+// size x size 12-bit image (0..4095 in unsigned shorts, like CT or microscopy data): soft discs of different
+// intensities over a gradient, with a little deterministic noise so every window setting shows texture
+static vtkSmartPointer<vtkImageData> SetupDemo16BitImage(int size)
+{
+  auto image = vtkSmartPointer<vtkImageData>::New();
+  image->SetDimensions(size, size, 1);
+  auto values = vtkSmartPointer<vtkUnsignedShortArray>::New();
+  values->SetName("intensity");
+  values->SetNumberOfTuples(static_cast<vtkIdType>(size) * size);
+  unsigned short* v = values->GetPointer(0);
+  const double discs[4][4] = { // x, y, radius (fractions of the size), intensity
+    {0.3, 0.3, 0.18, 3000.0}, {0.7, 0.35, 0.12, 1800.0}, {0.5, 0.7, 0.22, 900.0}, {0.75, 0.75, 0.06, 4000.0}
+  };
+  unsigned int noise = 12345u;
+  for (int j = 0; j < size; j++){
+    for (int i = 0; i < size; i++){
+      const double x = i / (size - 1.0), y = j / (size - 1.0);
+      double value = 400.0 * x + 200.0 * y;
+      for (const auto& disc : discs){
+        const double d = std::hypot(x - disc[0], y - disc[1]) / disc[2];
+        value += disc[3] / (1.0 + std::pow(d, 8.0)); // flat top, soft edge
+      }
+      noise = noise * 1664525u + 1013904223u;
+      value += ((noise >> 16) & 0xff) - 128.0;
+      *v++ = static_cast<unsigned short>(std::max(0.0, std::min(4095.0, value)));
+    }
+  }
+  image->GetPointData()->SetScalars(values);
+  return image;
+}
+
+struct DemoWindowLevelTiming
+{
+  const char* path;
+  double ms; // average render time of a frame that changed the window
+};
+
+// Times contrast changes on the same image shown by a vtkImageActor (window/level and lookup table applied on the
+// CPU, then the colors uploaded) and by a VtkWindowLevelImageMapper actor (uniforms only): only one of the two is
+// visible at a time and every frame sets a new window. Needs the ImGui context current and a viewer that isn't
+// threaded; restores both actors' visibility and the window/level.
+static std::vector<DemoWindowLevelTiming> BenchmarkDemoWindowLevel(VtkViewer& viewer, vtkImageActor* cpuActor, vtkActor* gpuActor,
+  unsigned int width, unsigned int height, int frames = 60)
+{
+  auto gpuMapper = VtkWindowLevelImageMapper::SafeDownCast(gpuActor->GetMapper());
+  vtkImageProperty* cpuProperty = cpuActor->GetProperty();
+  const double savedWindow = cpuProperty->GetColorWindow(), savedLevel = cpuProperty->GetColorLevel();
+  const int savedCpuVisibility = cpuActor->GetVisibility(), savedGpuVisibility = gpuActor->GetVisibility();
+
+  std::vector<DemoWindowLevelTiming> timings;
+  printf("Window/level benchmark (%u x %u, %s renderer)\n", width, height, VtkViewer::IsSoftwareRenderer() ? "software" : "hardware");
+  for (int gpu = 0; gpu < 2; gpu++){
+    cpuActor->SetVisibility(!gpu);
+    gpuActor->SetVisibility(gpu);
+    viewer.renderToTexture(width, height); // first upload, not timed
+
+    double total = 0.0;
+    for (int f = 0; f < frames; f++){
+      const double window = savedWindow * (0.5 + f / static_cast<double>(frames)); // a new window every frame
+      if (gpu){
+        gpuMapper->SetWindow(window);
+      }
+      else{
+        cpuProperty->SetColorWindow(window);
+      }
+      viewer.renderToTexture(width, height);
+      total += viewer.getLastRenderTime();
+    }
+    timings.push_back({gpu ? "GPU shader" : "CPU vtkImageActor", total / frames});
+    printf("  %-18s %8.2f ms per contrast change\n", timings.back().path, timings.back().ms);
+  }
+
+  cpuProperty->SetColorWindow(savedWindow);
+  cpuProperty->SetColorLevel(savedLevel);
+  gpuMapper->SetWindow(savedWindow);
+  gpuMapper->SetLevel(savedLevel);
+  cpuActor->SetVisibility(savedCpuVisibility);
+  gpuActor->SetVisibility(savedGpuVisibility);
+  viewer.requestRedraw();
+  return timings;
+}
+
+// Writes a size x size RGB tile pyramid of a synthetic image with detail at every zoom level: a color gradient
+// under grid lines every 4096, 512 and 64 pixels and an 8-pixel checkerboard. Only one strip of rows is in
+// memory at a time, so sizes far beyond a texture (or RAM) work. Throws VtkViewerError if the file can't be written.
+static void BuildDemoTilePyramid(const std::string& path, int size, VtkTileCodec codec = VtkTileCodec::Jpeg)
+{
+  const auto start = std::chrono::steady_clock::now();
+  VtkTilePyramid::build(path, size, size, 3, [size](int firstRow, int rows, unsigned char* pixels){
+    for (int y = firstRow; y < firstRow + rows; y++){
+      for (int x = 0; x < size; x++){
+        int rgb[3] = {static_cast<int>(255LL * x / size), static_cast<int>(255LL * y / size), 128};
+        int shade = ((x / 8 + y / 8) % 2) ? 12 : -12;
+        if (x % 4096 < 16 || y % 4096 < 16){
+          rgb[0] = rgb[1] = rgb[2] = 255;
+          shade = 0;
+        }
+        else if (x % 512 < 4 || y % 512 < 4){
+          rgb[0] = rgb[1] = rgb[2] = 200;
+        }
+        else if (x % 64 == 0 || y % 64 == 0){
+          shade -= 80;
+        }
+        for (int c = 0; c < 3; c++){
+          *pixels++ = static_cast<unsigned char>(std::max(0, std::min(255, rgb[c] + shade)));
+        }
+      }
+    }
+  }, 256, codec);
+  printf("Tile pyramid %s (%d x %d) written in %.1f s\n", path.c_str(), size, size,
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+}
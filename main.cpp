@@ -1,5 +1,14 @@
 // Standard Library
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <exception>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
 // OpenGL Loader
 // This can be replaced with another loader, e.g. glad, but
@@ -14,10 +23,30 @@
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_opengl3.h"
 #include "VtkViewer.h"
+#include "VtkCompactPolyDataMapper.h"
+#include "VtkLodManager.h"
+#include "VtkFramePacer.h"
+#include "VtkViewerPool.h"
+#include "VtkOrientationMarker.h"
+#include "VtkInstancedGlyphs.h"
+#include "VtkStreamingPolylineMapper.h"
+#include "VtkLiveDensityVolume.h"
+#include "VtkParticleTracer.h"
+#include "VtkMprReslicer.h"
+#include "VtkWindowLevelImageMapper.h"
+#include "VtkTiledImageMapper.h"
 
 // VTK
 #include <vtkSmartPointer.h>
 #include <vtkActor.h>
+#include <vtkCamera.h>
+#include <vtkCubeSource.h>
+#include <vtkImageProperty.h>
+#include <vtkInteractorStyleImage.h>
+#include <vtkLookupTable.h>
+#include <vtkProperty.h>
+#include <vtkTextActor.h>
+#include <vtkTextProperty.h>
 
 // File-Specific Includes
 #include "imgui_vtk_demo.h" // Actor generator for this demo
@@ -30,7 +59,8 @@ static void glfw_error_callback(int error, const char* description)
 int main(int argc, char* argv[])
 {
   // Setup pipeline
-  auto actor = SetupDemoPipeline();
+  auto densityVolume = SetupDemoVolume();
+  auto actor = SetupDemoPipeline(densityVolume);
 
   // Setup window
   glfwSetErrorCallback(glfw_error_callback);
@@ -81,18 +111,196 @@ int main(int argc, char* argv[])
   ImGui_ImplGlfw_InitForOpenGL(window, true);
   ImGui_ImplOpenGL3_Init(glsl_version);
 
+  // Decimated levels of detail are built in the background, each viewer picks the level matching its size
+  VtkLodManager lodManager;
+
   // Initialize VtkViewer objects
   VtkViewer vtkViewer1;
   vtkViewer1.addActor(actor);
+  vtkViewer1.setLodManager(&lodManager);
+  vtkViewer1.setName("Vtk Viewer 1");
 
   VtkViewer vtkViewer2;
   vtkViewer2.getRenderer()->SetBackground(0, 0, 0); // Black background
   vtkViewer2.addActor(actor);
+  vtkViewer2.setLodManager(&lodManager);
+  vtkViewer2.setName("Vtk Viewer 2");
+  VtkOrientationMarker orientationMarker;
+  vtkViewer2.setOrientationMarker(&orientationMarker);
+
+  // Viewers hidden for a minute (closed window, background tab) give their GPU memory back
+  VtkViewer::SetGpuEvictionDelay(60.0);
+
+  // Viewers only re-render when their scene changed, and the loop sleeps while nothing needs a frame
+  vtkViewer1.setRenderOnDemand(true);
+  vtkViewer2.setRenderOnDemand(true);
+  VtkFramePacer framePacer;
+
+  // Background thread posting scene changes to VtkViewer #1 (see VtkViewer::post)
+  std::atomic<bool> producerRunning(false);
+  std::thread producer;
+
+  // Viewers for the dynamic tabs come from a pool, warmed up with the demo actor so its shaders are compiled
+  VtkViewerPool viewerPool;
+  viewerPool.warmUp(2, 256, 256, actor);
+  std::vector<std::unique_ptr<VtkViewer>> tabViewers;
+  int nextTabId = 1;
+  std::vector<int> tabIds;
+  double lastOpenTime = 0.0; // ms from acquire() to the first frame of the last opened tab
+
+  // Tens of thousands of boxes drawn by one instanced actor
+  VtkViewer instancesViewer;
+  instancesViewer.setName("Instanced glyphs");
+  instancesViewer.setRenderOnDemand(true);
+  int instanceGridSide = 200;
+  auto instanceSource = vtkSmartPointer<vtkCubeSource>::New();
+  std::shared_ptr<VtkInstancedGlyphs> instances;
+  {
+    std::vector<VtkInstanceTransform> transforms;
+    std::vector<unsigned char> colors;
+    SetupDemoInstanceGrid(instanceGridSide, transforms, colors);
+    instances = instancesViewer.addInstances(instanceSource->GetOutputPort(), transforms, colors);
+  }
+
+  // Live Lorenz trajectory growing by thousands of points per frame, only the new tail is uploaded
+  VtkViewer trajectoryViewer;
+  trajectoryViewer.setName("Live trajectory");
+  trajectoryViewer.setRenderOnDemand(true);
+  auto trajectoryMapper = vtkSmartPointer<VtkStreamingPolylineMapper>::New();
+  auto trajectoryActor = vtkSmartPointer<vtkActor>::New();
+  trajectoryActor->SetMapper(trajectoryMapper);
+  trajectoryActor->GetProperty()->SetColor(1.0, 0.8, 0.3);
+  trajectoryViewer.addActor(trajectoryActor);
+  DemoLorenzState lorenz = {0.1, 0.0, 0.0};
+  std::vector<float> trajectoryPoints;
+
+  // Density volume filled in by a worker thread; only the bricks that changed are contoured again
+  const double liveBounds[6] = {-30.0, 30.0, -30.0, 30.0, -10.0, 60.0}; // as in SetupDemoVolume
+  VtkLiveDensityVolume liveVolume(200, liveBounds);
+  liveVolume.setPublishCallback([](){
+    glfwPostEmptyEvent(); // wakes the frame pacer for the new surface
+  });
+  VtkViewer liveVolumeViewer;
+  liveVolumeViewer.setName("Live density volume");
+  liveVolumeViewer.setRenderOnDemand(true);
+  liveVolumeViewer.addActor(liveVolume.getActor());
+  liveVolumeViewer.getRenderer()->ResetCamera(liveBounds[0], liveBounds[1], liveBounds[2], liveBounds[3], liveBounds[4], liveBounds[5]);
+
+  // Streamlines of particles seeded by clicking into a sampled vector field, advected on a worker pool
+  auto vectorField = SetupDemoVectorField(64);
+  VtkParticleTracer tracer(vectorField);
+  tracer.setPublishCallback([](){
+    glfwPostEmptyEvent();
+  });
+  tracer.getActor()->GetProperty()->SetColor(1.0, 0.9, 0.5);
+  VtkViewer tracerViewer;
+  tracerViewer.setName("Particle tracer");
+  tracerViewer.setRenderOnDemand(true);
+  tracerViewer.addActors(SetupDemoSeedPlane(vectorField));
+  tracerViewer.addActor(tracer.getActor());
+  tracerViewer.getRenderer()->ResetCamera(vectorField->GetBounds());
+  tracer.start();
+
+  // Three linked slice viewers (MPR) over the density volume, resliced on a worker pool whenever the planes move
+  VtkMprReslicer mpr(densityVolume);
+  VtkViewer mprViewers[3];
+  const VtkMprOrientation mprOrientations[3] = {VtkMprOrientation::Axial, VtkMprOrientation::Coronal, VtkMprOrientation::Sagittal};
+  const char* mprNames[3] = {"MPR axial", "MPR coronal", "MPR sagittal"};
+  for (int i = 0; i < 3; i++){
+    mpr.addPlane(mprOrientations[i], 320, 320); // covers the 200^3 volume's diagonal when oblique
+    mpr.getActor(i)->GetProperty()->SetColorWindow(200.0);
+    mpr.getActor(i)->GetProperty()->SetColorLevel(100.0);
+    mprViewers[i].setName(mprNames[i]);
+    mprViewers[i].setRenderOnDemand(true);
+    mprViewers[i].getRenderer()->SetBackground(0, 0, 0);
+    mprViewers[i].getRenderer()->GetActiveCamera()->ParallelProjectionOn();
+    mprViewers[i].addActor(mpr.getActor(i));
+  }
+  mpr.update();
+  for (auto& viewer : mprViewers){
+    viewer.getRenderer()->ResetCamera();
+  }
+
+  // 16-bit image shown twice: a vtkImageActor (window/level on the CPU) and a VtkWindowLevelImageMapper actor
+  // (raw values uploaded once, window/level in the shader); one of them is visible
+  auto image16 = SetupDemo16BitImage(2048);
+  auto cpuImageActor = vtkSmartPointer<vtkImageActor>::New();
+  cpuImageActor->GetMapper()->SetInputData(image16);
+  cpuImageActor->GetProperty()->SetColorWindow(2000.0);
+  cpuImageActor->GetProperty()->SetColorLevel(1500.0);
+  cpuImageActor->SetVisibility(false);
+  auto windowLevelMapper = vtkSmartPointer<VtkWindowLevelImageMapper>::New();
+  windowLevelMapper->SetInputData(image16);
+  windowLevelMapper->SetWindow(2000.0);
+  windowLevelMapper->SetLevel(1500.0);
+  auto gpuImageActor = vtkSmartPointer<vtkActor>::New();
+  gpuImageActor->SetMapper(windowLevelMapper);
+  auto rainbow = vtkSmartPointer<vtkLookupTable>::New();
+  rainbow->SetHueRange(0.667, 0.0);
+  rainbow->SetTableRange(0.0, 1.0);
+  rainbow->Build();
+  VtkViewer imageViewer;
+  imageViewer.setName("Window/level");
+  imageViewer.setRenderOnDemand(true);
+  imageViewer.getRenderer()->SetBackground(0, 0, 0);
+  imageViewer.getRenderer()->GetActiveCamera()->ParallelProjectionOn();
+  imageViewer.addActor(cpuImageActor);
+  imageViewer.addActor(gpuImageActor);
+  imageViewer.getRenderer()->ResetCamera(image16->GetBounds());
+
+  // Tile pyramid viewer for images too big for one texture: only the tiles in view are decoded and uploaded
+  auto tiledMapper = vtkSmartPointer<VtkTiledImageMapper>::New();
+  tiledMapper->SetDecodedCallback([](){
+    glfwPostEmptyEvent(); // wakes the frame pacer to upload the tile
+  });
+  auto tiledActor = vtkSmartPointer<vtkActor>::New();
+  tiledActor->SetMapper(tiledMapper);
+  VtkViewer tiledViewer;
+  tiledViewer.setName("Tiled image");
+  tiledViewer.setRenderOnDemand(true);
+  tiledViewer.getRenderer()->SetBackground(0, 0, 0);
+  tiledViewer.getRenderer()->GetActiveCamera()->ParallelProjectionOn();
+  auto imageStyle = vtkSmartPointer<vtkInteractorStyleImage>::New(); // pans and zooms instead of rotating
+  imageStyle->SetDefaultRenderer(tiledViewer.getRenderer());
+  tiledViewer.getInteractor()->SetInteractorStyle(imageStyle);
+  tiledViewer.setInteractorStyle(imageStyle);
+  tiledViewer.addActor(tiledActor);
+  char pyramidPath[512] = "demo.vtktiles";
+  std::string pyramidError;
+  auto openPyramid = [&](){
+    try {
+      tiledMapper->SetPyramid(std::make_shared<VtkTilePyramid>(pyramidPath));
+      tiledViewer.getRenderer()->ResetCamera(tiledMapper->GetBounds());
+      pyramidError.clear();
+    }
+    catch (const VtkViewerError& error){
+      pyramidError = error.what();
+    }
+  };
+  // The demo pyramid is built on a background thread and opened on this one when done
+  std::atomic<bool> pyramidBuilding(false);
+  std::thread pyramidBuilder;
+  std::string builtPyramidPath, pyramidBuildError; // written by the builder before pyramidBuilding drops
+  if (argc > 1){ // a pyramid file to open right away
+    snprintf(pyramidPath, sizeof(pyramidPath), "%s", argv[1]);
+    openPyramid();
+  }
+
+  // Volume rendering of the same density volume, shown in VtkViewer #2 on demand
+  // Software GL (e.g. llvmpipe) gets the multithreaded CPU ray caster instead of the GPU mapper
+  const bool softwareGL = VtkViewer::IsSoftwareRenderer();
+  auto volumeProp = SetupDemoVolumeRendering(densityVolume, softwareGL);
+
+  // Optional compressed mesh path for the iso-surface, fed by the same contour filter
+  vtkSmartPointer<vtkMapper> standardMapper = actor->GetMapper();
+  auto compactMapper = vtkSmartPointer<VtkCompactPolyDataMapper>::New();
+  compactMapper->SetInputConnection(standardMapper->GetInputConnection(0, 0));
 
   // Our state
   bool show_demo_window = true;
   bool show_another_window = false;
   bool vtk_2_open = true;
+  bool show_gpu_memory = false;
   ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
 
   // Main loop
@@ -103,7 +311,8 @@ int main(int argc, char* argv[])
     // - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application.
     // - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application.
     // Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
-    glfwPollEvents();
+    // The frame pacer polls (or blocks waiting for events when nothing needs to be redrawn)
+    framePacer.waitForNextFrame();
 
     // Start the Dear ImGui frame
     ImGui_ImplOpenGL3_NewFrame();
@@ -125,6 +334,7 @@ int main(int argc, char* argv[])
       ImGui::Checkbox("Demo Window", &show_demo_window);      // Edit bools storing our window open/close state
       ImGui::Checkbox("Another Window", &show_another_window);
       ImGui::Checkbox("VTK Viewer #2", &vtk_2_open);
+      ImGui::Checkbox("VTK GPU memory", &show_gpu_memory);
 
       ImGui::SliderFloat("float", &f, 0.0f, 1.0f);            // Edit 1 float using a slider from 0.0f to 1.0f
       ImGui::ColorEdit3("clear color", (float*)&clear_color); // Edit 3 floats representing a color
@@ -136,6 +346,17 @@ int main(int argc, char* argv[])
       ImGui::Text("counter = %d", counter);
 
       ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
+
+      // Leave the mouse still to measure idle usage; compare against continuous frames
+      static bool onDemandFrames = true;
+      if (ImGui::Checkbox("On-demand frames", &onDemandFrames)){
+        framePacer.setMode(onDemandFrames ? VtkFramePacer::Mode::OnDemand : VtkFramePacer::Mode::Continuous);
+        vtkViewer1.setRenderOnDemand(onDemandFrames);
+        vtkViewer2.setRenderOnDemand(onDemandFrames);
+      }
+      ImGui::Text("CPU %.1f%% of a core | %.1f frames/s | %.1f VTK renders/s | VTK render time %.1f%% | idle %.0f%%",
+        framePacer.getCpuUsage(), framePacer.getFramesPerSecond(), framePacer.getRendersPerSecond(),
+        framePacer.getRenderLoad(), framePacer.getIdleFraction());
     }
     ImGui::End();
 
@@ -152,6 +373,76 @@ int main(int argc, char* argv[])
     // 4. Show a simple VtkViewer Instance (Always Open)
     ImGui::SetNextWindowSize(ImVec2(360, 240), ImGuiCond_FirstUseEver);
     ImGui::Begin("Vtk Viewer 1", nullptr, VtkViewer::NoScrollFlags());
+    {
+      // A threaded viewer must not share its pipeline with other viewers, so it gets its own copy of the demo
+      static bool threaded = false;
+      static vtkSmartPointer<vtkActor> threadedActor;
+      if (ImGui::Checkbox("Render thread", &threaded)){
+        if (threaded){
+          if (!threadedActor){
+            auto threadedVolume = vtkSmartPointer<vtkStructuredPoints>::New();
+            threadedVolume->DeepCopy(densityVolume);
+            threadedActor = SetupDemoPipeline(threadedVolume);
+          }
+          vtkViewer1.setLodManager(nullptr);
+          vtkViewer1.getRenderer()->RemoveActor(actor);
+          vtkViewer1.getRenderer()->AddActor(threadedActor);
+          vtkViewer1.setThreaded(true);
+        }
+        else{
+          vtkViewer1.setThreaded(false);
+          vtkViewer1.getRenderer()->RemoveActor(threadedActor);
+          vtkViewer1.getRenderer()->AddActor(actor);
+          vtkViewer1.setLodManager(&lodManager);
+        }
+      }
+      ImGui::SameLine();
+      ImGui::Text("%.1f FPS (%.2f ms/render)", vtkViewer1.getFramerate(), vtkViewer1.getLastRenderTime());
+
+      // Resolution scale: fixed, or adjusted to keep renders around the target frame time
+      static float renderScale = 1.0f;
+      static bool dynamicScale = false;
+      static float targetFrameTime = 16.0f;
+      ImGui::SetNextItemWidth(120.0f);
+      if (ImGui::SliderFloat("Render scale", &renderScale, 0.5f, 2.0f, "%.2fx")){
+        vtkViewer1.setRenderScale(renderScale);
+      }
+      ImGui::SameLine();
+      bool dynamicChanged = ImGui::Checkbox("Dynamic", &dynamicScale);
+      if (dynamicScale){
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(120.0f);
+        dynamicChanged |= ImGui::SliderFloat("Target (ms)", &targetFrameTime, 2.0f, 100.0f, "%.0f");
+      }
+      if (dynamicChanged){
+        vtkViewer1.setDynamicRenderScale(dynamicScale, targetFrameTime, 0.5f, renderScale);
+      }
+      ImGui::SameLine();
+      ImGui::Text("now %.2fx (%u x %u)", vtkViewer1.getCurrentRenderScale(), vtkViewer1.getViewportWidth(), vtkViewer1.getViewportHeight());
+
+      // A producer thread replaces a sphere's data every 20 ms without blocking on this thread
+      bool producing = producerRunning;
+      if (ImGui::Checkbox("Producer thread", &producing)){
+        if (producing){
+          double bounds[6];
+          densityVolume->GetBounds(bounds);
+          const double center[3] = {(bounds[0] + bounds[1]) / 2, (bounds[2] + bounds[3]) / 2, (bounds[4] + bounds[5]) / 2};
+          const double radius = (bounds[1] - bounds[0]) / 2;
+          producerRunning = true;
+          producer = std::thread([&vtkViewer1, &producerRunning, center, radius](){
+            RunDemoProducer(vtkViewer1, producerRunning, center, radius);
+          });
+        }
+        else{
+          producerRunning = false;
+          producer.join();
+        }
+      }
+      ImGui::SameLine();
+      ImGui::Text("%zu queued | batch %zu (max %zu) | latency %.2f ms (max %.2f) | %lu dropped", vtkViewer1.getPendingCommands(),
+        vtkViewer1.getLastCommandBatch(), vtkViewer1.getMaxCommandBatch(), vtkViewer1.getCommandLatency(),
+        vtkViewer1.getMaxCommandLatency(), vtkViewer1.getDroppedCommands());
+    }
     vtkViewer1.render(); // default render size = ImGui::GetContentRegionAvail()
     ImGui::End();
 
@@ -182,15 +473,628 @@ int main(int argc, char* argv[])
       if (ImGui::Button("VTK Background: Blue")){
         renderer->SetBackground(0, 0, 1);
       }
+      static bool showOrientationMarker = true;
+      if (ImGui::Checkbox("Orientation marker", &showOrientationMarker)){
+        vtkViewer2.setOrientationMarker(showOrientationMarker ? &orientationMarker : nullptr);
+      }
+      ImGui::SameLine();
+      ImGui::Text("(%lu marker renders for %lu scene renders)", orientationMarker.getRenderCount(), vtkViewer2.getRenderCount());
+      // A clock caption in the dynamic layer: it changes every second, the iso-surface under it is cached
+      static bool layered = false;
+      static vtkSmartPointer<vtkTextActor> clockCaption;
+      if (ImGui::Checkbox("Static/dynamic layers", &layered)){
+        vtkViewer2.setLayered(layered);
+        if (layered){
+          clockCaption = vtkSmartPointer<vtkTextActor>::New();
+          clockCaption->GetTextProperty()->SetFontSize(18);
+          clockCaption->SetPosition(10, 10);
+          vtkViewer2.addDynamicActor(clockCaption);
+        }
+      }
+      if (layered){
+        char clock[16];
+        const std::time_t now = std::time(nullptr);
+        std::strftime(clock, sizeof(clock), "%H:%M:%S", std::localtime(&now));
+        clockCaption->SetInput(clock); // only modified (and re-rendered) when the text changes
+        ImGui::SameLine();
+        ImGui::Text("(%lu static / %lu dynamic layer renders)", vtkViewer2.getStaticRenderCount(), vtkViewer2.getDynamicRenderCount());
+      }
       static float vtk2BkgAlpha = 0.2f;
       ImGui::SliderFloat("Background Alpha", &vtk2BkgAlpha, 0.0f, 1.0f);
       renderer->SetBackgroundAlpha(vtk2BkgAlpha);
 
+      // Iso-surface (vtkContourFilter) or direct volume rendering of the density volume
+      static int vtk2Mode = 0;
+      int previousMode = vtk2Mode;
+      ImGui::RadioButton("Iso-surface", &vtk2Mode, 0);
+      ImGui::SameLine();
+      ImGui::RadioButton("Volume", &vtk2Mode, 1);
+      if (vtk2Mode != previousMode){
+        // Add/remove directly on the renderer so that switching modes keeps the camera
+        if (vtk2Mode == 1){
+          renderer->RemoveActor(actor);
+          renderer->AddVolume(volumeProp);
+        }
+        else{
+          renderer->RemoveVolume(volumeProp);
+          renderer->AddActor(actor);
+        }
+      }
+      if (vtk2Mode == 1){
+        ImGui::Text("%s%s | %.1f FPS (%.2f ms/render)", DemoVolumeRenderPath(volumeProp),
+          softwareGL ? " - software GL detected" : "", vtkViewer2.getFramerate(), vtkViewer2.getLastRenderTime());
+        if (softwareGL){
+          ImGui::SameLine();
+          ImGui::Text("| %d threads", vtkMultiThreader::GetGlobalDefaultNumberOfThreads());
+        }
+        DemoTransferFunctionEditor(volumeProp->GetProperty());
+      }
+      else{
+        ImGui::Text("Iso-surface | %.1f FPS (%.2f ms/render)", vtkViewer2.getFramerate(), vtkViewer2.getLastRenderTime());
+
+        // 16-bit positions, octahedral normals, 32-bit indices in meshlet order
+        static bool compactMesh = false;
+        static bool levelOfDetail = false;
+        if (ImGui::Checkbox("Compact vertex format", &compactMesh)){
+          // The LOD manager wraps whichever mapper the actor has, so re-register it around the swap
+          if (levelOfDetail){
+            lodManager.removeActor(actor);
+          }
+          if (compactMesh){
+            actor->SetMapper(compactMapper);
+          }
+          else{
+            actor->SetMapper(standardMapper);
+          }
+          if (levelOfDetail){
+            lodManager.addActor(actor);
+          }
+        }
+        if (compactMesh){
+          const VtkCompactMeshStats& stats = compactMapper->GetStats();
+          ImGui::Text("%lld vertices, %lld triangles, %lld meshlets (built in %.1f ms)", static_cast<long long>(stats.vertices),
+            static_cast<long long>(stats.triangles), static_cast<long long>(stats.meshlets), stats.buildTime);
+          ImGui::Text("Mesh memory: %.2f MB -> %.2f MB (%.0f%% saved)", stats.originalBytes / (1024.0 * 1024.0),
+            stats.compactBytes / (1024.0 * 1024.0), stats.originalBytes ? 100.0 * (1.0 - static_cast<double>(stats.compactBytes) / stats.originalBytes) : 0.0);
+          ImGui::Text("Vertex cache miss ratio (ACMR): %.3f -> %.3f", stats.inputACMR, stats.compactACMR);
+        }
+
+        if (ImGui::Checkbox("Level of detail (background decimation)", &levelOfDetail)){
+          if (levelOfDetail){
+            lodManager.addActor(actor);
+          }
+          else{
+            lodManager.removeActor(actor);
+          }
+        }
+        if (levelOfDetail){
+          static float trianglesPerPixel = 0.5f;
+          if (ImGui::SliderFloat("Triangles per pixel", &trianglesPerPixel, 0.01f, 4.0f, "%.2f")){
+            lodManager.setTrianglesPerPixel(trianglesPerPixel);
+          }
+          const int level1 = lodManager.getSelectedLevel(actor, vtkViewer1.getRenderer());
+          const int level2 = lodManager.getSelectedLevel(actor, vtkViewer2.getRenderer());
+          ImGui::Text("Viewer 1: level %d (%lld triangles) | Viewer 2: level %d (%lld triangles) | %d jobs pending",
+            level1, static_cast<long long>(lodManager.getLevelTriangles(actor, level1)),
+            level2, static_cast<long long>(lodManager.getLevelTriangles(actor, level2)), static_cast<int>(lodManager.getPendingJobs()));
+        }
+      }
+
+      // Per-viewer anti-aliasing: MSAA resolved into the viewer texture, or the FXAA post pass
+      if (ImGui::CollapsingHeader("Anti-aliasing")){
+        static const char* sampleCounts[] = {"Off", "2x", "4x", "8x"};
+        static int sampleIndex = 0;
+        if (ImGui::Combo("MSAA", &sampleIndex, sampleCounts, IM_ARRAYSIZE(sampleCounts))){
+          vtkViewer2.setMultiSamples(sampleIndex == 0 ? 0 : 1 << sampleIndex);
+        }
+        bool fxaa = vtkViewer2.getFXAA();
+        if (ImGui::Checkbox("FXAA", &fxaa)){
+          vtkViewer2.setFXAA(fxaa);
+        }
+        // Still views refine over several jittered renders, moving the camera restarts from one cheap frame
+        int accumulation = vtkViewer2.getAccumulation();
+        if (ImGui::SliderInt("Accumulated frames (0 = off)", &accumulation, 0, 64)){
+          vtkViewer2.setAccumulation(accumulation);
+        }
+        if (accumulation > 0){
+          ImGui::SameLine();
+          ImGui::Text("%d / %d", vtkViewer2.getAccumulatedFrames(), accumulation);
+        }
+
+        static std::vector<DemoAntiAliasingTiming> aaTimings;
+        if (ImGui::Button("Benchmark none / FXAA / MSAA")){
+          const unsigned int width = vtkViewer2.getViewportWidth() > 0 ? vtkViewer2.getViewportWidth() : 512;
+          const unsigned int height = vtkViewer2.getViewportHeight() > 0 ? vtkViewer2.getViewportHeight() : 512;
+          aaTimings = BenchmarkDemoAntiAliasing(vtkViewer2, width, height);
+        }
+        for (const auto& timing : aaTimings){
+          ImGui::Text("%-8s %8.2f ms/render (%.2fx, %d samples)", timing.mode, timing.ms, timing.ms / aaTimings.front().ms, timing.samples);
+        }
+      }
+
+      // Translucency modes on concentric translucent spheres, in a small viewer of their own
+      if (ImGui::CollapsingHeader("Transparency")){
+        static std::unique_ptr<VtkViewer> layersViewer;
+        if (!layersViewer){
+          layersViewer.reset(new VtkViewer());
+          layersViewer->setName("Translucent layers");
+          layersViewer->setRenderOnDemand(true);
+          layersViewer->addActors(SetupDemoTranslucentLayers(6));
+        }
+        static const char* modes[] = {"Unsorted", "Depth peeling", "Adaptive peeling", "Weighted blended OIT", "Depth sort"};
+        int mode = static_cast<int>(layersViewer->getTransparencyMode());
+        if (ImGui::Combo("Mode", &mode, modes, IM_ARRAYSIZE(modes))){
+          layersViewer->setTransparencyMode(static_cast<VtkViewer::TransparencyMode>(mode));
+        }
+        int maximumPeels = layersViewer->getMaximumPeels();
+        if (ImGui::SliderInt("Maximum peels", &maximumPeels, 1, 16)){
+          layersViewer->setMaximumPeels(maximumPeels);
+        }
+        float budget = static_cast<float>(layersViewer->getPeelingTimeBudget());
+        if (ImGui::SliderFloat("Peeling budget (ms)", &budget, 1.0f, 100.0f, "%.0f")){
+          layersViewer->setPeelingTimeBudget(budget);
+        }
+        ImGui::Text("%d peels | %.2f ms/render", layersViewer->getPeelCount(), layersViewer->getLastRenderTime());
+
+        static std::vector<DemoTransparencyTiming> transparencyTimings;
+        if (ImGui::Button("Benchmark transparency modes")){
+          const unsigned int width = layersViewer->getViewportWidth() > 0 ? layersViewer->getViewportWidth() : 512;
+          const unsigned int height = layersViewer->getViewportHeight() > 0 ? layersViewer->getViewportHeight() : 240;
+          transparencyTimings = BenchmarkDemoTransparency(*layersViewer, width, height);
+        }
+        for (const auto& timing : transparencyTimings){
+          ImGui::Text("%-20s %8.2f ms/render (%.2fx) %d peels", timing.mode, timing.ms, timing.ms / transparencyTimings.front().ms, timing.peels);
+        }
+        layersViewer->render(ImVec2(ImGui::GetContentRegionAvail().x, 240.0f));
+      }
+
+      // SMP backend and thread count used while this viewer's pipelines execute
+      if (ImGui::CollapsingHeader("SMP filter execution")){
+        static const char* backends[] = {"Default", "Sequential", "STDThread", "TBB"};
+        static int backendIndex = 0;
+        if (ImGui::Combo("Backend", &backendIndex, backends, IM_ARRAYSIZE(backends))){
+          vtkViewer2.setSMPBackend(backendIndex == 0 ? "" : backends[backendIndex]);
+        }
+        static int smpThreads = 0;
+        if (ImGui::SliderInt("Threads (0 = default)", &smpThreads, 0, vtkSMPTools::GetEstimatedNumberOfThreads() * 2)){
+          vtkViewer2.setSMPThreads(smpThreads);
+        }
+        auto contour = vtkFlyingEdges3D::SafeDownCast(actor->GetMapper()->GetInputAlgorithm());
+        static float isoValue = 50.0f;
+        if (contour && ImGui::DragFloat("Iso-value (re-runs contour)", &isoValue, 1.0f, 1.0f, 1000.0f)){
+          contour->SetValue(0, isoValue);
+        }
+
+        if (ImGui::BeginTable("##filters", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)){
+          ImGui::TableSetupColumn("Filter");
+          ImGui::TableSetupColumn("Runs");
+          ImGui::TableSetupColumn("Last (ms)");
+          ImGui::TableSetupColumn("Backend / threads");
+          ImGui::TableSetupColumn("Parallel (guess)");
+          ImGui::TableHeadersRow();
+          for (const auto& execution : vtkViewer2.getFilterExecutions()){
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::TextUnformatted(execution.className.c_str());
+            ImGui::TableNextColumn(); ImGui::Text("%d", execution.executions);
+            ImGui::TableNextColumn(); ImGui::Text("%.2f", execution.lastExecutionTime);
+            ImGui::TableNextColumn(); ImGui::Text("%s / %d", execution.backend.c_str(), execution.threads);
+            ImGui::TableNextColumn(); ImGui::TextUnformatted(execution.ranParallel ? "likely" : (execution.smpCapable ? "no (1 thread)" : "unlikely (not a known SMP filter)"));
+          }
+          ImGui::EndTable();
+        }
+
+        static std::vector<double> contourTimings;
+        if (ImGui::Button("Benchmark contour 1..N threads")){
+          contourTimings = BenchmarkDemoContour(densityVolume, 0);
+        }
+        for (size_t i = 0; i < contourTimings.size(); i++){
+          ImGui::Text("%2d threads: %8.2f ms (%.2fx)", static_cast<int>(i + 1), contourTimings[i], contourTimings.front() / contourTimings[i]);
+        }
+      }
+
       vtkViewer2.render();
 
       ImGui::End();
     }
 
+    if (show_gpu_memory){
+      VtkViewer::ShowGpuMemoryWindow(&show_gpu_memory);
+    }
+
+    // 6. Viewer tabs opened and closed at runtime, backed by VtkViewerPool
+    ImGui::SetNextWindowSize(ImVec2(480, 360), ImGuiCond_FirstUseEver);
+    ImGui::Begin("Viewer tabs", nullptr, VtkViewer::NoScrollFlags());
+    if (ImGui::Button("Open tab")){
+      std::unique_ptr<VtkViewer> viewer = viewerPool.acquire();
+      viewer->addActor(actor);
+      viewer->setRenderOnDemand(true);
+      viewer->setName("Tab viewer " + std::to_string(nextTabId));
+      tabViewers.push_back(std::move(viewer));
+      tabIds.push_back(nextTabId++);
+    }
+    if (!tabViewers.empty() && tabIds.back() == nextTabId - 1 && tabViewers.back()->getFirstFrameTime() > 0.0){
+      lastOpenTime = tabViewers.back()->getFirstFrameTime();
+    }
+    ImGui::SameLine();
+    ImGui::Text("Last open: %.2f ms to first frame, %.3f ms in acquire() (%s) | %d idle in pool", lastOpenTime,
+      viewerPool.getLastAcquireTime(), viewerPool.getLastAcquireWasHit() ? "pooled" : "new viewer",
+      static_cast<int>(viewerPool.getIdleCount()));
+    if (ImGui::BeginTabBar("##viewerTabs", ImGuiTabBarFlags_AutoSelectNewTabs)){
+      for (size_t i = 0; i < tabViewers.size();){
+        bool open = true;
+        char label[32];
+        snprintf(label, sizeof(label), "Viewer %d", tabIds[i]);
+        if (ImGui::BeginTabItem(label, &open)){
+          tabViewers[i]->render();
+          ImGui::EndTabItem();
+        }
+        if (!open){
+          viewerPool.release(std::move(tabViewers[i]));
+          tabViewers.erase(tabViewers.begin() + i);
+          tabIds.erase(tabIds.begin() + i);
+        }
+        else{
+          i++;
+        }
+      }
+      ImGui::EndTabBar();
+    }
+    ImGui::End();
+
+    // 7. Instanced glyphs, optionally animated by writing the per-instance positions in place
+    ImGui::SetNextWindowSize(ImVec2(480, 360), ImGuiCond_FirstUseEver);
+    ImGui::Begin("Instanced glyphs", nullptr, VtkViewer::NoScrollFlags());
+    {
+      static bool animateInstances = false;
+      ImGui::Checkbox("Animate", &animateInstances);
+      if (animateInstances){
+        AnimateDemoInstances(*instances, instanceGridSide, ImGui::GetTime());
+      }
+      ImGui::SameLine();
+      ImGui::Text("%lld instances, 1 actor | %.2f ms/render", static_cast<long long>(instances->size()), instancesViewer.getLastRenderTime());
+
+      // Separate actors can't be instanced; moving them in one batch still beats one SetPosition/SetOrientation each
+      static DemoTransformTiming transformTiming = {0.0, 0.0};
+      if (ImGui::Button("Benchmark moving 5000 actors")){
+        transformTiming = BenchmarkDemoTransforms(5000);
+      }
+      if (transformTiming.batchMs > 0.0){
+        ImGui::SameLine();
+        ImGui::Text("same poses: SetPosition/SetOrientation %.3f ms | setTransforms %.3f ms (%.1fx), matrix rebuilds in both",
+          transformTiming.perActorMs, transformTiming.batchMs, transformTiming.perActorMs / transformTiming.batchMs);
+      }
+    }
+    instancesViewer.render();
+    ImGui::End();
+
+    // 8. Live trajectory appended every frame
+    ImGui::SetNextWindowSize(ImVec2(480, 360), ImGuiCond_FirstUseEver);
+    ImGui::Begin("Live trajectory", nullptr, VtkViewer::NoScrollFlags());
+    {
+      static bool integrating = false;
+      static int pointsPerFrame = 2000;
+      static int maximumPoints = 0;
+      if (ImGui::Checkbox("Run", &integrating)){
+        trajectoryViewer.setAnimating(integrating); // keeps the frame pacer going
+      }
+      ImGui::SameLine();
+      ImGui::SetNextItemWidth(120.0f);
+      ImGui::SliderInt("Points/frame", &pointsPerFrame, 100, 20000);
+      ImGui::SameLine();
+      ImGui::SetNextItemWidth(120.0f);
+      if (ImGui::SliderInt("Decimate above", &maximumPoints, 0, 4000000, maximumPoints > 0 ? "%d" : "off")){
+        trajectoryMapper->SetMaximumPoints(static_cast<size_t>(maximumPoints));
+      }
+      ImGui::SameLine();
+      if (ImGui::Button("Clear")){
+        trajectoryMapper->Clear();
+      }
+
+      if (integrating){
+        const bool first = trajectoryMapper->GetStats().points == 0;
+        trajectoryPoints.clear();
+        IntegrateDemoLorenz(lorenz, pointsPerFrame, trajectoryPoints);
+        trajectoryMapper->Append(trajectoryPoints.data(), trajectoryPoints.size() / 3);
+        if (first){
+          trajectoryViewer.getRenderer()->ResetCamera(-30.0, 30.0, -30.0, 30.0, 0.0, 60.0); // the attractor's extent
+        }
+      }
+      const VtkStreamingPolylineStats& stats = trajectoryMapper->GetStats();
+      ImGui::Text("%zu points | %.0f points/s | %.1f KB uploaded last render | capacity %zu (%d growths, %d decimations)",
+        stats.points, stats.pointsPerSecond, stats.uploadedBytes / 1024.0, stats.capacity, stats.reallocations, stats.decimations);
+    }
+    trajectoryViewer.render();
+    ImGui::End();
+
+    // 9. Density volume converging in real time
+    ImGui::SetNextWindowSize(ImVec2(480, 360), ImGuiCond_FirstUseEver);
+    ImGui::Begin("Live density volume", nullptr, VtkViewer::NoScrollFlags());
+    {
+      bool integrating = liveVolume.isRunning();
+      if (ImGui::Checkbox("Integrate", &integrating)){
+        if (integrating){
+          const double initial[3] = {1.0, 1.0, 1.0};
+          liveVolume.start([](double state[3]){
+            StepDemoLorenz(state, 0.01);
+          }, initial);
+        }
+        else{
+          liveVolume.stop();
+        }
+      }
+      ImGui::SameLine();
+      float isoValue = static_cast<float>(liveVolume.getIsoValue());
+      ImGui::SetNextItemWidth(120.0f);
+      if (ImGui::SliderFloat("Iso value", &isoValue, 1.0f, 200.0f, "%.0f")){
+        liveVolume.setIsoValue(isoValue);
+      }
+      ImGui::SameLine();
+      if (ImGui::Button("Clear")){
+        liveVolume.clear();
+      }
+
+      liveVolume.update();
+      const VtkLiveDensityStats& stats = liveVolume.getStats();
+      ImGui::Text("%.1fM steps (%.1fM/s) | %d of %d bricks re-contoured in %.1f ms | %lu surfaces | %.1f MB",
+        stats.steps / 1e6, stats.stepsPerSecond / 1e6, stats.contouredBricks, stats.bricks, stats.contourTime, stats.publishes,
+        stats.memoryBytes / 1048576.0);
+
+      // Memory and contour time of sparse bricks against a dense grid; the dense grid is only built up to 512^3
+      // (256 MB), 1024^3 would need 2 GB and seconds of filling on this thread
+      if (ImGui::CollapsingHeader("Sparse vs dense storage")){
+        static int resolutionIndex = 0;
+        static const int resolutions[] = {200, 512, 1024};
+        static const char* resolutionNames[] = {"200^3", "512^3", "1024^3"};
+        static int millionSteps = 10;
+        static float sparseIso = 5.0f;
+        static bool includeDense = false;
+        const bool denseAllowed = resolutions[resolutionIndex] <= 512;
+        ImGui::SetNextItemWidth(100.0f);
+        ImGui::Combo("Resolution", &resolutionIndex, resolutionNames, IM_ARRAYSIZE(resolutionNames));
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(100.0f);
+        ImGui::SliderInt("M steps", &millionSteps, 1, 100);
+        ImGui::SameLine();
+        ImGui::SetNextItemWidth(100.0f);
+        ImGui::SliderFloat("Iso", &sparseIso, 1.0f, 100.0f, "%.0f");
+        ImGui::SameLine();
+        if (denseAllowed){
+          ImGui::Checkbox("Dense too", &includeDense);
+        }
+        else{
+          ImGui::TextUnformatted("(no dense grid above 512^3)");
+        }
+        static DemoSparseVolumeTiming sparseTiming = {};
+        if (ImGui::Button("Benchmark storage")){
+          sparseTiming = BenchmarkDemoSparseVolume(resolutions[resolutionIndex], millionSteps * 1000000, sparseIso,
+            includeDense && denseAllowed);
+        }
+        if (sparseTiming.bricks > 0){
+          ImGui::Text("sparse: %d of %d bricks, %.1f MB, voxelize %.0f ms, contour %.0f ms, %lld triangles",
+            sparseTiming.allocatedBricks, sparseTiming.bricks, sparseTiming.sparseBytes / 1048576.0,
+            sparseTiming.sparseVoxelizeMs, sparseTiming.sparseContourMs, static_cast<long long>(sparseTiming.sparseTriangles));
+          if (sparseTiming.denseContourMs > 0.0){
+            ImGui::Text("dense:  %.1f MB, voxelize %.0f ms, contour %.0f ms, %lld triangles", sparseTiming.denseBytes / 1048576.0,
+              sparseTiming.denseVoxelizeMs, sparseTiming.denseContourMs, static_cast<long long>(sparseTiming.denseTriangles));
+          }
+        }
+      }
+
+      // Compile-time specializations of the trajectory-to-volume loop (system, integrator, precision, counter)
+      if (ImGui::CollapsingHeader("ODE engine specializations")){
+        static std::vector<DemoOdeTiming> odeTimings;
+        if (ImGui::Button("Benchmark 10M steps each")){
+          odeTimings = BenchmarkDemoOdeEngines();
+        }
+        for (const auto& timing : odeTimings){
+          ImGui::Text("%-36s %8.1f ms %8.1f M steps/s", timing.name, timing.ms, timing.stepsPerSecond / 1e6);
+        }
+      }
+    }
+    liveVolumeViewer.render();
+    ImGui::End();
+
+    // 10. Particle tracer: Ctrl+click on the plane (or a streamline) seeds particles around the picked point
+    ImGui::SetNextWindowSize(ImVec2(480, 360), ImGuiCond_FirstUseEver);
+    ImGui::Begin("Particle tracer", nullptr, VtkViewer::NoScrollFlags());
+    static int seedCount = 1000;
+    static float seedRadius = 0.2f;
+    {
+      bool advecting = tracer.isRunning();
+      if (ImGui::Checkbox("Advect", &advecting)){
+        if (advecting){
+          tracer.start();
+        }
+        else{
+          tracer.stop();
+        }
+      }
+      ImGui::SameLine();
+      ImGui::SetNextItemWidth(100.0f);
+      ImGui::SliderInt("Particles/click", &seedCount, 1, 20000);
+      ImGui::SameLine();
+      ImGui::SetNextItemWidth(100.0f);
+      ImGui::SliderFloat("Radius", &seedRadius, 0.01f, 1.0f, "%.2f");
+      ImGui::SameLine();
+      if (ImGui::Button("Clear")){
+        tracer.clear();
+      }
+
+      tracer.update();
+      const VtkParticleTracerStats& stats = tracer.getStats();
+      ImGui::Text("%zu particles (%zu active) | %.1fM steps/s on %u threads, %.2f ms/batch | %zu points",
+        stats.particles, stats.activeParticles, stats.stepsPerSecond / 1e6, stats.threads, stats.advectTime, stats.points);
+    }
+    tracerViewer.render();
+    if (ImGui::IsItemHovered() && io.KeyCtrl && io.MouseClicked[ImGuiMouseButton_Left]){
+      double seedPoint[3];
+      if (tracerViewer.pick(seedPoint)){
+        tracer.seed(seedPoint, seedRadius, seedCount);
+      }
+    }
+    ImGui::End();
+
+    // 11. MPR: dragging the center or the oblique angles reslices all three planes in the same frame
+    ImGui::SetNextWindowSize(ImVec2(900, 360), ImGuiCond_FirstUseEver);
+    ImGui::Begin("MPR", nullptr, VtkViewer::NoScrollFlags());
+    {
+      static float mprAngles[3] = {0.0f, 0.0f, 0.0f};
+      static bool sweep = false;
+      float center[3] = {static_cast<float>(mpr.getCenter()[0]), static_cast<float>(mpr.getCenter()[1]), static_cast<float>(mpr.getCenter()[2])};
+      ImGui::SetNextItemWidth(240.0f);
+      if (ImGui::DragFloat3("Center", center, 0.1f)){
+        const double newCenter[3] = {center[0], center[1], center[2]};
+        mpr.setCenter(newCenter);
+      }
+      ImGui::SameLine();
+      ImGui::SetNextItemWidth(240.0f);
+      if (ImGui::SliderFloat3("Yaw/pitch/roll", mprAngles, -90.0f, 90.0f, "%.0f")){
+        mpr.setOrientation(mprAngles[0], mprAngles[1], mprAngles[2]);
+      }
+      ImGui::SameLine();
+      if (ImGui::Checkbox("Sweep", &sweep)){
+        for (auto& viewer : mprViewers){
+          viewer.setAnimating(sweep); // keeps the frame pacer going
+        }
+      }
+      if (sweep){
+        mpr.moveAlongNormal(0, 0.3 * std::sin(ImGui::GetTime() * 2.0)); // axial plane up and down
+      }
+
+      mpr.update();
+      const VtkMprStats& stats = mpr.getStats();
+      ImGui::Text("%.0f reslices/s | %.2f ms per update of %d planes | %.0f Mpixels/s on %u threads", stats.reslicesPerSecond,
+        stats.lastUpdateTime, mpr.getPlaneCount(), stats.samplesPerSecond / 1e6, mpr.getThreadCount());
+    }
+    {
+      const float spacing = ImGui::GetStyle().ItemSpacing.x;
+      const ImVec2 available = ImGui::GetContentRegionAvail();
+      for (int i = 0; i < 3; i++){
+        if (i > 0){
+          ImGui::SameLine();
+        }
+        ImGui::PushID(i); // each viewer draws into its own "##Viewport" child
+        mprViewers[i].render(ImVec2((available.x - 2.0f * spacing) / 3.0f, available.y));
+        ImGui::PopID();
+      }
+    }
+    ImGui::End();
+
+    // 12. Window/level of a 16-bit image: the GPU path only changes shader uniforms, the CPU path maps every pixel
+    ImGui::SetNextWindowSize(ImVec2(520, 560), ImGuiCond_FirstUseEver);
+    ImGui::Begin("Window/level", nullptr, VtkViewer::NoScrollFlags());
+    {
+      static bool gpuWindowLevel = true;
+      static float windowLevel[2] = {2000.0f, 1500.0f};
+      static int lookupTableIndex = 0;
+      static const char* lookupTables[] = {"Gray", "Rainbow"};
+      if (ImGui::Checkbox("GPU window/level", &gpuWindowLevel)){
+        cpuImageActor->SetVisibility(!gpuWindowLevel);
+        gpuImageActor->SetVisibility(gpuWindowLevel);
+      }
+      ImGui::SameLine();
+      ImGui::SetNextItemWidth(100.0f);
+      if (ImGui::Combo("LUT", &lookupTableIndex, lookupTables, IM_ARRAYSIZE(lookupTables))){
+        vtkLookupTable* lookupTable = lookupTableIndex == 1 ? rainbow.GetPointer() : nullptr; // none: grayscale in both paths
+        cpuImageActor->GetProperty()->SetLookupTable(lookupTable);
+        windowLevelMapper->SetLookupTable(lookupTable);
+      }
+      ImGui::SetNextItemWidth(300.0f);
+      if (ImGui::SliderFloat2("Window/level", windowLevel, 1.0f, 4095.0f, "%.0f")){
+        cpuImageActor->GetProperty()->SetColorWindow(windowLevel[0]);
+        cpuImageActor->GetProperty()->SetColorLevel(windowLevel[1]);
+        windowLevelMapper->SetWindow(windowLevel[0]);
+        windowLevelMapper->SetLevel(windowLevel[1]);
+      }
+      const VtkWindowLevelStats& stats = windowLevelMapper->GetStats();
+      ImGui::Text("GPU: %d upload(s) of %.1f MB as %s, %.1f ms | %.2f ms last frame", stats.uploads, stats.uploadedBytes / 1048576.0,
+        stats.textureFormat, stats.uploadTime, imageViewer.getLastRenderTime());
+      static std::vector<DemoWindowLevelTiming> windowLevelTimings;
+      if (ImGui::Button("Benchmark CPU vs GPU contrast changes")){
+        windowLevelTimings = BenchmarkDemoWindowLevel(imageViewer, cpuImageActor, gpuImageActor, 1024, 1024);
+      }
+      for (const auto& timing : windowLevelTimings){
+        ImGui::Text("%-18s %8.2f ms", timing.path, timing.ms);
+      }
+    }
+    imageViewer.render();
+    ImGui::End();
+
+    // 13. Tiled image: pan (middle or shift+left drag) and zoom (wheel) through a pyramid far bigger than a texture
+    ImGui::SetNextWindowSize(ImVec2(620, 620), ImGuiCond_FirstUseEver);
+    ImGui::Begin("Tiled image", nullptr, VtkViewer::NoScrollFlags());
+    {
+      static int memoryLimitMB = 256;
+      static int uploadsPerRender = 8;
+      if (!pyramidBuilding && pyramidBuilder.joinable()){
+        pyramidBuilder.join();
+        pyramidError = pyramidBuildError;
+        if (pyramidError.empty()){
+          snprintf(pyramidPath, sizeof(pyramidPath), "%s", builtPyramidPath.c_str());
+          openPyramid();
+        }
+      }
+      ImGui::SetNextItemWidth(300.0f);
+      ImGui::InputText("Pyramid", pyramidPath, sizeof(pyramidPath));
+      ImGui::SameLine();
+      if (pyramidBuilding){
+        ImGui::Text("Building %s...", builtPyramidPath.c_str());
+      }
+      else{
+        if (ImGui::Button("Open")){
+          openPyramid();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Build 16384^2 demo")){
+          builtPyramidPath = pyramidPath;
+          pyramidBuildError.clear();
+          tiledMapper->SetPyramid(nullptr); // its file may be the one rewritten
+          pyramidBuilding = true;
+          pyramidBuilder = std::thread([&builtPyramidPath, &pyramidBuildError, &pyramidBuilding](){
+            try {
+              BuildDemoTilePyramid(builtPyramidPath, 16384);
+            }
+            catch (const std::exception& error){ // VtkViewerError, but also bad_alloc or a worker thread failing to start
+              pyramidBuildError = error.what();
+            }
+            catch (...){
+              pyramidBuildError = "Could not build " + builtPyramidPath;
+            }
+            pyramidBuilding = false; // reached on every path, nothing escapes the catches above
+            glfwPostEmptyEvent(); // wakes the frame pacer to open it
+          });
+        }
+      }
+      if (!pyramidError.empty()){
+        ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s", pyramidError.c_str());
+      }
+      ImGui::SetNextItemWidth(200.0f);
+      if (ImGui::SliderInt("GPU cache (MB)", &memoryLimitMB, 16, 2048)){
+        tiledMapper->SetMemoryLimit(static_cast<size_t>(memoryLimitMB) * 1024 * 1024);
+      }
+      ImGui::SameLine();
+      ImGui::SetNextItemWidth(120.0f);
+      if (ImGui::SliderInt("Uploads/frame", &uploadsPerRender, 1, 64)){
+        tiledMapper->SetUploadsPerRender(uploadsPerRender);
+      }
+      if (tiledMapper->GetPyramid()){
+        const VtkTilePyramid& pyramid = *tiledMapper->GetPyramid();
+        const VtkTileCacheStats& stats = tiledMapper->GetStats();
+        ImGui::Text("%d x %d, %d levels of %d^2 tiles | level %d: %d visible, %d missing", pyramid.getWidth(), pyramid.getHeight(),
+          pyramid.getLevelCount(), pyramid.getTileSize(), stats.level, stats.visibleTiles, stats.missingTiles);
+        ImGui::Text("Cache: %zu tiles, %.0f / %.0f MB | %zu pending | %lu loaded, %lu evicted, %lu dropped", stats.residentTiles,
+          stats.residentBytes / 1048576.0, stats.memoryLimit / 1048576.0, stats.pendingTiles, stats.loadedTiles, stats.evictedTiles,
+          stats.droppedTiles);
+        ImGui::Text("Tile latency %.1f ms avg, %.1f ms max | decode %.2f ms avg", stats.averageLatency, stats.maximumLatency,
+          stats.averageDecodeTime);
+      }
+    }
+    if (tiledMapper->HasDecodedTiles()){
+      tiledViewer.requestRedraw(); // uploads them
+    }
+    tiledViewer.render();
+    ImGui::End();
+
     ImGui::Render();
 
     int display_w, display_h;
@@ -212,6 +1116,15 @@ int main(int argc, char* argv[])
   }
 
   // Cleanup
+  if (producer.joinable()){
+    producerRunning = false;
+    producer.join();
+  }
+  if (pyramidBuilder.joinable()){
+    pyramidBuilder.join();
+  }
+  liveVolume.stop();
+  tracer.stop();
   ImGui_ImplOpenGL3_Shutdown();
   ImGui_ImplGlfw_Shutdown();
   ImGui::DestroyContext();